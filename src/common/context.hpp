@@ -21,6 +21,14 @@ namespace twk
 
 constexpr unsigned int DEFAULT_OPT_LEVEL = 2;
 
+// 0 means the number of hardware threads
+constexpr unsigned int DEFAULT_JOBS = 0;
+
+// In microseconds, the same as clang
+constexpr unsigned int DEFAULT_TIME_TRACE_GRANULARITY = 500;
+
+constexpr const char* DEFAULT_OUTPUT_FILE = "a.out";
+
 #define EMIT_EXE_ARG    "exe"
 #define EMIT_OBJ_ARG    "obj"
 #define EMIT_ASM_ARG    "asm"
@@ -33,14 +41,36 @@ struct Context {
           const unsigned int           opt_level,
           std::string&&                relocation_model,
           std::vector<std::string>&&   linked_libs,
-          std::optional<std::string>&& target_triple) noexcept
+          std::string&&                output_file,
+          std::optional<std::string>&& target_triple,
+          const unsigned int           jobs,
+          std::optional<std::string>&& cache_dir,
+          const bool                   print_cache_stats,
+          const bool                   lto,
+          const bool                   thin_lto,
+          const bool                   time_trace,
+          const unsigned int           time_trace_granularity,
+          const bool                   time_report,
+          const bool                   profile_generate,
+          std::optional<std::string>&& profile_use) noexcept
     : input_files{std::move(input_files)}
     , jit{jit}
     , emit_target{std::move(emit_target)}
     , opt_level{opt_level}
     , relocation_model{std::move(relocation_model)}
     , linked_libs{std::move(linked_libs)}
+    , output_file{std::move(output_file)}
     , target_triple{std::move(target_triple)}
+    , jobs{jobs}
+    , cache_dir{std::move(cache_dir)}
+    , print_cache_stats{print_cache_stats}
+    , lto{lto}
+    , thin_lto{thin_lto}
+    , time_trace{time_trace}
+    , time_trace_granularity{time_trace_granularity}
+    , time_report{time_report}
+    , profile_generate{profile_generate}
+    , profile_use{std::move(profile_use)}
   {
   }
 
@@ -56,7 +86,40 @@ struct Context {
 
   const std::vector<std::string> linked_libs;
 
+  // Name of the executable file created by linking
+  const std::string output_file;
+
   const std::optional<std::string> target_triple;
+
+  // Upper bound of the number of worker threads
+  const unsigned int jobs;
+
+  // If set, object files are cached in this directory
+  const std::optional<std::string> cache_dir;
+
+  const bool print_cache_stats;
+
+  // If true, all input files are linked into one module and optimized
+  const bool lto;
+
+  // If true, each input file is optimized with the summaries of the others
+  // and emitted separately
+  const bool thin_lto;
+
+  // If true, a Chrome trace of the compilation is written
+  const bool time_trace;
+
+  // Minimum duration of spans in the time trace in microseconds
+  const unsigned int time_trace_granularity;
+
+  // If true, the time of each phase is printed to stderr
+  const bool time_report;
+
+  // If true, executables are instrumented to write a profile at exit
+  const bool profile_generate;
+
+  // If set, modules are optimized with the profile merged by llvm-profdata
+  const std::optional<std::string> profile_use;
 };
 
 } // namespace twk
@@ -16,6 +16,7 @@
 #include <twk/unicode/unicode.hpp>
 #include <twk/codegen/kind.hpp>
 #include <twk/support/kind.hpp>
+#include <twk/support/interner.hpp>
 
 // Note If the template argument of boost::variant exceeds 10, use
 // boost::make_variant_over
@@ -47,40 +48,47 @@ namespace ast
 // Common AST
 //===----------------------------------------------------------------------===//
 
+// Identifiers are interned, so that they are compared and looked up in the
+// tables without comparing the strings
 struct Identifier : x3::position_tagged {
-  std::u32string name;
+  Symbol name;
 
-  explicit Identifier(std::u32string&& name)
-    : name{std::move(name)}
+  explicit Identifier(const std::u32string_view name)
+    : name{intern(unicode::utf32toUtf8(name))}
   {
   }
 
   explicit Identifier(const std::string_view name)
-    : name{unicode::utf8toUtf32(name)}
+    : name{intern(name)}
+  {
+  }
+
+  explicit Identifier(const Symbol name) noexcept
+    : name{name}
   {
   }
 
   Identifier() = default;
 
-  [[nodiscard]] std::string utf8() const
+  [[nodiscard]] const std::string& utf8() const noexcept
   {
-    return unicode::utf32toUtf8(name);
+    return name.str();
   }
 
-  [[nodiscard]] const std::u32string& utf32() const
+  [[nodiscard]] std::u32string utf32() const
   {
-    return name;
+    return unicode::utf8toUtf32(name.str());
   }
 
-  [[nodiscard]] bool operator==(const Identifier& other) const
+  [[nodiscard]] bool operator==(const Identifier& other) const noexcept
   {
-    return name == other.utf32();
+    return name == other.name;
   }
 
   // Implemented to be a key in std::map
-  [[nodiscard]] bool operator<(const Identifier& other) const
+  [[nodiscard]] bool operator<(const Identifier& other) const noexcept
   {
-    return name < other.utf32();
+    return name < other.name;
   }
 };
 
@@ -0,0 +1,76 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _8c1e5f3a_2b7d_4e96_a0c4_7d3f9b6e1a25
+#define _8c1e5f3a_2b7d_4e96_a0c4_7d3f9b6e1a25
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twk/pch/pch.hpp>
+
+namespace twk::cache
+{
+
+// Content-addressed on-disk cache of object files
+//
+// The key of a source file is a hash of its path, its contents and the options
+// affecting code generation. For each key, a manifest records the files
+// imported from the source file and their hashes, and the object file is
+// stored under a hash of the key and the manifest. So editing an imported file
+// also invalidates the object file
+struct ObjectCache : private boost::noncopyable {
+  ObjectCache(const std::filesystem::path& cache_dir,
+              const unsigned int           opt_level,
+              const std::string_view       target_triple,
+              const std::string_view       relocation_model);
+
+  // Returns std::nullopt if the absolute path of the source file is unknown
+  [[nodiscard]] std::optional<std::string>
+  createKey(const std::filesystem::path& source_file,
+            const std::string_view       source) const;
+
+  // Returns the path of the cached object file if it is up to date
+  // A file without a key is counted as a miss
+  [[nodiscard]] std::optional<std::filesystem::path>
+  lookup(const std::optional<std::string>& key);
+
+  // Failure to store is not an error, the object file is just not cached
+  void store(const std::string&                        key,
+             const std::vector<std::filesystem::path>& imported_files,
+             const std::filesystem::path&              object_file) const;
+
+  [[nodiscard]] std::size_t getHits() const noexcept
+  {
+    return hits;
+  }
+
+  [[nodiscard]] std::size_t getMisses() const noexcept
+  {
+    return misses;
+  }
+
+private:
+  [[nodiscard]] std::filesystem::path
+  getManifestPath(const std::string& key) const;
+
+  [[nodiscard]] std::filesystem::path
+  getObjectPath(const std::string& key, const std::string& manifest) const;
+
+  const std::filesystem::path cache_dir;
+
+  // Options affecting code generation
+  const std::string config;
+
+  std::size_t hits{};
+  std::size_t misses{};
+};
+
+} // namespace twk::cache
+
+#endif
@@ -16,10 +16,12 @@
 #include <twk/ast/ast.hpp>
 #include <twk/codegen/type.hpp>
 #include <twk/support/utils.hpp>
-#include <twk/support/typedef.hpp>
+#include <twk/support/position.hpp>
 #include <twk/jit/jit.hpp>
 #include <twk/parse/parser.hpp>
+#include <twk/interface/interface.hpp>
 #include <twk/mangle/mangler.hpp>
+#include <llvm/Support/PGOOptions.h>
 #include <map>
 
 namespace twk
@@ -105,25 +107,28 @@ using FunctionReturnTypeTable = Table<llvm::Function*, std::shared_ptr<Type>>;
 using FunctionParameterTypesTable
   = Table<llvm::Function*, std::vector<std::shared_ptr<Type>>>;
 
-using TypeTable = Table<std::string, std::shared_ptr<Type>>;
+// Tables of names are keyed by the interned names, so that lookups do not hash
+// and compare the strings
+using TypeTable = Table<Symbol, std::shared_ptr<Type>>;
 
 using AliasTable = TypeTable;
 
 using TemplateArgumentTable = TypeTable;
 
-using ClassTable = Table<std::string, std::shared_ptr<ClassType>>;
+using ClassTable = Table<Symbol, std::shared_ptr<ClassType>>;
 
 struct Variable;
-using SymbolTable = Table<std::string, std::shared_ptr<Variable>>;
+using SymbolTable = Table<Symbol, std::shared_ptr<Variable>>;
 
-using UnionTable = Table<std::string, std::shared_ptr<UnionType>>;
+using UnionTable = Table<Symbol, std::shared_ptr<UnionType>>;
 
-using PositionCacheTable = Table<std::string /* file name */, PositionCache>;
-
-// Stores source code line by line as elements
-using SourceCode = std::vector<std::string>;
-
-using SourceCodeTable = Table<std::string /* file name */, SourceCode>;
+// A file whose AST nodes are generated in a translation unit
+// Imported files are shared between translation units
+struct ParsedFile {
+  std::string                          name;
+  std::shared_ptr<const SourceFile>    source;
+  std::shared_ptr<const PositionTable> positions;
+};
 
 enum class NamespaceKind {
   unknown,
@@ -159,8 +164,14 @@ struct NamespaceStack {
     return namespaces.empty();
   }
 
+  [[nodiscard]] std::size_t size() const noexcept
+  {
+    return namespaces.size();
+  }
+
   void push(const Namespace& n)
   {
+    paths.push_back(intern(fmt::format("{}::{}", path().str(), n.name)));
     namespaces.push_back(n);
   }
 
@@ -168,6 +179,7 @@ struct NamespaceStack {
   {
     const auto tmp = top();
     namespaces.pop_back();
+    paths.pop_back();
     return tmp;
   }
 
@@ -197,6 +209,33 @@ struct NamespaceStack {
     return false;
   }
 
+  // Interned path of the namespaces such as "::a::b", which is empty for the
+  // global namespace
+  [[nodiscard]] Symbol path() const noexcept
+  {
+    return path(size());
+  }
+
+  // Interned path of the outermost 'depth' namespaces
+  [[nodiscard]] Symbol path(const std::size_t depth) const noexcept
+  {
+    assert(depth <= size());
+    return depth ? paths[depth - 1] : Symbol{};
+  }
+
+  // The outermost 'depth' namespaces
+  [[nodiscard]] NamespaceStack prefix(const std::size_t depth) const
+  {
+    assert(depth <= size());
+
+    auto copy = *this;
+
+    while (depth < copy.size())
+      copy.pop();
+
+    return copy;
+  }
+
   // Implemented to be a key in std::map
   [[nodiscard]] bool operator<(const NamespaceStack& other) const
   {
@@ -208,74 +247,181 @@ struct NamespaceStack {
 
 private:
   std::deque<Namespace> namespaces;
+
+  // paths[i] is the path of the outermost i + 1 namespaces
+  std::vector<Symbol> paths;
 };
 
-using TemplateTableKey = std::tuple<std::string, // Name
-                                    std::size_t, // Template parameter length
-                                    NamespaceStack>;
+struct TemplateTableKey {
+  TemplateTableKey(const Symbol          name,
+                   const std::size_t     param_length,
+                   const NamespaceStack& ns) noexcept
+    : TemplateTableKey{name, param_length, ns.path()}
+  {
+  }
 
-using FunctionTemplateTableValue = ast::FunctionDef;
+  TemplateTableKey(const Symbol      name,
+                   const std::size_t param_length,
+                   const Symbol      ns_path) noexcept
+    : name{name}
+    , param_length{param_length}
+    , ns_path{ns_path}
+  {
+  }
 
-// std::unordered_map cannot use std::tuple as a key, so use std::map instead
-using FunctionTemplateTable
-  = Table<TemplateTableKey,
-          FunctionTemplateTableValue,
-          std::map<TemplateTableKey, FunctionTemplateTableValue>>;
+  [[nodiscard]] bool operator==(const TemplateTableKey&) const noexcept
+    = default;
 
-using ClassTemplateTableValue = ast::ClassDef;
+  Symbol      name;
+  std::size_t param_length; // Template parameter length
+  Symbol      ns_path;
+};
 
-// std::unordered_map cannot use std::tuple as a key, so use std::map instead
-using ClassTemplateTable
-  = Table<TemplateTableKey,
-          ClassTemplateTableValue,
-          std::map<TemplateTableKey, ClassTemplateTableValue>>;
+struct TemplateTableKeyHash {
+  [[nodiscard]] std::size_t
+  operator()(const TemplateTableKey& key) const noexcept
+  {
+    auto hash = key.name.hash();
 
-using CreatedClassTemplateTableKey = std::tuple<std::string, // Name
-                                                ast::TemplateArguments,
-                                                NamespaceStack>;
+    for (const auto h : {key.param_length, key.ns_path.hash()})
+      hash ^= h + 0x9e3779b9 + (hash << 6) + (hash >> 2);
 
-using CreatedClassTemplateTableElem
-  = std::pair<CreatedClassTemplateTableKey, std::shared_ptr<Type>>;
+    return hash;
+  }
+};
 
-// std::unordered_map cannot use std::tuple as a key, so use std::map instead
-using UnionTemplateTable = Table<TemplateTableKey,
-                                 ast::UnionDef,
-                                 std::map<TemplateTableKey, ast::UnionDef>>;
+// Templates are looked up from the innermost namespace
+// Lookups are memoized for each namespace, and the memo is cleared when a
+// template is inserted
+template <typename T>
+struct TemplateTable {
+  [[nodiscard]] bool exists(const TemplateTableKey& key) const
+  {
+    return table.contains(key);
+  }
 
-struct CreatedClassTemplateTable {
-  CreatedClassTemplateTable(CGContext& ctx)
-    : ctx{ctx}
-    , table{}
+  void insert(const TemplateTableKey& key, const T& value)
   {
+    assert(!exists(key));
+
+    table.emplace(key, value);
+    memo.clear();
   }
 
-  [[nodiscard]] std::optional<std::shared_ptr<Type>>
-  operator[](const CreatedClassTemplateTableKey& key) const;
+  // Return the template and the namespaces where it is defined
+  // The template is referred to in the table without copying it
+  [[nodiscard]] std::optional<std::pair<const T&, NamespaceStack>>
+  find(const Symbol          name,
+       const std::size_t     param_length,
+       const NamespaceStack& ns) const
+  {
+    const auto [iter, inserted]
+      = memo.try_emplace(TemplateTableKey{name, param_length, ns});
+
+    if (inserted)
+      iter->second = lookup(name, param_length, ns);
+
+    const auto [value, depth] = iter->second;
 
-  void insert(CreatedClassTemplateTableKey&& key,
-              const std::shared_ptr<Type>&   value);
+    if (!value)
+      return std::nullopt;
+
+    return std::make_pair(std::cref(*value), ns.prefix(depth));
+  }
 
 private:
-  CGContext&                              ctx;
-  std::set<CreatedClassTemplateTableElem> table;
+  // Return nullptr if the template does not exist
+  [[nodiscard]] std::pair<const T*, std::size_t>
+  lookup(const Symbol          name,
+         const std::size_t     param_length,
+         const NamespaceStack& ns) const
+  {
+    for (auto depth = ns.size();; --depth) {
+      if (const auto iter
+          = table.find(TemplateTableKey{name, param_length, ns.path(depth)});
+          iter != table.end())
+        return {&iter->second, depth};
+
+      if (depth == 0)
+        return {nullptr, 0};
+    }
+
+    unreachable();
+  }
+
+  // The references to the values are not invalidated by insertion
+  std::unordered_map<TemplateTableKey, T, TemplateTableKeyHash> table;
+
+  // Keyed by the current namespace, and the value is the found template and
+  // the depth of the namespace where it is defined
+  mutable std::unordered_map<TemplateTableKey,
+                             std::pair<const T*, std::size_t>,
+                             TemplateTableKeyHash>
+    memo;
 };
 
+using FunctionTemplateTableValue = ast::FunctionDef;
+
+using FunctionTemplateTable = TemplateTable<FunctionTemplateTableValue>;
+
+using ClassTemplateTableValue = ast::ClassDef;
+
+using ClassTemplateTable = TemplateTable<ClassTemplateTableValue>;
+
+using UnionTemplateTable = TemplateTable<ast::UnionDef>;
+
+// Template arguments are the canonical types, so that aliases of a type are the
+// same argument
+struct CreatedClassTemplateTableKey {
+  [[nodiscard]] bool operator==(const CreatedClassTemplateTableKey&) const
+    = default;
+
+  Symbol                   name;
+  std::vector<const Type*> template_args;
+  Symbol                   ns_path; // Namespace of the class template
+};
+
+struct CreatedClassTemplateTableKeyHash {
+  [[nodiscard]] std::size_t
+  operator()(const CreatedClassTemplateTableKey& key) const noexcept
+  {
+    auto hash = key.name.hash();
+
+    const auto combine = [&](const std::size_t h) {
+      hash ^= h + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    };
+
+    for (const auto arg : key.template_args)
+      combine(std::hash<const Type*>{}(arg));
+
+    combine(key.ns_path.hash());
+
+    return hash;
+  }
+};
+
+using CreatedClassTemplateTable
+  = Table<CreatedClassTemplateTableKey,
+          std::shared_ptr<Type>,
+          std::unordered_map<CreatedClassTemplateTableKey,
+                             std::shared_ptr<Type>,
+                             CreatedClassTemplateTableKeyHash>>;
+
 template <typename T>
 concept PositionTaggedClass
   = std::is_convertible_v<T, boost::spirit::x3::position_tagged>;
 
 // Codegen context
 struct CGContext : private boost::noncopyable {
-  CGContext(llvm::LLVMContext&      context,
-            PositionCache&&         current_file_poscache,
-            std::filesystem::path&& file,
-            const std::string&      source_code,
-            const unsigned int      opt_level,
-            const bool              jit) noexcept;
+  CGContext(llvm::LLVMContext&                  context,
+            SourceManager&                      source_manager,
+            interface::ImportCache&             import_cache,
+            PositionTable&&                     current_file_positions,
+            std::filesystem::path&&             file,
+            std::shared_ptr<const SourceFile>&& source);
 
-  [[nodiscard]] std::string
-  formatError(const boost::iterator_range<InputIterator>& pos,
-              const std::string_view                      message) const;
+  [[nodiscard]] std::string formatError(const PositionRange&   pos,
+                                        const std::string_view message) const;
 
   // LLVM
   llvm::LLVMContext&            context;
@@ -284,53 +430,31 @@ struct CGContext : private boost::noncopyable {
 
   std::filesystem::path current_file;
 
+  // Absolute paths of the files imported from this translation unit
+  FilePaths imported_files;
+
+  // Shared by all translation units
+  SourceManager&          source_manager;
+  interface::ImportCache& import_cache;
+
+  // The file of the node is known from the node, so the nodes of imported
+  // files are found without searching
   template <PositionTaggedClass T>
   [[nodiscard]] PositionRange positionOf(T&& ast) const
   {
-    const auto search_in_current_file = [&]() {
-      const auto current_file_pos_cache
-        = position_cache_table[current_file.string()];
-      assert(current_file_pos_cache);
-      return current_file_pos_cache->get().position_of(ast);
-    };
-
-    const auto search_in_imported_files
-      = [&]() -> std::optional<PositionRange> {
-      const auto current_file_name = current_file.string();
-
-      for (const auto& r : position_cache_table) {
-        if (r.first == current_file_name)
-          continue;
-
-        try {
-          return r.second.position_of(ast);
-        }
-        catch (const std::out_of_range&) {
-          continue;
-        }
-      }
-
-      return std::nullopt;
-    };
-
-    try {
-      return search_in_current_file();
-    }
-    catch (const std::out_of_range&) {
-      const auto pos = search_in_imported_files();
-      if (pos)
-        return *pos;
-      else
-        unreachable();
-    }
+    const auto pos = getFile(getFileID(ast)).positions->find(ast);
+    assert(pos);
+    return *pos;
   }
 
-  [[nodiscard]] const PositionCache& getCurrentPosCache() const
-  {
-    const auto current_pos_cache = position_cache_table[current_file.string()];
-    assert(current_pos_cache);
-    return *current_pos_cache;
-  }
+  // The file is ignored if it is already added, which is the case for a file
+  // imported twice
+  void addFile(std::string&&                               name,
+               const std::shared_ptr<const SourceFile>&    source,
+               const std::shared_ptr<const PositionTable>& positions);
+
+  // Every type of this translation unit is created by this table
+  CanonicalTypeTable types;
 
   // Table
   ClassTable                        class_table;
@@ -342,37 +466,47 @@ struct CGContext : private boost::noncopyable {
   CreatedClassTemplateTable         created_class_template_table;
   UnionTable                        union_table;
   UnionTemplateTable                union_template_table;
-  PositionCacheTable                position_cache_table;
   // If you want to find template arguments, look for them in the symbol table
   // of top
   std::stack<TemplateArgumentTable> template_argument_tables;
 
+  // Functions whose mangled names end with the ellipsis in order of
+  // declaration, so that variadic functions are found without searching the
+  // whole module
+  std::vector<llvm::Function*> vararg_functions;
+
   // Namespace
   NamespaceStack ns_hierarchy;
 
   // Mangle
   mangle::Mangler mangler;
 
-  // Pass manager
-  llvm::legacy::FunctionPassManager fpm;
-
-  // If true, suppress optimization
-  const bool jit;
-
 private:
-  SourceCodeTable source_code_table;
+  [[nodiscard]] const ParsedFile& getFile(const std::uint32_t file_id) const
+  {
+    assert(file_id < files.size() && files[file_id]);
+    return *files[file_id];
+  }
 
-  [[nodiscard]] std::size_t
-  calcRows(const boost::iterator_range<InputIterator>& pos) const;
+  // Indexed by file ID
+  std::vector<std::optional<ParsedFile>> files;
 };
 
 struct CodeGenerator : private boost::noncopyable {
-  CodeGenerator(const std::string_view               program_name,
-                std::vector<parse::Parser::Result>&& parse_results,
-                const unsigned int                   opt_level,
-                const llvm::Reloc::Model             relocation_model,
-                const std::optional<std::string>&    target_triple_arg,
-                const bool                           jit);
+  CodeGenerator(const std::string_view                      program_name,
+                SourceManager&                              source_manager,
+                std::vector<parse::Parser::Result>&&        parse_results,
+                const unsigned int                          opt_level,
+                const llvm::Reloc::Model                    relocation_model,
+                const std::optional<std::string>&           target_triple_arg,
+                const bool                                  jit,
+                const bool                                  lto,
+                const bool                                  thin_lto,
+                const bool                                  whole_program,
+                const std::optional<std::filesystem::path>& cache_dir,
+                const unsigned int                          jobs,
+                const bool                                  profile_generate,
+                const std::optional<std::filesystem::path>& profile_use);
 
   // Returns the created file paths
   [[nodiscard]] FilePaths emitLlvmIRFiles();
@@ -389,37 +523,97 @@ struct CodeGenerator : private boost::noncopyable {
   // Returns the return value from the main function
   [[nodiscard]] int doJIT();
 
+  // Returns the imported files of each translation unit
+  [[nodiscard]] std::vector<FilePaths> getImportedFiles() const;
+
 private:
   void verifyOptLevel(const unsigned int opt_level) const;
 
-  using Result
-    = std::tuple<std::unique_ptr<llvm::Module>, std::filesystem::path>;
+  struct Result {
+    // Each translation unit has its own context so that they can be generated
+    // in parallel
+    std::unique_ptr<llvm::LLVMContext> context;
+    std::unique_ptr<llvm::Module>      module;
+    std::filesystem::path              file;
+    FilePaths                          imported_files;
+  };
 
   void codegen(const ast::TranslationUnit& ast, CGContext& ctx);
 
+  [[nodiscard]] Result codegen(parse::Parser::Result& parse_result);
+
+  // Run the module optimization pipeline on each translation unit
+  void optimizeModules();
+
+  // Link all modules into one module, then optimize it
+  // Symbols other than main are internalized if it is the whole program
+  void performLTO();
+
   // Returns the created file paths
   [[nodiscard]] FilePaths emitFiles(const llvm::CodeGenFileType cgft,
                                     const bool create_as_tmpfile = false);
 
+  // Perform ThinLTO and emit the file of each translation unit to the output
+  // files in the same order
+  // Returns the created file paths
+  [[nodiscard]] FilePaths emitFilesWithThinLTO(const llvm::CodeGenFileType cgft,
+                                               FilePaths&& output_files);
+
   void initTargetTripleAndMachine(
     const std::optional<std::string>& target_triple_arg);
 
+  // TargetMachine is not thread-safe, so each thread creates its own
+  [[nodiscard]] std::unique_ptr<llvm::TargetMachine>
+  createTargetMachine() const;
+
   const std::string_view argv_front;
 
-  std::unique_ptr<llvm::LLVMContext> context;
+  // Imported files are read through the source manager of the compilation
+  SourceManager& source_manager;
 
   bool jit_compiled = false;
 
-  std::string          target_triple;
-  llvm::TargetMachine* target_machine;
+  std::string                          target_triple;
+  const llvm::Target*                  target;
+  std::unique_ptr<llvm::TargetMachine> target_machine;
 
   const llvm::Reloc::Model relocation_model;
 
+  const unsigned int opt_level;
+
+  const bool thin_lto;
+
+  // If true, the modules are the whole program, such as an executable, so
+  // nothing outside them refers to symbols other than main
+  const bool whole_program;
+
+  // If set, the results of the ThinLTO backends are cached in this directory
+  const std::optional<std::filesystem::path> thin_lto_cache_dir;
+
+  // Upper bound of the number of worker threads
+  const unsigned int jobs;
+
+  // If set, modules are instrumented or optimized with the profile
+  const std::optional<llvm::PGOOptions> pgo_options;
+
   std::vector<Result> results;
 
   std::vector<parse::Parser::Result> parse_results;
+
+  // Each imported file is loaded once for all translation units
+  interface::ImportCache import_cache;
 };
 
+// Initialize the LLVM targets of this process, which CodeGenerator does when
+// it is first constructed
+void initializeTargets();
+
+// The profile is read by the optimization pipeline, which cannot report errors
+// as ErrorBase, so it is verified in advance
+// Throws ErrorBase if the profile cannot be read
+void verifyProfile(const std::string&     profile_file,
+                   const std::string_view argv_front);
+
 } // namespace codegen
 
 } // namespace twk
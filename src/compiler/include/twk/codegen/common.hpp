@@ -109,12 +109,10 @@ struct AllocaVariable : public Variable {
   AllocaVariable(CGContext&   ctx,
                  const Value& alloca,
                  const bool   is_mutable) noexcept
-    : alloca{alloca}
+    : alloca{alloca.getValue(), alloca.getType()->withMutable(ctx, is_mutable)}
     , is_mutable{is_mutable}
   {
     assert(llvm::dyn_cast<llvm::AllocaInst>(alloca.getValue()));
-
-    this->alloca.getType()->setMutable(ctx, is_mutable);
   }
 
   AllocaVariable() = delete;
@@ -154,7 +152,9 @@ private:
 
 // Returns a AST of a class template and a namespace information where it is
 // located
-[[nodiscard]] std::optional<std::pair<ClassTemplateTableValue, NamespaceStack>>
+// The AST is referred to in the table without copying it
+[[nodiscard]] std::optional<
+  std::pair<const ClassTemplateTableValue&, NamespaceStack>>
 findClassTemplate(CGContext&                    ctx,
                   const std::string_view        name,
                   const ast::TemplateArguments& args);
@@ -281,6 +281,7 @@ createDereference(CGContext& ctx, const PositionRange& pos, const Value& val);
                                       const PositionRange&             pos,
                                       const std::shared_ptr<Variable>& operand);
 
+// Mutability is ignored
 [[nodiscard]] bool equals(CGContext&                   ctx,
                           const std::shared_ptr<Type>& left,
                           const std::shared_ptr<Type>& right);
@@ -26,6 +26,14 @@ void createStatement(CGContext&         ctx,
                      const StmtContext& stmt_ctx_arg,
                      const ast::Stmt&   statement);
 
+// Generate the statements in a scope like a compound statement, so that
+// statements are added to a shared statement without copying it
+void createStatement(
+  CGContext&                                                  ctx,
+  const SymbolTable&                                          scope_arg,
+  const StmtContext&                                          stmt_ctx_arg,
+  const std::vector<std::reference_wrapper<const ast::Stmt>>& statements);
+
 } // namespace twk::codegen
 
 #endif
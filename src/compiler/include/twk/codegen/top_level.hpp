@@ -22,12 +22,14 @@ namespace twk::codegen
 [[nodiscard]] std::optional<bool>
 isVariadicArgs(const ast::ParameterList& params);
 
+// The prologue is generated before the body in the same scope if not null
 void createFunctionBody(CGContext&                  ctx,
                         llvm::Function* const       func,
                         const std::string_view      name,
                         const ast::ParameterList&   params,
                         const std::shared_ptr<Type> return_type,
-                        const ast::Stmt&            body);
+                        const ast::Stmt&            body,
+                        const ast::Stmt* const      prologue = nullptr);
 
 [[nodiscard]] llvm::Function*
 declareFunction(CGContext&                   ctx,
@@ -50,7 +52,18 @@ void createClass(CGContext&                        ctx,
                  const std::optional<std::string>& custom_class_name
                  = std::nullopt);
 
-using ClassMethods = std::vector<ast::FunctionDef>;
+// A method generated from a member of a class
+// The declaration is copied to add the implicit 'this' parameter, while the
+// body is referred to in the class AST, so that instantiating a class template
+// does not copy the bodies of the methods
+struct Method {
+  bool                     is_public;
+  ast::FunctionDecl        decl;
+  const ast::Stmt*         body;
+  std::optional<ast::Stmt> prologue; // Member initializers of constructors
+};
+
+using ClassMethods = std::vector<Method>;
 
 void defineMethods(CGContext&          ctx,
                    const ClassMethods& methods,
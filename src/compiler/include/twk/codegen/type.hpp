@@ -15,9 +15,10 @@
 #include <twk/pch/pch.hpp>
 #include <twk/support/utils.hpp>
 #include <twk/support/kind.hpp>
-#include <twk/support/typedef.hpp>
+#include <twk/support/position.hpp>
 #include <twk/unicode/unicode.hpp>
 #include <boost/lexical_cast.hpp>
+#include <map>
 #include <twk/ast/ast.hpp>
 
 namespace twk::codegen
@@ -78,19 +79,27 @@ struct UnionVariant {
 
 using UnionVariants = std::vector<UnionVariant>;
 
-struct Type {
-  explicit Type(const bool is_mutable) noexcept
-    : is_mutable{is_mutable}
-  {
-  }
-
+// Types are created by CanonicalTypeTable only once for each structure and
+// mutability, so that equal types are the same object
+// Types are immutable, and a type that differs in mutability is another object
+struct Type : public std::enable_shared_from_this<Type> {
   virtual ~Type() = default;
 
-  [[nodiscard]] virtual std::shared_ptr<Type> clone() const = 0;
-
   [[nodiscard]] virtual SignKind getSignKind(CGContext&) const = 0;
 
-  [[nodiscard]] virtual llvm::Type* getLLVMType(CGContext&) const = 0;
+  // Cached, unless the type depends on the scope
+  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const
+  {
+    if (llvm_type)
+      return llvm_type;
+
+    const auto type = createLLVMType(ctx);
+
+    if (!depends_on_scope)
+      llvm_type = type;
+
+    return type;
+  }
 
   [[nodiscard]] virtual std::string getMangledName(CGContext&) const = 0;
 
@@ -190,33 +199,53 @@ struct Type {
     return getSignKind(ctx) == SignKind::unsigned_;
   }
 
-  [[nodiscard]] virtual bool isMutable() const
+  [[nodiscard]] bool isMutable() const noexcept
   {
     return is_mutable;
   }
 
-  virtual void setMutable(CGContext&, const bool is_mutable)
+  // True if the type refers to a user-defined type name, which is resolved in
+  // the current scope
+  [[nodiscard]] bool dependsOnScope() const noexcept
   {
-    this->is_mutable = is_mutable;
+    return depends_on_scope;
   }
 
-protected:
-  bool is_mutable;
-};
+  // Return the type that differs only in mutability
+  // The mutability of pointee types and element types is changed as well
+  [[nodiscard]] virtual std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) const = 0;
 
-struct BuiltinType : public Type {
-  explicit BuiltinType(const BuiltinTypeKind kind,
-                       const bool            is_mutable) noexcept
-    : Type{is_mutable}
-    , kind{kind}
+  // Return the immutable type whose user-defined type names are resolved
+  // Types are equal if their canonical types are the same object
+  [[nodiscard]] virtual std::shared_ptr<Type>
+  getCanonicalType(CGContext& ctx) const
+  {
+    return withMutable(ctx, false);
+  }
+
+protected:
+  Type(const bool is_mutable, const bool depends_on_scope) noexcept
+    : is_mutable{is_mutable}
+    , depends_on_scope{depends_on_scope}
   {
   }
 
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
+  [[nodiscard]] virtual llvm::Type* createLLVMType(CGContext&) const = 0;
+
+  [[nodiscard]] std::shared_ptr<Type> getSharedThis() const
   {
-    return std::make_shared<BuiltinType>(*this);
+    return std::const_pointer_cast<Type>(shared_from_this());
   }
 
+private:
+  const bool is_mutable;
+  const bool depends_on_scope;
+
+  mutable llvm::Type* llvm_type{};
+};
+
+struct BuiltinType : public Type {
   [[nodiscard]] SignKind getSignKind(CGContext&) const override;
 
   [[nodiscard]] bool isVoidTy(CGContext&) const override
@@ -231,32 +260,26 @@ struct BuiltinType : public Type {
 
   [[nodiscard]] bool isIntegerTy(CGContext&) const override;
 
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const override;
-
   [[nodiscard]] std::string getMangledName(CGContext&) const override;
 
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) const override;
+
 private:
-  const BuiltinTypeKind kind;
-};
+  friend struct CanonicalTypeTable;
 
-struct UserDefinedType : public Type {
-  explicit UserDefinedType(const std::u32string& ident, const bool is_mutable)
-    : Type{is_mutable}
-    , ident{unicode::utf32toUtf8(ident)}
+  BuiltinType(const BuiltinTypeKind kind, const bool is_mutable) noexcept
+    : Type{is_mutable, false}
+    , kind{kind}
   {
   }
 
-  explicit UserDefinedType(const std::string& ident, const bool is_mutable)
-    : Type{is_mutable}
-    , ident{ident}
-  {
-  }
+  [[nodiscard]] llvm::Type* createLLVMType(CGContext& ctx) const override;
 
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
-  {
-    return std::make_shared<UserDefinedType>(*this);
-  }
+  const BuiltinTypeKind kind;
+};
 
+struct UserDefinedType : public Type {
   [[nodiscard]] SignKind getSignKind(CGContext& ctx) const override
   {
     return getRealType(ctx)->getSignKind(ctx);
@@ -265,9 +288,6 @@ struct UserDefinedType : public Type {
   // Return nullptr if the type does not exist
   [[nodiscard]] std::shared_ptr<Type> getRealType(CGContext& ctx) const;
 
-  // Return nullptr if the type does not exist
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const override;
-
   [[nodiscard]] std::shared_ptr<Type>
   getPointeeType(CGContext& ctx) const override
   {
@@ -355,57 +375,78 @@ struct UserDefinedType : public Type {
 
   [[nodiscard]] std::string getUserDefinedTyName(CGContext&) const override
   {
-    return ident;
+    return ident.str();
   }
 
   [[nodiscard]] std::string getMangledName(CGContext& ctx) const override;
 
-  void setMutable(CGContext& ctx, const bool is_mutable) override
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) const override;
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getCanonicalType(CGContext& ctx) const override
   {
-    getRealType(ctx)->setMutable(ctx, is_mutable);
+    return getRealType(ctx)->getCanonicalType(ctx);
   }
 
 private:
-  const std::string ident;
+  friend struct CanonicalTypeTable;
+
+  UserDefinedType(const Symbol ident, const bool is_mutable) noexcept
+    : Type{is_mutable, true}
+    , ident{ident}
+  {
+  }
+
+  // Return nullptr if the type does not exist
+  [[nodiscard]] llvm::Type* createLLVMType(CGContext& ctx) const override;
+
+  const Symbol ident;
 };
 
-struct ClassType : public Type {
+// Base of class types and union types, which are created for each definition
+// Both mutable and immutable types are created at once, and refer to each other
+struct NominalType : public Type {
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext&, const bool is_mutable) const override
+  {
+    return is_mutable == isMutable() ? getSharedThis()
+                                     : requalified->getSharedThis();
+  }
+
+protected:
+  explicit NominalType(const bool is_mutable) noexcept
+    : Type{is_mutable, false}
+  {
+  }
+
+private:
+  friend struct CanonicalTypeTable;
+
+  const NominalType* requalified{};
+};
+
+struct ClassType : public NominalType {
   struct MemberVariable {
     std::string           name;
     std::shared_ptr<Type> type;
     Accessibility         accessibility;
   };
 
-  ClassType(CGContext&                    ctx,
-            std::vector<MemberVariable>&& members,
-            const std::u32string&         name,
-            const bool                    is_mutable);
-
-  ClassType(CGContext&                    ctx,
-            std::vector<MemberVariable>&& members,
-            const std::string&            name,
-            const bool                    is_mutable);
-
-  ClassType(CGContext&                    ctx,
-            std::vector<MemberVariable>&& members,
-            const std::string&            name,
-            llvm::StructType* const       type,
-            const bool                    is_mutable);
+  [[nodiscard]] static std::shared_ptr<ClassType>
+  create(CGContext&                    ctx,
+         std::vector<MemberVariable>&& members,
+         const std::string&            name);
 
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
-  {
-    return std::make_shared<ClassType>(*this);
-  }
-
-  static std::shared_ptr<ClassType> createOpaqueClass(CGContext&         ctx,
-                                                      const std::string& ident);
+  [[nodiscard]] static std::shared_ptr<ClassType>
+  createOpaqueClass(CGContext& ctx, const std::string& ident);
 
   static std::vector<llvm::Type*>
   extractTypes(CGContext& ctx, const std::vector<MemberVariable>& members);
 
   void setIsOpaque(const bool val) noexcept
   {
-    is_opaque = val;
+    body->is_opaque = val;
   }
 
   // Used to set members to Opaque classes
@@ -420,7 +461,7 @@ struct ClassType : public Type {
   [[nodiscard]] const MemberVariable&
   getMemberVar(const std::size_t offset) const
   {
-    return members.at(offset);
+    return body->members.at(offset);
   }
 
   [[nodiscard]] SignKind getSignKind(CGContext&) const override
@@ -428,14 +469,9 @@ struct ClassType : public Type {
     return SignKind::no_sign;
   }
 
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext&) const override
-  {
-    return type;
-  }
-
   [[nodiscard]] bool isOpaque(CGContext&) const override
   {
-    return is_opaque;
+    return body->is_opaque;
   }
 
   [[nodiscard]] bool isClassTy(CGContext&) const override
@@ -445,30 +481,57 @@ struct ClassType : public Type {
 
   [[nodiscard]] std::string getMangledName(CGContext&) const override
   {
-    return boost::lexical_cast<std::string>(name.length()) + name;
+    return boost::lexical_cast<std::string>(body->name.length())
+           + body->name;
   }
 
   [[nodiscard]] std::string getClassName(CGContext&) const override
   {
-    return name;
+    return body->name;
   }
 
   [[nodiscard]] std::string getUserDefinedTyName(CGContext&) const override
   {
-    return name;
+    return body->name;
   }
 
 private:
-  bool                        is_opaque;
-  std::vector<MemberVariable> members;
-  const std::string           name;
+  // Shared by the mutable and immutable types, since the body of an opaque
+  // class is set later
+  struct Body {
+    bool                        is_opaque;
+    std::vector<MemberVariable> members;
+    const std::string           name;
+
+    // If struct is created multiple times, the name will be duplicated, so
+    // create it only once and store it in this variable
+    llvm::StructType* type;
+  };
+
+  explicit ClassType(std::shared_ptr<Body>&& body) noexcept
+    : NominalType{false}
+    , body{std::move(body)}
+  {
+  }
+
+  ClassType(const ClassType& other, const bool is_mutable) noexcept
+    : NominalType{is_mutable}
+    , body{other.body}
+  {
+  }
+
+  [[nodiscard]] static std::shared_ptr<ClassType>
+  create(CGContext& ctx, std::shared_ptr<Body>&& body);
+
+  [[nodiscard]] llvm::Type* createLLVMType(CGContext&) const override
+  {
+    return body->type;
+  }
 
-  // If struct is created multiple times, the name will be duplicated, so create
-  // it only once and store it in this variable
-  llvm::StructType* type;
+  std::shared_ptr<Body> body;
 };
 
-struct UnionType : public Type {
+struct UnionType : public NominalType {
   struct TagWithType {
     TagWithType(std::string&& tag, const std::shared_ptr<Type>& type)
       : tag{std::move(tag)}
@@ -501,26 +564,14 @@ struct UnionType : public Type {
     UnionVariants     variants;
   };
 
-  UnionType(CGContext&         ctx,
-            const std::string& name,
-            Tags&&             members,
-            const bool         is_mutable);
-
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
-  {
-    return std::make_shared<UnionType>(*this);
-  }
+  [[nodiscard]] static std::shared_ptr<UnionType>
+  create(CGContext& ctx, const std::string& name, Tags&& members);
 
   [[nodiscard]] SignKind getSignKind(CGContext&) const override
   {
     return SignKind::no_sign;
   }
 
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext&) const override
-  {
-    return actual.basic_type;
-  }
-
   [[nodiscard]] bool isUnionTy(CGContext&) const override
   {
     return true;
@@ -545,6 +596,20 @@ struct UnionType : public Type {
   getUnionVariantType(const std::string& tag) const;
 
 private:
+  UnionType(CGContext& ctx, const std::string& name, Tags&& members);
+
+  UnionType(const UnionType& other, const bool is_mutable)
+    : NominalType{is_mutable}
+    , name{other.name}
+    , actual{other.actual}
+  {
+  }
+
+  [[nodiscard]] llvm::Type* createLLVMType(CGContext&) const override
+  {
+    return actual.basic_type;
+  }
+
   [[nodiscard]] static llvm::StructType*
   createBasicType(CGContext& ctx, const Tags& members, const std::string& name);
 
@@ -556,33 +621,15 @@ private:
 
   const std::string name;
 
-  Actual actual;
+  const Actual actual;
 };
 
 struct PointerType : public Type {
-  explicit PointerType(const std::shared_ptr<Type>& pointee_type,
-                       const bool                   is_mutable)
-    : Type{is_mutable}
-    , pointee_type{pointee_type}
-  {
-  }
-
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
-  {
-    return std::make_shared<PointerType>(*this);
-  }
-
   [[nodiscard]] bool isPointerTy(CGContext&) const override
   {
     return true;
   }
 
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const override
-  {
-    assert(pointee_type);
-    return llvm::PointerType::getUnqual(pointee_type->getLLVMType(ctx));
-  }
-
   [[nodiscard]] std::shared_ptr<Type> getPointeeType(CGContext&) const override
   {
     return pointee_type;
@@ -595,37 +642,33 @@ struct PointerType : public Type {
     return SignKind::unsigned_;
   }
 
-  void setMutable(CGContext& ctx, const bool is_mutable) override
-  {
-    this->is_mutable = is_mutable;
-    pointee_type->setMutable(ctx, is_mutable);
-  }
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) const override;
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getCanonicalType(CGContext& ctx) const override;
 
 private:
-  const std::shared_ptr<Type> pointee_type;
-};
+  friend struct CanonicalTypeTable;
 
-struct ArrayType : public Type {
-  ArrayType(const std::shared_ptr<Type>& element_type,
-            const std::uint64_t          array_size,
-            const bool                   is_mutable)
-    : Type{is_mutable}
-    , element_type{element_type}
-    , array_size{array_size}
+  PointerType(const std::shared_ptr<Type>& pointee_type,
+              const bool                   is_mutable) noexcept
+    : Type{is_mutable, pointee_type->dependsOnScope()}
+    , pointee_type{pointee_type}
   {
   }
 
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
+  [[nodiscard]] llvm::Type* createLLVMType(CGContext& ctx) const override
   {
-    return std::make_shared<ArrayType>(*this);
+    assert(pointee_type);
+    return llvm::PointerType::getUnqual(pointee_type->getLLVMType(ctx));
   }
 
-  [[nodiscard]] std::string getMangledName(CGContext& ctx) const override;
+  const std::shared_ptr<Type> pointee_type;
+};
 
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const override
-  {
-    return llvm::ArrayType::get(element_type->getLLVMType(ctx), array_size);
-  }
+struct ArrayType : public Type {
+  [[nodiscard]] std::string getMangledName(CGContext& ctx) const override;
 
   [[nodiscard]] std::shared_ptr<Type>
   getArrayElementType(CGContext&) const override
@@ -648,13 +691,29 @@ struct ArrayType : public Type {
     return SignKind::no_sign;
   }
 
-  void setMutable(CGContext& ctx, const bool is_mutable) override
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) const override;
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getCanonicalType(CGContext& ctx) const override;
+
+private:
+  friend struct CanonicalTypeTable;
+
+  ArrayType(const std::shared_ptr<Type>& element_type,
+            const std::uint64_t          array_size,
+            const bool                   is_mutable) noexcept
+    : Type{is_mutable, element_type->dependsOnScope()}
+    , element_type{element_type}
+    , array_size{array_size}
+  {
+  }
+
+  [[nodiscard]] llvm::Type* createLLVMType(CGContext& ctx) const override
   {
-    this->is_mutable = is_mutable;
-    element_type->setMutable(ctx, is_mutable);
+    return llvm::ArrayType::get(element_type->getLLVMType(ctx), array_size);
   }
 
-private:
   const std::shared_ptr<Type> element_type;
   const std::uint64_t         array_size;
 };
@@ -662,28 +721,11 @@ private:
 // Hold pointer type
 // However, implement so that dereferences are not required when referencing
 struct ReferenceType : public Type {
-  explicit ReferenceType(const std::shared_ptr<Type>& refee_type,
-                         const bool                   is_mutable)
-    : Type{is_mutable}
-    , refee_type{refee_type}
-  {
-  }
-
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
-  {
-    return std::make_shared<ReferenceType>(*this);
-  }
-
   [[nodiscard]] bool isRefTy(CGContext&) const override
   {
     return true;
   }
 
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const override
-  {
-    return llvm::PointerType::getUnqual(refee_type->getLLVMType(ctx));
-  }
-
   [[nodiscard]] std::shared_ptr<Type> getRefeeType(CGContext&) const override
   {
     return refee_type;
@@ -699,14 +741,79 @@ struct ReferenceType : public Type {
     return refee_type->getSignKind(ctx);
   }
 
-  void setMutable(CGContext& ctx, const bool is_mutable) override
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) const override;
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getCanonicalType(CGContext& ctx) const override;
+
+private:
+  friend struct CanonicalTypeTable;
+
+  ReferenceType(const std::shared_ptr<Type>& refee_type,
+                const bool                   is_mutable) noexcept
+    : Type{is_mutable, refee_type->dependsOnScope()}
+    , refee_type{refee_type}
+  {
+  }
+
+  [[nodiscard]] llvm::Type* createLLVMType(CGContext& ctx) const override
   {
-    this->is_mutable = is_mutable;
-    refee_type->setMutable(ctx, is_mutable);
+    return llvm::PointerType::getUnqual(refee_type->getLLVMType(ctx));
   }
 
+  const std::shared_ptr<Type> refee_type;
+};
+
+// Creates types of a translation unit, and returns the same object for the
+// same structure and mutability
+// Since the components of a type are canonical as well, types are looked up
+// by the addresses of the components
+struct CanonicalTypeTable : private boost::noncopyable {
+  [[nodiscard]] std::shared_ptr<Type>
+  getBuiltinType(const BuiltinTypeKind kind, const bool is_mutable);
+
+  [[nodiscard]] std::shared_ptr<UserDefinedType>
+  getUserDefinedType(const Symbol ident, const bool is_mutable);
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getPointerType(const std::shared_ptr<Type>& pointee_type,
+                 const bool                   is_mutable);
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getArrayType(const std::shared_ptr<Type>& element_type,
+               const std::uint64_t          array_size,
+               const bool                   is_mutable);
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getReferenceType(const std::shared_ptr<Type>& refee_type,
+                   const bool                   is_mutable);
+
+  // Registers a class type or a union type with the type of the other
+  // mutability
+  void addNominalType(const std::shared_ptr<NominalType>& immutable_type,
+                      const std::shared_ptr<NominalType>& mutable_type);
+
 private:
-  std::shared_ptr<Type> refee_type;
+  // Indexed by mutability
+  using Qualified = std::array<std::shared_ptr<Type>, 2>;
+
+  std::array<Qualified, static_cast<std::size_t>(BuiltinTypeKind::usize) + 1>
+    builtin_types;
+
+  std::unordered_map<Symbol,
+                     std::array<std::shared_ptr<UserDefinedType>, 2>>
+    user_defined_types;
+
+  std::unordered_map<const Type*, Qualified> pointer_types;
+
+  std::map<std::pair<const Type*, std::uint64_t>, Qualified> array_types;
+
+  std::unordered_map<const Type*, Qualified> reference_types;
+
+  // Nominal types refer to each other by raw pointers, so that they are kept
+  // alive while the table exists
+  std::vector<std::shared_ptr<NominalType>> nominal_types;
 };
 
 [[nodiscard]] std::shared_ptr<Type>
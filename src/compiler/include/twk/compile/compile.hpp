@@ -13,6 +13,7 @@
 #endif // _MSC_VER > 1000
 
 #include <context.hpp>
+#include <memory>
 #include <optional>
 #include <variant>
 #include <filesystem>
@@ -44,6 +45,42 @@ using CompileResult = std::variant<JITResult, AOTResult>;
 std::optional<CompileResult> compile(const Context&         ctx,
                                      const std::string_view argv_front);
 
+// Do the initialization shared by the compilations in this process, which is
+// otherwise done by the first compilation
+// The compile server calls this before forking the processes of requests
+void initializeCompiler();
+
+// Compiles the input files again when source files change, which is used by
+// --watch
+// Only the input files affected by the changes are compiled again, and the
+// others keep their created files
+struct IncrementalCompiler {
+  // Throws ErrorBase if the options cannot be used for incremental
+  // compilation, so that they are reported before any compilation
+  IncrementalCompiler(const Context& ctx, const std::string_view argv_front);
+
+  ~IncrementalCompiler();
+
+  IncrementalCompiler(const IncrementalCompiler&)            = delete;
+  IncrementalCompiler& operator=(const IncrementalCompiler&) = delete;
+
+  // The first call compiles all input files, and later calls compile the
+  // input files importing the changed files directly or indirectly, and the
+  // input files that failed to compile
+  // Returns the created files of all input files in the same order, or
+  // std::nullopt if the errors were written to stderr
+  [[nodiscard]] std::optional<AOTResult>
+  compile(const std::vector<std::filesystem::path>& changed_files);
+
+  // The input files and the files imported from them directly or indirectly
+  [[nodiscard]] std::vector<std::filesystem::path> getSourceFiles() const;
+
+private:
+  struct State;
+
+  std::unique_ptr<State> state;
+};
+
 } // namespace twk
 
 #endif
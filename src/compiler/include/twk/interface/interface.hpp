@@ -0,0 +1,103 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _48012ae4_370d_4982_9c0f_680c119294d0
+#define _48012ae4_370d_4982_9c0f_680c119294d0
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twk/pch/pch.hpp>
+#include <twk/ast/ast.hpp>
+#include <twk/parse/parser.hpp>
+#include <twk/support/position.hpp>
+#include <functional>
+#include <mutex>
+
+namespace twk::interface
+{
+
+// The part of a file used by the files importing it, which is the declarations
+// of public functions and the definitions of public classes
+//
+// With a cache directory, interfaces are stored in interface files (.twki), so
+// that imported files are loaded without parsing
+struct Interface {
+  ast::TranslationUnit ast;
+
+  // Refers to the source code the interface was loaded with
+  PositionTable positions;
+};
+
+// The interface file is named after the absolute path of the source file
+// Returns std::nullopt if the absolute path is unknown
+[[nodiscard]] std::optional<std::filesystem::path>
+getInterfacePath(const std::filesystem::path& interface_dir,
+                 const std::filesystem::path& source_file);
+
+[[nodiscard]] std::string
+serializeInterface(const parse::Parser::Result& parse_result);
+
+// Returns std::nullopt if the data is malformed, or was created from another
+// source code, with another AST or by another version of twk
+[[nodiscard]] std::optional<Interface>
+deserializeInterface(const std::string_view data, const SourceFile& source);
+
+// Load the interface from the interface file of the source file, or parse the
+// source code and write the interface file if it is missing or out of date
+// Without an interface directory, the source code is always parsed
+// Failure to write the interface file is not an error
+// The source code must outlive the interface
+[[nodiscard]] Interface
+loadInterface(const std::filesystem::path&                source_file,
+              const std::shared_ptr<const SourceFile>&    source,
+              const std::optional<std::filesystem::path>& interface_dir);
+
+// An imported file shared by the translation units importing it
+struct ImportedFile : private boost::noncopyable {
+  ImportedFile(std::shared_ptr<const SourceFile>&&           source,
+               const std::filesystem::path&                file,
+               const std::optional<std::filesystem::path>& interface_dir);
+
+  const std::shared_ptr<const SourceFile> source;
+
+  const Interface interface;
+};
+
+// Loads each imported file once per compilation, keyed by its canonical path
+// Thread-safe, since translation units are generated in parallel
+struct ImportCache : private boost::noncopyable {
+  // If the interface directory is set, interface files are used in it
+  explicit ImportCache(
+    const std::optional<std::filesystem::path>& interface_dir = std::nullopt)
+    : interface_dir{interface_dir}
+  {
+  }
+
+  // load_source is called only when the file is not loaded yet, and its
+  // exceptions are propagated
+  [[nodiscard]] std::shared_ptr<const ImportedFile>
+  load(const std::filesystem::path&                              file,
+       const std::function<std::shared_ptr<const SourceFile>()>& load_source);
+
+private:
+  struct Entry {
+    std::mutex                          mutex;
+    std::shared_ptr<const ImportedFile> file;
+  };
+
+  const std::optional<std::filesystem::path> interface_dir;
+
+  std::mutex mutex;
+
+  std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+};
+
+} // namespace twk::interface
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _c83e5a17_6f2d_4b90_a1e4_9d2b07f3c5a8
+#define _c83e5a17_6f2d_4b90_a1e4_9d2b07f3c5a8
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twk/pch/pch.hpp>
+#include <twk/support/exception.hpp>
+
+namespace twk::parse
+{
+
+enum class TokenKind : std::uint8_t {
+  word, // Identifiers and keywords
+  number,
+  string_literal,
+  char_literal,
+  punct, // A punctuation character
+  eoi,   // End of input
+};
+
+// Index of a keyword in the keyword table
+// Keywords are words used by the grammar, and are compared by their indexes
+// They are not reserved, so they can also be identifiers
+using KeywordID = std::uint8_t;
+
+inline constexpr KeywordID NOT_KEYWORD = std::numeric_limits<KeywordID>::max();
+
+// Returns NOT_KEYWORD if the word is not a keyword
+[[nodiscard]] KeywordID findKeyword(const std::string_view word) noexcept;
+
+struct Token {
+  // Byte offsets in the source code
+  std::uint32_t first;
+  std::uint32_t last;
+
+  TokenKind kind;
+
+  // The keyword of a word
+  KeywordID keyword;
+
+  // The character of a punctuation
+  char punct;
+
+  // Whether the next token follows without spaces or comments, so that
+  // operators of several characters are matched as punctuations in a row
+  bool joined;
+};
+
+struct LexError : public ErrorBase {
+  LexError(const std::string& what_arg, const std::uint32_t offset)
+    : ErrorBase{what_arg}
+    , offset{offset}
+  {
+  }
+
+  // Where the error occurred
+  const std::uint32_t offset;
+};
+
+// Tokenize the source code in one pass, skipping spaces and comments
+// The last token is always an eoi token at the end of the source code
+// Throws LexError for ill-formed UTF-8, and characters that do not start any
+// token
+[[nodiscard]] std::vector<Token> tokenize(const std::string_view source);
+
+} // namespace twk::parse
+
+#endif
@@ -14,18 +14,19 @@
 
 #include <twk/ast/ast.hpp>
 #include <twk/support/utils.hpp>
-#include <twk/support/typedef.hpp>
+#include <twk/support/position.hpp>
+#include <twk/parse/lexer.hpp>
 
 namespace twk::parse
 {
 
 struct Parser : private boost::noncopyable {
   struct Result {
-    // Since positions has a reference to input, it also holds input
-    std::string input;
+    // Since positions refer to the source code, it also holds the source
+    std::shared_ptr<const SourceFile> source;
 
     ast::TranslationUnit  ast;
-    PositionCache         positions;
+    PositionTable         positions;
     std::filesystem::path file;
   };
 
@@ -35,29 +36,38 @@ struct Parser : private boost::noncopyable {
 
     member_moved = true;
 
-    // The reason for also returning input is that positions has a reference to
-    // input
-    return {std::move(input),
+    // The reason for also returning the source is that positions refer to it
+    return {std::move(source),
             std::move(ast),
             std::move(positions),
             std::move(file)};
   }
 
-  Parser(std::string&& input, const std::filesystem::path& file);
+  // Parse errors are written to err_ostm
+  // A large file is split into top levels, which are parsed on up to jobs
+  // threads
+  Parser(std::shared_ptr<const SourceFile>&& source,
+         const std::filesystem::path&        file,
+         std::ostream&                       err_ostm = std::cerr,
+         const unsigned int                  jobs     = 1);
 
 private:
-  void parse();
+  void parse(const unsigned int jobs);
+
+  // Returns false if the file is not split or some chunk failed to parse
+  [[nodiscard]] bool parseChunks(const std::vector<const Token*>& boundaries,
+                                 const unsigned int               jobs);
 
   bool member_moved = false;
 
-  std::string         input;
-  InputIterator       u32_first;
-  const InputIterator u32_last;
+  std::shared_ptr<const SourceFile> source;
 
   ast::TranslationUnit ast;
-  PositionCache        positions;
+  PositionTable        positions;
 
   std::filesystem::path file;
+
+  std::ostream& err_ostm;
 };
 
 } // namespace twk::parse
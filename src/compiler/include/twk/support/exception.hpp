@@ -12,8 +12,8 @@
 #pragma once
 #endif // _MSC_VER > 1000
 
-#include <twk/pch/pch.hpp>
 #include <stdexcept>
+#include <string>
 
 namespace twk
 {
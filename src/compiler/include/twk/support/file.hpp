@@ -14,6 +14,7 @@
 
 #include <twk/pch/pch.hpp>
 #include <twk/support/exception.hpp>
+#include <twk/support/source_manager.hpp>
 
 namespace twk
 {
@@ -26,9 +27,21 @@ struct FileError : public ErrorBase {
   }
 };
 
-// Load a file to std::string.
-[[nodiscard]] std::string loadFile(const std::string_view       argv_front,
-                                   const std::filesystem::path& path);
+// Load a source file through the source manager.
+[[nodiscard]] std::shared_ptr<const SourceFile>
+loadFile(SourceManager&               source_manager,
+         const std::string_view       argv_front,
+         const std::filesystem::path& path);
+
+// Load a file to std::string, or return std::nullopt if it could not be read
+[[nodiscard]] std::optional<std::string>
+readFile(const std::filesystem::path& path);
+
+// Write to a temporary file and then rename it so that other processes never
+// see a partially written file
+// Failure to write is not an error, the file is just not written
+void writeFileAtomically(const std::filesystem::path& path,
+                         const std::string_view       contents);
 
 } // namespace twk
 
@@ -0,0 +1,151 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _3f8d2b61_7c0e_4a95_b1d4_58e9a6c27f03
+#define _3f8d2b61_7c0e_4a95_b1d4_58e9a6c27f03
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twk/pch/pch.hpp>
+#include <atomic>
+#include <deque>
+#include <shared_mutex>
+
+namespace twk
+{
+
+namespace detail
+{
+
+struct InternedString {
+  const std::string   str;
+  const std::size_t   hash;
+  const std::uint32_t id;
+};
+
+} // namespace detail
+
+// A string interned by the StringInterner, which is compared and hashed in
+// constant time
+// The default is the empty string, whose ID is 0
+struct Symbol {
+  Symbol() noexcept = default;
+
+  [[nodiscard]] const std::string& str() const noexcept
+  {
+    static const std::string empty_str;
+    return entry ? entry->str : empty_str;
+  }
+
+  // Unique and stable for the whole compilation, but depends on the order of
+  // interning
+  [[nodiscard]] std::uint32_t getID() const noexcept
+  {
+    return entry ? entry->id : 0;
+  }
+
+  // Same as the hash of the string, so that the iteration order of hash tables
+  // does not change from the tables keyed by strings
+  [[nodiscard]] std::size_t hash() const noexcept
+  {
+    return entry ? entry->hash : std::hash<std::string_view>{}({});
+  }
+
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return !entry;
+  }
+
+  [[nodiscard]] bool operator==(const Symbol& other) const noexcept
+  {
+    return entry == other.entry;
+  }
+
+  // Ordered by the strings, so that the order does not depend on the order of
+  // interning
+  [[nodiscard]] bool operator<(const Symbol& other) const noexcept
+  {
+    return entry != other.entry && str() < other.str();
+  }
+
+private:
+  friend struct StringInterner;
+
+  explicit Symbol(const detail::InternedString* entry) noexcept
+    : entry{entry}
+  {
+  }
+
+  const detail::InternedString* entry{};
+};
+
+// Interns identifiers and namespace paths for a compilation
+// Thread-safe, since files are parsed and generated in parallel
+// The strings are split into shards by their hashes to reduce contention, and
+// are freed with the interner, so symbols must not outlive it
+struct StringInterner : private boost::noncopyable {
+  [[nodiscard]] Symbol intern(const std::string_view str);
+
+  // The number of interned strings
+  [[nodiscard]] std::size_t size() const noexcept
+  {
+    return next_id.load(std::memory_order_relaxed) - 1;
+  }
+
+private:
+  static constexpr std::size_t SHARD_COUNT = 16;
+
+  struct Shard {
+    std::shared_mutex mutex;
+
+    // Elements of std::deque are not moved by push_back, so the keys of the
+    // index and symbols can refer to them
+    std::deque<detail::InternedString> strings;
+
+    std::unordered_map<std::string_view, const detail::InternedString*> index;
+  };
+
+  std::array<Shard, SHARD_COUNT> shards;
+
+  std::atomic<std::uint32_t> next_id{1};
+};
+
+// Makes the interner current in this thread while the scope lives
+// Each compilation has its own interner, so that the compile server and
+// --watch do not keep the strings of past compilations, and parallelFor
+// passes it on to the worker threads
+struct InternerScope : private boost::noncopyable {
+  explicit InternerScope(StringInterner& interner) noexcept;
+
+  ~InternerScope();
+
+private:
+  StringInterner* const previous;
+};
+
+// Returns the current interner of this thread, or the process-wide interner
+// outside any InternerScope
+[[nodiscard]] StringInterner& getStringInterner() noexcept;
+
+[[nodiscard]] inline Symbol intern(const std::string_view str)
+{
+  return getStringInterner().intern(str);
+}
+
+} // namespace twk
+
+template <>
+struct std::hash<twk::Symbol> {
+  [[nodiscard]] std::size_t operator()(const twk::Symbol& symbol) const noexcept
+  {
+    return symbol.hash();
+  }
+};
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _1f6b3c2e_5d0a_4b7e_9c41_8a2f7e6d3b90
+#define _1f6b3c2e_5d0a_4b7e_9c41_8a2f7e6d3b90
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twk/pch/pch.hpp>
+#include <twk/support/interner.hpp>
+#include <twk/support/timing.hpp>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+namespace twk
+{
+
+// Returns the number of threads used to process n tasks
+// If jobs is 0, the number of hardware threads is used as the upper bound
+[[nodiscard]] inline std::size_t getWorkerCount(const unsigned int jobs,
+                                                const std::size_t  n) noexcept
+{
+  const std::size_t max_jobs
+    = jobs ? jobs : std::max(1u, std::thread::hardware_concurrency());
+
+  return std::max<std::size_t>(1, std::min(max_jobs, n));
+}
+
+// Calls f(index, worker) for each index in [0, n)
+// The calling thread also works, so worker 0 is always the calling thread
+// Each index is processed even if other indexes throw an exception,
+// and then the exception of the smallest index is rethrown
+template <typename F>
+void parallelFor(const unsigned int jobs, const std::size_t n, F&& f)
+{
+  const auto worker_count = getWorkerCount(jobs, n);
+
+  std::vector<std::exception_ptr> exceptions(n);
+
+  std::atomic<std::size_t> next_idx{};
+
+  const auto work = [&](const std::size_t worker) {
+    for (;;) {
+      const auto idx = next_idx.fetch_add(1, std::memory_order_relaxed);
+
+      if (n <= idx)
+        return;
+
+      try {
+        f(idx, worker);
+      }
+      catch (...) {
+        exceptions[idx] = std::current_exception();
+      }
+    }
+  };
+
+  // Worker threads also record to the time trace of the calling thread
+  const auto time_trace = llvm::timeTraceProfilerEnabled();
+
+  // Worker threads intern strings to the interner of the calling thread
+  auto& interner = getStringInterner();
+
+  {
+    std::vector<std::thread> threads;
+
+    for (std::size_t worker = 1; worker < worker_count; ++worker) {
+      threads.emplace_back([&, worker] {
+        const WorkerTimeTraceScope time_trace_scope{time_trace};
+        const InternerScope        interner_scope{interner};
+        work(worker);
+      });
+    }
+
+    work(0);
+
+    for (auto& thread : threads)
+      thread.join();
+  }
+
+  for (const auto& exception : exceptions) {
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+}
+
+} // namespace twk
+
+#endif
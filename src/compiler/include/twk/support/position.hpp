@@ -0,0 +1,161 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _5b0f8e63_2c47_4d19_b8a6_e17d4c9a0f32
+#define _5b0f8e63_2c47_4d19_b8a6_e17d4c9a0f32
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twk/pch/pch.hpp>
+#include <twk/support/source_manager.hpp>
+#include <atomic>
+
+namespace twk
+{
+
+// Position of an AST node, which is a pair of byte offsets in the source file
+struct PositionRange {
+  std::uint32_t file_id;
+
+  // The first is the last for an empty node
+  std::uint32_t first;
+  std::uint32_t last;
+};
+
+// Positions of the AST nodes of a source file
+//
+// The id_first of an annotated node is the index in the table, and the id_last
+// is the ID of the source file, so that the table of a node is found without
+// searching even if the node is from an imported file
+struct PositionTable {
+  explicit PositionTable(const SourceFile& source) noexcept
+    : file_id{source.getID()}
+  {
+  }
+
+  // Called by the parser, and nodes not tagged with positions are ignored
+  template <typename AST>
+  void annotate(AST& ast, const std::uint32_t first, const std::uint32_t last)
+  {
+    if constexpr (std::is_base_of_v<boost::spirit::x3::position_tagged, AST>) {
+      ast.id_first = static_cast<int>(offsets.size());
+      ast.id_last  = static_cast<int>(file_id);
+
+      offsets.emplace_back(first, last);
+    }
+  }
+
+  // Copies the positions of consecutive IDs from first_id
+  // IDs skipped by the builders are never referred to, so they are left empty
+  void insert(
+    const std::uint32_t                                         first_id,
+    const std::vector<std::pair<std::uint32_t, std::uint32_t>>& positions)
+  {
+    if (offsets.size() < first_id + positions.size())
+      offsets.resize(first_id + positions.size());
+
+    std::ranges::copy(positions, offsets.begin() + first_id);
+  }
+
+  // Returns std::nullopt if the node is not annotated by this table
+  [[nodiscard]] std::optional<PositionRange>
+  find(const boost::spirit::x3::position_tagged& ast) const noexcept
+  {
+    if (static_cast<std::uint32_t>(ast.id_last) != file_id || ast.id_first < 0
+        || static_cast<std::size_t>(ast.id_first) >= offsets.size())
+      return std::nullopt;
+
+    const auto [first, last] = offsets[static_cast<std::size_t>(ast.id_first)];
+
+    return PositionRange{file_id, first, last};
+  }
+
+  [[nodiscard]] std::uint32_t getFileID() const noexcept
+  {
+    return file_id;
+  }
+
+private:
+  std::uint32_t file_id;
+
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> offsets;
+};
+
+// Annotates the AST nodes of a part of a source file, so that the parts of a
+// file are parsed in parallel
+// IDs are allocated in blocks from the counter shared by the parts, and the
+// positions are copied to the table after parsing
+struct PositionBuilder : private boost::noncopyable {
+  PositionBuilder(const PositionTable&        table,
+                  std::atomic<std::uint32_t>& next_id) noexcept
+    : file_id{table.getFileID()}
+    , next_id{next_id}
+  {
+  }
+
+  // Called by the parser, and nodes not tagged with positions are ignored
+  template <typename AST>
+  void annotate(AST& ast, const std::uint32_t first, const std::uint32_t last)
+  {
+    if constexpr (std::is_base_of_v<boost::spirit::x3::position_tagged, AST>) {
+      if (blocks.empty() || blocks.back().offsets.size() == BLOCK_SIZE)
+        allocateBlock();
+
+      auto& block = blocks.back();
+
+      ast.id_first = static_cast<int>(block.first_id + block.offsets.size());
+      ast.id_last  = static_cast<int>(file_id);
+
+      block.offsets.emplace_back(first, last);
+    }
+  }
+
+  void copyTo(PositionTable& table) const
+  {
+    assert(table.getFileID() == file_id);
+
+    for (const auto& block : blocks)
+      table.insert(block.first_id, block.offsets);
+  }
+
+private:
+  static constexpr std::uint32_t BLOCK_SIZE = 4096;
+
+  struct Block {
+    std::uint32_t first_id;
+
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> offsets;
+  };
+
+  void allocateBlock()
+  {
+    auto& block = blocks.emplace_back(
+      Block{next_id.fetch_add(BLOCK_SIZE, std::memory_order_relaxed), {}});
+
+    block.offsets.reserve(BLOCK_SIZE);
+  }
+
+  std::uint32_t file_id;
+
+  std::atomic<std::uint32_t>& next_id;
+
+  std::vector<Block> blocks;
+};
+
+// Returns the file ID of the annotated node
+[[nodiscard]] inline std::uint32_t
+getFileID(const boost::spirit::x3::position_tagged& ast) noexcept
+{
+  assert(ast.id_first >= 0);
+  return static_cast<std::uint32_t>(ast.id_last);
+}
+
+} // namespace twk
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _9e4c27d1_0b8a_4f63_a5d2_6c13f08b7e45
+#define _9e4c27d1_0b8a_4f63_a5d2_6c13f08b7e45
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twk/pch/pch.hpp>
+#include <llvm/Support/MemoryBuffer.h>
+#include <mutex>
+
+namespace twk
+{
+
+// The contents of a source file, which are memory-mapped if the file is large
+// enough
+// The line index is built on the first query, since it is only needed to
+// report errors
+struct SourceFile : private boost::noncopyable {
+  SourceFile(std::unique_ptr<llvm::MemoryBuffer>&& buffer,
+             const std::uint32_t                   id);
+
+  // Unique in the compilation
+  [[nodiscard]] std::uint32_t getID() const noexcept
+  {
+    return id;
+  }
+
+  [[nodiscard]] std::string_view text() const noexcept
+  {
+    return {buffer->getBufferStart(), buffer->getBufferSize()};
+  }
+
+  // Returns the 1-based line number of the byte offset
+  [[nodiscard]] std::size_t lineOf(const std::size_t offset) const;
+
+  // Returns the 1-based line without the line break
+  [[nodiscard]] std::string_view line(const std::size_t line_number) const;
+
+private:
+  [[nodiscard]] const std::vector<std::size_t>& getLineOffsets() const;
+
+  const std::unique_ptr<llvm::MemoryBuffer> buffer;
+
+  const std::uint32_t id;
+
+  mutable std::once_flag line_offsets_flag;
+
+  // Offsets of the beginnings of the lines
+  mutable std::vector<std::size_t> line_offsets;
+};
+
+// Owns the source files for the whole compilation, so that each file is read
+// once even if it is imported from several translation units
+// Thread-safe, since files are parsed and imported in parallel
+struct SourceManager : private boost::noncopyable {
+  // Returns nullptr if the file could not be read, or is too large for the
+  // 32-bit offsets of positions
+  [[nodiscard]] std::shared_ptr<const SourceFile>
+  load(const std::filesystem::path& path);
+
+  // The file is read again by the next load, which is used when the file is
+  // changed
+  // The contents loaded before are kept alive by their users
+  void invalidate(const std::filesystem::path& path);
+
+private:
+  std::mutex mutex;
+
+  std::uint32_t next_id{};
+
+  std::unordered_map<std::string, std::shared_ptr<const SourceFile>> files;
+};
+
+} // namespace twk
+
+#endif
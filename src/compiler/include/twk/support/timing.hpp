@@ -0,0 +1,86 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _acdda229_61cb_43f2_9d35_4cc0681fc68e
+#define _acdda229_61cb_43f2_9d35_4cc0681fc68e
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twk/pch/pch.hpp>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/Timer.h>
+
+namespace twk
+{
+
+// Records the spans of the compiler in the Chrome trace format while alive
+// Spans are created by llvm::TimeTraceScope on the calling thread and on the
+// worker threads started by parallelFor
+struct TimeTraceProfiler : private boost::noncopyable {
+  TimeTraceProfiler(const unsigned int     granularity,
+                    const std::string_view process_name);
+
+  ~TimeTraceProfiler();
+
+  // Returns false if the file could not be written
+  [[nodiscard]] bool write(const std::filesystem::path& path) const;
+};
+
+// Minimum duration of spans in microseconds, only valid while a
+// TimeTraceProfiler is alive
+[[nodiscard]] unsigned int getTimeTraceGranularity() noexcept;
+
+// Records the spans of a worker thread while alive, if the thread that started
+// the worker is recording
+struct WorkerTimeTraceScope : private boost::noncopyable {
+  explicit WorkerTimeTraceScope(const bool enabled);
+
+  ~WorkerTimeTraceScope();
+
+private:
+  const bool enabled;
+};
+
+// Wall and CPU time of each phase of the compiler
+// Phases are measured by PhaseScope on the thread that created TimeReport
+struct TimeReport : private boost::noncopyable {
+  TimeReport();
+
+  ~TimeReport();
+
+  void print(llvm::raw_ostream& ostm);
+
+private:
+  friend struct PhaseScope;
+
+  [[nodiscard]] llvm::Timer& getTimer(const std::string_view name);
+
+  llvm::TimerGroup group;
+
+  // Timers are destroyed before the group
+  std::vector<std::unique_ptr<llvm::Timer>> timers;
+
+  TimeReport* const prev;
+};
+
+// A phase of the time report, which is also a span of the time trace
+struct PhaseScope : private boost::noncopyable {
+  explicit PhaseScope(const std::string_view name);
+
+  ~PhaseScope();
+
+private:
+  llvm::TimeTraceScope trace_scope;
+
+  llvm::Timer* const timer;
+};
+
+} // namespace twk
+
+#endif
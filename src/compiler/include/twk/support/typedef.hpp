@@ -21,13 +21,7 @@ namespace twk
 // Using & Typedef
 //===----------------------------------------------------------------------===//
 
-using InputIterator
-  = boost::u8_to_u32_iterator<std::string::const_iterator, char32_t>;
-
-using PositionCache
-  = boost::spirit::x3::position_cache<std::vector<InputIterator>>;
-
-using PositionRange = boost::iterator_range<InputIterator>;
+using InputIterator = boost::u8_to_u32_iterator<const char*, char32_t>;
 
 } // namespace twk
 
@@ -23,8 +23,17 @@ using Codepoint = char32_t;
 
 [[nodiscard]] std::string utf32toUtf8(const std::u32string_view utf32_str);
 
+// ASCII strings are converted without decoding
 [[nodiscard]] std::u32string utf8toUtf32(const std::string_view utf8_str);
 
+[[nodiscard]] bool isAscii(const std::string_view str) noexcept;
+
+// Returns the offset of the first ill-formed sequence, or std::nullopt if the
+// string is valid UTF-8
+// Overlong forms, surrogates and codepoints over U+10FFFF are ill-formed
+[[nodiscard]] std::optional<std::size_t>
+findInvalidUtf8(const std::string_view str) noexcept;
+
 } // namespace twk::unicode
 
 #endif
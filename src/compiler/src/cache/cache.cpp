@@ -0,0 +1,156 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twk/cache/cache.hpp>
+#include <twk/support/file.hpp>
+#include <twk/support/utils.hpp>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/SHA1.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+[[nodiscard]] std::string
+hash(const std::initializer_list<std::string_view> fields)
+{
+  llvm::SHA1 sha1;
+
+  for (const auto& field : fields) {
+    // The length is also hashed so that the boundaries of fields are
+    // unambiguous
+    const std::uint64_t size = field.size();
+
+    sha1.update(
+      llvm::StringRef{reinterpret_cast<const char*>(&size), sizeof(size)});
+    sha1.update(llvm::StringRef{field.data(), field.size()});
+  }
+
+  return llvm::toHex(sha1.final(), true);
+}
+
+} // namespace
+
+namespace twk::cache
+{
+
+ObjectCache::ObjectCache(const std::filesystem::path& cache_dir,
+                         const unsigned int           opt_level,
+                         const std::string_view       target_triple,
+                         const std::string_view       relocation_model)
+  : cache_dir{cache_dir}
+  , config{fmt::format("{}\n{}\n{}\n{}",
+                       VERSION,
+                       opt_level,
+                       target_triple,
+                       relocation_model)}
+{
+}
+
+[[nodiscard]] std::optional<std::string>
+ObjectCache::createKey(const std::filesystem::path& source_file,
+                       const std::string_view       source) const
+{
+  // Imported files are resolved relative to the source file, so the same
+  // contents in another directory must have another key
+  std::error_code ec;
+  const auto      absolute_path = fs::absolute(source_file, ec);
+
+  if (ec)
+    return std::nullopt;
+
+  return hash({config, absolute_path.lexically_normal().string(), source});
+}
+
+[[nodiscard]] std::optional<std::filesystem::path>
+ObjectCache::lookup(const std::optional<std::string>& key)
+{
+  const auto miss = [this]() -> std::optional<fs::path> {
+    ++misses;
+    return std::nullopt;
+  };
+
+  if (!key)
+    return miss();
+
+  const auto manifest = readFile(getManifestPath(*key));
+
+  if (!manifest)
+    return miss();
+
+  std::istringstream ss{*manifest};
+
+  for (std::string line; std::getline(ss, line);) {
+    // Each line is '<hash> <path>'
+    const auto separator = line.find(' ');
+
+    if (separator == std::string::npos)
+      return miss();
+
+    const auto contents = readFile(line.substr(separator + 1));
+
+    if (!contents || hash({*contents}) != line.substr(0, separator))
+      return miss();
+  }
+
+  auto object_path = getObjectPath(*key, *manifest);
+
+  if (std::error_code ec; !fs::exists(object_path, ec))
+    return miss();
+
+  ++hits;
+  return object_path;
+}
+
+void ObjectCache::store(
+  const std::string&                        key,
+  const std::vector<std::filesystem::path>& imported_files,
+  const std::filesystem::path&              object_file) const
+{
+  std::string manifest;
+
+  for (const auto& file : imported_files) {
+    const auto contents = readFile(file);
+
+    if (!contents)
+      return;
+
+    manifest += fmt::format("{} {}\n", hash({*contents}), file.string());
+  }
+
+  const auto object = readFile(object_file);
+
+  if (!object)
+    return;
+
+  std::error_code ec;
+  fs::create_directories(cache_dir, ec);
+
+  if (ec)
+    return;
+
+  // The object file is written first so that the manifest never refers to a
+  // missing object file
+  writeFileAtomically(getObjectPath(key, manifest), *object);
+  writeFileAtomically(getManifestPath(key), manifest);
+}
+
+[[nodiscard]] std::filesystem::path
+ObjectCache::getManifestPath(const std::string& key) const
+{
+  return cache_dir / (key + ".manifest");
+}
+
+[[nodiscard]] std::filesystem::path
+ObjectCache::getObjectPath(const std::string& key,
+                           const std::string& manifest) const
+{
+  return cache_dir / (hash({key, manifest}) + ".o");
+}
+
+} // namespace twk::cache
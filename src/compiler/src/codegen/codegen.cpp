@@ -10,8 +10,21 @@
 #include <twk/codegen/type.hpp>
 #include <twk/codegen/exception.hpp>
 #include <twk/unicode/unicode.hpp>
+#include <twk/support/parallel.hpp>
+#include <twk/support/timing.hpp>
 #include <cassert>
+#include <mutex>
 #include <boost/filesystem.hpp>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Bitcode/BitcodeWriterPass.h>
+#include <llvm/LTO/LTO.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/ProfileData/InstrProfReader.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/Caching.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Transforms/IPO/Internalize.h>
 
 #if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
 #include <unistd.h> // isatty
@@ -27,178 +40,277 @@ namespace
     .native();
 }
 
-} // namespace
+[[nodiscard]] llvm::OptimizationLevel
+toOptimizationLevel(const unsigned int opt_level)
+{
+  switch (opt_level) {
+  case 0:
+    return llvm::OptimizationLevel::O0;
+  case 1:
+    return llvm::OptimizationLevel::O1;
+  case 2:
+    return llvm::OptimizationLevel::O2;
+  case 3:
+    return llvm::OptimizationLevel::O3;
+  default:
+    unreachable();
+  }
+}
 
-namespace twk::codegen
+// Instrumented executables write the profile to this file at exit
+// LLVM_PROFILE_FILE overrides it as with clang
+constexpr std::string_view PROFILE_GENERATE_FILE = "default_%m.profraw";
+
+[[nodiscard]] std::optional<llvm::PGOOptions>
+createPGOOptions(const bool                                  profile_generate,
+                 const std::optional<std::filesystem::path>& profile_use)
 {
+  assert(!(profile_generate && profile_use));
 
-[[nodiscard]] std::optional<std::shared_ptr<Type>>
-CreatedClassTemplateTable::operator[](
-  const CreatedClassTemplateTableKey& key) const
+  if (profile_generate) {
+    return llvm::PGOOptions{std::string{PROFILE_GENERATE_FILE},
+                            "",
+                            "",
+                            llvm::PGOOptions::IRInstr};
+  }
+
+  if (profile_use) {
+    return llvm::PGOOptions{profile_use->string(),
+                            "",
+                            "",
+                            llvm::PGOOptions::IRUse};
+  }
+
+  return std::nullopt;
+}
+
+// Run the module optimization pipeline of the new pass manager
+// If pgo_options is set, the module is instrumented or the profile is attached
+// to it by the pipeline
+// If thin_lto_ostream is not null, the ThinLTO pre-link pipeline is run
+// instead, and the module is written to it as bitcode with a module summary
+void runModulePipeline(
+  llvm::Module&                          module,
+  const unsigned int                     opt_level,
+  llvm::TargetMachine&                   target_machine,
+  const std::optional<llvm::PGOOptions>& pgo_options,
+  llvm::raw_ostream*                     thin_lto_ostream = nullptr)
 {
-  for (const auto& r : table) {
-    auto& [name, args, namespace_] = r.first;
+  llvm::LoopAnalysisManager     lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager    cgam;
+  llvm::ModuleAnalysisManager   mam;
 
-    const auto template_arg_types_of_keyarg = std::get<1>(key);
+  llvm::PassBuilder pass_builder{
+    &target_machine,
+    llvm::PipelineTuningOptions{},
+    pgo_options ? llvm::Optional<llvm::PGOOptions>{*pgo_options} : llvm::None};
 
-    if (std::get<0>(key) == name) {
-      for (std::size_t idx = 0;
-           const auto& type : template_arg_types_of_keyarg.types) {
-        const auto pos = ctx.positionOf(template_arg_types_of_keyarg);
+  pass_builder.registerModuleAnalyses(mam);
+  pass_builder.registerCGSCCAnalyses(cgam);
+  pass_builder.registerFunctionAnalyses(fam);
+  pass_builder.registerLoopAnalyses(lam);
+  pass_builder.crossRegisterProxies(lam, fam, cgam, mam);
 
-        const auto t1 = createType(ctx, args.types.at(idx), pos);
-        const auto t2 = createType(ctx, type, pos);
+  const auto level = toOptimizationLevel(opt_level);
 
-        assert(t1->getLLVMType(ctx) && t2->getLLVMType(ctx));
+  const auto pre_link = thin_lto_ostream != nullptr;
 
-        // Mangled name comparisons allow pure type comparisons (aliased types
-        // can also be compared to ordinary types)
-        if (t1->getMangledName(ctx) == t2->getMangledName(ctx))
-          return r.second;
+  auto mpm
+    = level == llvm::OptimizationLevel::O0
+        ? pass_builder.buildO0DefaultPipeline(level, pre_link)
+        : (pre_link ? pass_builder.buildThinLTOPreLinkDefaultPipeline(level)
+                    : pass_builder.buildPerModuleDefaultPipeline(level));
 
-        ++idx;
-      }
-    }
-  }
+  // The module hash is the key of the ThinLTO cache
+  if (pre_link)
+    mpm.addPass(llvm::BitcodeWriterPass{*thin_lto_ostream, false, true, true});
 
-  return std::nullopt;
+  mpm.run(module, mam);
 }
 
-void CreatedClassTemplateTable::insert(CreatedClassTemplateTableKey&& key,
-                                       const std::shared_ptr<Type>&   value)
+} // namespace
+
+namespace twk::codegen
 {
-  const auto r = table.insert(
-    std::move(CreatedClassTemplateTableElem{std::move(key), value}));
 
-  assert(r.second);
+// Initialize only once, since a process such as --watch creates CodeGenerator
+// many times
+void initializeTargets()
+{
+  static std::once_flag once;
+
+  std::call_once(once, []() {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmParsers();
+    llvm::InitializeAllAsmPrinters();
+  });
 }
 
-template <typename R = std::vector<std::string>>
-[[nodiscard]] static R splitByLine(const std::string& str)
+void verifyProfile(const std::string&     profile_file,
+                   const std::string_view argv_front)
 {
-  std::istringstream ss{str};
-  R                  lines;
-
-  for (;;) {
-    std::string line;
-    if (std::getline(ss, line))
-      lines.emplace_back(line);
-    else
-      return lines;
-  }
+  auto reader = llvm::IndexedInstrProfReader::create(profile_file);
 
-  unreachable();
+  if (auto err = reader.takeError()) {
+    throw ErrorBase{formatError(
+      argv_front,
+      fmt::format("{}: {}", profile_file, llvm::toString(std::move(err))))};
+  }
 }
 
 //===----------------------------------------------------------------------===//
 // Code generator
 //===----------------------------------------------------------------------===//
 
-CGContext::CGContext(llvm::LLVMContext&      context,
-                     PositionCache&&         current_file_poscache,
-                     std::filesystem::path&& current_file,
-                     const std::string&      source_code,
-                     const unsigned int      opt_level,
-                     const bool              jit) noexcept
+CGContext::CGContext(llvm::LLVMContext&                  context,
+                     SourceManager&                      source_manager,
+                     interface::ImportCache&             import_cache,
+                     PositionTable&&                     current_file_positions,
+                     std::filesystem::path&&             current_file,
+                     std::shared_ptr<const SourceFile>&& source)
   : context{context}
   , module{std::make_unique<llvm::Module>(current_file.filename().string(),
                                           context)}
   , builder{context}
   , current_file{std::move(current_file)}
-  , created_class_template_table{*this}
+  , source_manager{source_manager}
+  , import_cache{import_cache}
   , mangler{*this}
-  , fpm{module.get()}
-  , jit{jit}
 {
-  if (!jit) {
-    // Setup pass manager
-    llvm::PassManagerBuilder builder;
-
-    builder.OptLevel = opt_level;
-
-    builder.populateFunctionPassManager(fpm);
-  }
-
-  fpm.doInitialization();
-
-  const auto current_filename = this->current_file.string();
-
-  source_code_table.insert(current_filename, splitByLine(source_code));
-
-  position_cache_table.insert(current_filename,
-                              std::move(current_file_poscache));
+  addFile(this->current_file.string(),
+          source,
+          std::make_shared<const PositionTable>(
+            std::move(current_file_positions)));
 }
 
 [[nodiscard]] std::string
 CGContext::formatError(const PositionRange&   pos,
                        const std::string_view message) const
 {
-  const auto rows = calcRows(pos);
+  const auto& file = getFile(pos.file_id);
 
-  const auto source_code = source_code_table[current_file];
-  assert(source_code);
+  const auto rows = file.source->lineOf(pos.first);
 
-  return fmt::format("In file {}, line {}:\n", current_file.string(), rows)
+  return fmt::format("In file {}, line {}:\n", file.name, rows)
          + fmt::format(fg(fmt::terminal_color::bright_red), "error: ")
          + fmt::format(fg(fmt::terminal_color::bright_white), "{}\n", message)
-         + boost::algorithm::trim_copy(source_code->get().at(rows - 1));
+         + boost::algorithm::trim_copy(std::string{file.source->line(rows)});
 }
 
-[[nodiscard]] std::size_t CGContext::calcRows(const PositionRange& pos) const
+void CGContext::addFile(std::string&&                               name,
+                        const std::shared_ptr<const SourceFile>&    source,
+                        const std::shared_ptr<const PositionTable>& positions)
 {
-  std::size_t rows{};
+  assert(source->getID() == positions->getFileID());
 
-  for (auto iter = pos.begin();; --iter) {
-    if (*iter == U'\n')
-      ++rows;
+  const auto file_id = source->getID();
 
-    if (iter == getCurrentPosCache().first())
-      return ++rows;
-  }
+  if (files.size() <= file_id)
+    files.resize(file_id + 1);
 
-  unreachable();
+  if (!files[file_id])
+    files[file_id] = ParsedFile{std::move(name), source, positions};
 }
 
 CodeGenerator::CodeGenerator(
-  const std::string_view               argv_front,
-  std::vector<parse::Parser::Result>&& parse_results,
-  const unsigned int                   opt_level,
-  const llvm::Reloc::Model             relocation_model,
-  const std::optional<std::string>&    target_triple_arg,
-  const bool                           jit)
+  const std::string_view                      argv_front,
+  SourceManager&                              source_manager,
+  std::vector<parse::Parser::Result>&&        parse_results,
+  const unsigned int                          opt_level,
+  const llvm::Reloc::Model                    relocation_model,
+  const std::optional<std::string>&           target_triple_arg,
+  const bool                                  jit,
+  const bool                                  lto,
+  const bool                                  thin_lto,
+  const bool                                  whole_program,
+  const std::optional<std::filesystem::path>& cache_dir,
+  const unsigned int                          jobs,
+  const bool                                  profile_generate,
+  const std::optional<std::filesystem::path>& profile_use)
   : argv_front{argv_front}
-  , context{std::make_unique<llvm::LLVMContext>()}
+  , source_manager{source_manager}
   , relocation_model{relocation_model}
-  , parse_results{parse_results}
+  , opt_level{opt_level}
+  , thin_lto{thin_lto}
+  , whole_program{whole_program}
+  , thin_lto_cache_dir{cache_dir ? std::make_optional(*cache_dir / "thinlto")
+                                 : std::nullopt}
+  , jobs{jobs}
+  , pgo_options{createPGOOptions(profile_generate, profile_use)}
+  , results(parse_results.size())
+  , parse_results{std::move(parse_results)}
+  , import_cache{cache_dir ? std::make_optional(*cache_dir / "interfaces")
+                           : std::nullopt}
 {
-  results.reserve(parse_results.size());
-
-  llvm::InitializeAllTargetInfos();
-  llvm::InitializeAllTargets();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllAsmParsers();
-  llvm::InitializeAllAsmPrinters();
+  initializeTargets();
 
   initTargetTripleAndMachine(target_triple_arg);
 
-  for (auto it = parse_results.begin(), last = parse_results.end(); it != last;
-       ++it) {
-    verifyOptLevel(opt_level);
+  verifyOptLevel(opt_level);
 
-    CGContext ctx{*context,
-                  std::move(it->positions),
-                  std::move(it->file),
-                  it->input,
-                  opt_level,
-                  jit};
+  // Error messages are collected per translation unit so that they are
+  // reported in the same order as the input files
+  std::vector<std::optional<std::string>> error_messages(results.size());
 
-    ctx.module->setTargetTriple(target_triple);
-    ctx.module->setDataLayout(target_machine->createDataLayout());
+  {
+    const PhaseScope phase{"Code generation"};
 
-    codegen(it->ast, ctx);
+    parallelFor(jobs, results.size(), [&](const std::size_t idx, std::size_t) {
+      try {
+        results[idx] = codegen(this->parse_results[idx]);
+      }
+      catch (const ErrorBase& err) {
+        error_messages[idx] = err.what();
+      }
+    });
+  }
+
+  std::string error_message;
 
-    results.emplace_back(std::move(ctx.module), std::move(ctx.current_file));
+  for (const auto& r : error_messages) {
+    if (r)
+      error_message += *r + (isBackNewline(r->c_str()) ? "" : "\n");
   }
+
+  if (!error_message.empty())
+    throw CodegenError{error_message};
+
+  // The JIT compiler and ThinLTO run their own pipelines, but the profile is
+  // attached by the module pipeline so that the CFG matches the instrumented
+  // one
+  if (lto)
+    performLTO();
+  else if (!thin_lto && (!jit || pgo_options))
+    optimizeModules();
+}
+
+[[nodiscard]] CodeGenerator::Result
+CodeGenerator::codegen(parse::Parser::Result& parse_result)
+{
+  const llvm::TimeTraceScope scope{"CodegenFile",
+                                   parse_result.file.string()};
+
+  auto context = std::make_unique<llvm::LLVMContext>();
+
+  CGContext ctx{*context,
+                source_manager,
+                import_cache,
+                std::move(parse_result.positions),
+                std::move(parse_result.file),
+                std::move(parse_result.source)};
+
+  ctx.module->setTargetTriple(target_triple);
+  ctx.module->setDataLayout(target_machine->createDataLayout());
+
+  codegen(parse_result.ast, ctx);
+
+  return {std::move(context),
+          std::move(ctx.module),
+          std::move(ctx.current_file),
+          std::move(ctx.imported_files)};
 }
 
 void CodeGenerator::verifyOptLevel(const unsigned int opt_level) const
@@ -219,7 +331,7 @@ void CodeGenerator::verifyOptLevel(const unsigned int opt_level) const
   FilePaths created_files;
 
   for (auto it = results.begin(), last = results.end(); it != last; ++it) {
-    const auto& file = std::get<std::filesystem::path>(*it);
+    const auto& file = it->file;
 
     const auto output_file = file.stem().string() + ".ll";
 
@@ -236,7 +348,7 @@ void CodeGenerator::verifyOptLevel(const unsigned int opt_level) const
         fmt::format("{}: {}", file.string(), ostream_ec.message()))};
     }
 
-    std::get<std::unique_ptr<llvm::Module>>(*it)->print(os, nullptr);
+    it->module->print(os, nullptr);
   }
 
   return created_files;
@@ -263,31 +375,25 @@ void CodeGenerator::verifyOptLevel(const unsigned int opt_level) const
 
   jit_compiled = true;
 
+  // Including the execution of the program
+  const PhaseScope phase{"JIT"};
+
   auto jit_expected = jit::JitCompiler::create();
   if (auto err = jit_expected.takeError())
     throw CodegenError{formatError(argv_front, llvm::toString(std::move(err)))};
 
   auto jit = std::move(*jit_expected);
 
-  auto [front_module, file] = std::move(results.front());
-
-  // Link all modules
-  for (auto it = results.begin() + 1, last = results.end(); it != last; ++it) {
-    auto [module, file] = std::move(*it);
-
-    if (llvm::Linker::linkModules(*front_module, std::move(module))) {
+  // Each module is added with its own context, so there is no need to link
+  // them. Symbols are resolved across modules by the JIT
+  for (auto&& result : results) {
+    if (auto err = jit->addModule(
+          {std::move(result.module), std::move(result.context)})) {
       throw CodegenError{
-        formatError(argv_front,
-                    fmt::format("{}: Could not link", file.string()))};
+        formatError(result.file.string(), llvm::toString(std::move(err)))};
     }
   }
 
-  if (auto err
-      = jit->addModule({std::move(front_module), std::move(context)})) {
-    throw CodegenError{
-      formatError(file.string(), llvm::toString(std::move(err)))};
-  }
-
   auto symbol_expected = jit->lookup("main");
   if (auto err = symbol_expected.takeError()) {
     throw CodegenError{
@@ -303,6 +409,105 @@ void CodeGenerator::verifyOptLevel(const unsigned int opt_level) const
   return main_addr();
 }
 
+void CodeGenerator::optimizeModules()
+{
+  const PhaseScope phase{"Optimization"};
+
+  std::vector<std::unique_ptr<llvm::TargetMachine>> target_machines(
+    getWorkerCount(jobs, results.size()));
+
+  parallelFor(
+    jobs,
+    results.size(),
+    [&](const std::size_t idx, const std::size_t worker) {
+      auto& machine = target_machines[worker];
+
+      if (!machine)
+        machine = createTargetMachine();
+
+      const llvm::TimeTraceScope scope{"OptimizeFile",
+                                       results[idx].file.string()};
+
+      runModulePipeline(*results[idx].module,
+                        opt_level,
+                        *machine,
+                        pgo_options);
+    });
+}
+
+void CodeGenerator::performLTO()
+{
+  assert(!results.empty());
+
+  const PhaseScope phase{"LTO"};
+
+  Result linked{std::make_unique<llvm::LLVMContext>(),
+                nullptr,
+                results.front().file,
+                {}};
+
+  linked.module = std::make_unique<llvm::Module>(
+    linked.file.filename().string(),
+    *linked.context);
+
+  linked.module->setTargetTriple(target_triple);
+  linked.module->setDataLayout(target_machine->createDataLayout());
+
+  llvm::Linker linker{*linked.module};
+
+  for (auto&& result : results) {
+    // Each module has its own context, so move it to the context of the linked
+    // module through bitcode
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream  ostream{buffer};
+
+    llvm::WriteBitcodeToFile(*result.module, ostream);
+
+    auto module = llvm::parseBitcodeFile(
+      llvm::MemoryBufferRef{llvm::StringRef{buffer.data(), buffer.size()},
+                            result.file.string()},
+      *linked.context);
+
+    if (auto err = module.takeError()) {
+      throw CodegenError{
+        formatError(argv_front, llvm::toString(std::move(err)))};
+    }
+
+    if (linker.linkInModule(std::move(*module))) {
+      throw CodegenError{
+        formatError(argv_front,
+                    fmt::format("{}: Could not link", result.file.string()))};
+    }
+
+    linked.imported_files.insert(linked.imported_files.end(),
+                                 result.imported_files.begin(),
+                                 result.imported_files.end());
+  }
+
+  // Object and assembly files are linked with others, which may refer to any
+  // external symbol
+  if (whole_program) {
+    llvm::internalizeModule(*linked.module, [](const llvm::GlobalValue& value) {
+      return value.getName() == "main";
+    });
+  }
+
+  runModulePipeline(*linked.module, opt_level, *target_machine, pgo_options);
+
+  results.clear();
+  results.push_back(std::move(linked));
+}
+
+[[nodiscard]] std::vector<FilePaths> CodeGenerator::getImportedFiles() const
+{
+  std::vector<FilePaths> imported_files;
+
+  for (const auto& r : results)
+    imported_files.push_back(r.imported_files);
+
+  return imported_files;
+}
+
 void CodeGenerator::codegen(const ast::TranslationUnit& ast, CGContext& ctx)
 {
   for (const auto& node : ast)
@@ -327,42 +532,262 @@ CodeGenerator::emitFiles(const llvm::CodeGenFileType cgft,
       {  llvm::CodeGenFileType::CGFT_ObjectFile, "o"}
   };
 
+  // Output file names are decided before emitting so that they do not depend
+  // on the order in which the threads run
   FilePaths created_files;
 
   for (auto it = results.begin(), last = results.end(); it != last; ++it) {
-    const auto& file = std::get<std::filesystem::path>(*it);
+    created_files.push_back(
+      (create_as_tmpfile ? createTemporaryFilepath() : it->file.stem().string())
+      + "." + extension_map.at(cgft));
+  }
 
-    const auto output_file
-      = (create_as_tmpfile ? createTemporaryFilepath() : file.stem().string())
-        + "." + extension_map.at(cgft);
+  if (thin_lto)
+    return emitFilesWithThinLTO(cgft, std::move(created_files));
 
-    created_files.push_back(output_file);
+  std::vector<std::unique_ptr<llvm::TargetMachine>> target_machines(
+    getWorkerCount(jobs, results.size()));
 
-    std::error_code      ostream_ec;
-    llvm::raw_fd_ostream ostream{output_file,
-                                 ostream_ec,
-                                 llvm::sys::fs::OpenFlags::OF_None};
+  parallelFor(
+    jobs,
+    results.size(),
+    [&](const std::size_t idx, const std::size_t worker) {
+      const auto& file        = results[idx].file;
+      const auto& output_file = created_files[idx];
 
-    if (ostream_ec) {
-      throw CodegenError{formatError(
-        argv_front,
-        fmt::format("{}: {}\n", file.string(), ostream_ec.message()))};
+      const llvm::TimeTraceScope scope{"EmitFile", file.string()};
+
+      auto& machine = target_machines[worker];
+
+      if (!machine)
+        machine = createTargetMachine();
+
+      std::error_code      ostream_ec;
+      llvm::raw_fd_ostream ostream{output_file.string(),
+                                   ostream_ec,
+                                   llvm::sys::fs::OpenFlags::OF_None};
+
+      if (ostream_ec) {
+        throw CodegenError{formatError(
+          argv_front,
+          fmt::format("{}: {}\n", file.string(), ostream_ec.message()))};
+      }
+
+      llvm::legacy::PassManager p_manager;
+
+      if (machine->addPassesToEmitFile(p_manager, ostream, nullptr, cgft))
+        throw CodegenError{formatError(argv_front, "failed to emit a file")};
+
+      p_manager.run(*results[idx].module);
+      ostream.flush();
+    });
+
+  return created_files;
+}
+
+[[nodiscard]] FilePaths
+CodeGenerator::emitFilesWithThinLTO(const llvm::CodeGenFileType cgft,
+                                    FilePaths&&                 output_files)
+{
+  assert(output_files.size() == results.size());
+
+  const auto throw_error = [this](llvm::Error err) {
+    throw CodegenError{formatError(argv_front, llvm::toString(std::move(err)))};
+  };
+
+  // Bitcode with a module summary of each translation unit
+  std::vector<llvm::SmallVector<char, 0>> bitcodes(results.size());
+
+  std::vector<std::unique_ptr<llvm::TargetMachine>> target_machines(
+    getWorkerCount(jobs, results.size()));
+
+  parallelFor(
+    jobs,
+    results.size(),
+    [&](const std::size_t idx, const std::size_t worker) {
+      auto& machine = target_machines[worker];
+
+      if (!machine)
+        machine = createTargetMachine();
+
+      llvm::raw_svector_ostream ostream{bitcodes[idx]};
+
+      runModulePipeline(*results[idx].module,
+                        opt_level,
+                        *machine,
+                        pgo_options,
+                        &ostream);
+    });
+
+  llvm::lto::Config config;
+
+  config.CPU           = "generic";
+  config.RelocModel    = relocation_model;
+  config.OptLevel      = opt_level;
+  config.CGFileType    = cgft;
+  config.DefaultTriple = target_triple;
+  config.UseNewPM      = true;
+
+  // The backend threads of ThinLTO record to the time trace by themselves
+  config.TimeTraceEnabled     = llvm::timeTraceProfilerEnabled();
+  config.TimeTraceGranularity = getTimeTraceGranularity();
+
+  llvm::lto::LTO lto{
+    std::move(config),
+    llvm::lto::createInProcessThinBackend(
+      llvm::heavyweight_hardware_concurrency(jobs))};
+
+  // The identifiers are referred by LTO until it finishes running, and must be
+  // unique among the modules
+  std::vector<std::string> module_ids;
+
+  for (const auto& r : results)
+    module_ids.push_back(r.file.string());
+
+  std::vector<std::unique_ptr<llvm::lto::InputFile>> inputs;
+
+  for (std::size_t idx = 0; idx < results.size(); ++idx) {
+    auto input = llvm::lto::InputFile::create(llvm::MemoryBufferRef{
+      llvm::StringRef{bitcodes[idx].data(), bitcodes[idx].size()},
+      module_ids[idx]});
+
+    if (auto err = input.takeError())
+      throw_error(std::move(err));
+
+    inputs.push_back(std::move(*input));
+  }
+
+  // The prevailing definition of each symbol is decided as with linkers
+  // A strong definition prevails over weak ones, and the first weak one
+  // prevails over the others, but two strong definitions conflict
+  struct Definition {
+    std::size_t idx;
+    bool        is_weak;
+  };
+
+  std::unordered_map<std::string, Definition> prevailing;
+
+  for (std::size_t idx = 0; idx < inputs.size(); ++idx) {
+    for (const auto& symbol : inputs[idx]->symbols()) {
+      if (symbol.isUndefined())
+        continue;
+
+      const auto [iter, inserted] = prevailing.try_emplace(
+        symbol.getName().str(),
+        Definition{idx, symbol.isWeak()});
+
+      if (inserted || symbol.isWeak())
+        continue;
+
+      if (!iter->second.is_weak) {
+        throw CodegenError{formatError(
+          argv_front,
+          fmt::format("multiple definition of '{}' in {} and {}",
+                      symbol.getName().str(),
+                      module_ids[iter->second.idx],
+                      module_ids[idx]))};
+      }
+
+      iter->second = {idx, false};
     }
+  }
+
+  for (std::size_t idx = 0; idx < inputs.size(); ++idx) {
+    std::vector<llvm::lto::SymbolResolution> resolutions;
+
+    for (const auto& symbol : inputs[idx]->symbols()) {
+      llvm::lto::SymbolResolution resolution;
+
+      if (!symbol.isUndefined()) {
+        resolution.Prevailing
+          = prevailing.at(symbol.getName().str()).idx == idx;
+        resolution.FinalDefinitionInLinkageUnit = true;
+      }
 
-    llvm::legacy::PassManager p_manager;
+      // Unless it is the whole program, other object files may refer to any
+      // external symbol
+      resolution.VisibleToRegularObj = symbol.isUndefined() || !whole_program
+                                       || symbol.getName() == "main";
 
-    if (target_machine->addPassesToEmitFile(p_manager,
-                                            ostream,
-                                            nullptr,
-                                            cgft)) {
-      throw CodegenError{formatError(argv_front, "failed to emit a file")};
+      resolutions.push_back(resolution);
     }
 
-    p_manager.run(*std::get<std::unique_ptr<llvm::Module>>(*it));
-    ostream.flush();
+    if (auto err = lto.add(std::move(inputs[idx]), resolutions))
+      throw_error(std::move(err));
   }
 
-  return created_files;
+  // Task 0 is for the regular LTO module, which is empty since all modules
+  // have summaries. Each translation unit is task 1 or later in order
+  const auto get_output_file
+    = [&](const unsigned int task) -> llvm::Expected<std::string> {
+    if (task == 0 || task > output_files.size()) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "unexpected ThinLTO task %u",
+                                     task);
+    }
+
+    return output_files[task - 1].string();
+  };
+
+  const auto add_stream = [&](const unsigned int task)
+    -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+    auto output_file = get_output_file(task);
+
+    if (!output_file)
+      return output_file.takeError();
+
+    std::error_code ec;
+    auto            ostream = std::make_unique<llvm::raw_fd_ostream>(
+      *output_file,
+      ec,
+      llvm::sys::fs::OpenFlags::OF_None);
+
+    if (ec)
+      return llvm::errorCodeToError(ec);
+
+    return std::make_unique<llvm::CachedFileStream>(std::move(ostream));
+  };
+
+  llvm::FileCache cache;
+
+  // Errors while copying cached files, which cannot be returned to LTO
+  std::vector<std::optional<std::string>> cache_errors(results.size() + 1);
+
+  if (thin_lto_cache_dir) {
+    auto local_cache = llvm::localCache(
+      "ThinLTO",
+      "Thin",
+      thin_lto_cache_dir->string(),
+      [&](const unsigned int task, std::unique_ptr<llvm::MemoryBuffer> buffer) {
+        auto stream = add_stream(task);
+
+        if (!stream) {
+          cache_errors.at(task) = llvm::toString(stream.takeError());
+          return;
+        }
+
+        *(*stream)->OS << buffer->getBuffer();
+      });
+
+    if (auto err = local_cache.takeError())
+      throw_error(std::move(err));
+
+    cache = std::move(*local_cache);
+  }
+
+  if (auto err = lto.run(add_stream, cache))
+    throw_error(std::move(err));
+
+  for (const auto& r : cache_errors) {
+    if (r)
+      throw CodegenError{formatError(argv_front, *r)};
+  }
+
+  // Keep the cache directory from growing without limit
+  if (thin_lto_cache_dir)
+    llvm::pruneCache(thin_lto_cache_dir->string(), llvm::CachePruningPolicy{});
+
+  return std::move(output_files);
 }
 
 void CodeGenerator::initTargetTripleAndMachine(
@@ -373,7 +798,7 @@ void CodeGenerator::initTargetTripleAndMachine(
                                     : llvm::sys::getDefaultTargetTriple();
 
   std::string target_triple_error;
-  auto const  target
+  target
     = llvm::TargetRegistry::lookupTarget(target_triple, target_triple_error);
 
   if (!target) {
@@ -383,15 +808,23 @@ void CodeGenerator::initTargetTripleAndMachine(
                                                target_triple_error))};
   }
 
+  target_machine = createTargetMachine();
+}
+
+[[nodiscard]] std::unique_ptr<llvm::TargetMachine>
+CodeGenerator::createTargetMachine() const
+{
+  assert(target);
+
   llvm::TargetOptions target_options;
 
-  target_machine
-    = target->createTargetMachine(target_triple,
-                                  "generic",
-                                  "",
-                                  target_options,
-                                  llvm::Optional<llvm::Reloc::Model>(
-                                    relocation_model)); // Set relocation model.
+  return std::unique_ptr<llvm::TargetMachine>{target->createTargetMachine(
+    target_triple,
+    "generic",
+    "",
+    target_options,
+    llvm::Optional<llvm::Reloc::Model>(
+      relocation_model))}; // Set relocation model.
 }
 
 } // namespace twk::codegen
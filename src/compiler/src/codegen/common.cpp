@@ -16,15 +16,13 @@ void TemplateArgumentsDefiner::insertToAliasTable(
   TemplateArgumentTable template_argument_table;
 
   for (std::size_t idx = 0; const auto& param : params.type_names) {
-    const auto param_name = param.utf8();
-
-    if (template_argument_table.exists(param_name)) {
+    if (template_argument_table.exists(param.name)) {
       throw CodegenError{ctx.formatError(
         pos,
-        fmt::format("redefinition of template parameter '{}'", param_name))};
+        fmt::format("redefinition of template parameter '{}'", param.utf8()))};
     }
 
-    template_argument_table.insert(param_name,
+    template_argument_table.insert(param.name,
                                    createType(ctx, args.types[idx], pos));
     ++idx;
   }
@@ -32,28 +30,15 @@ void TemplateArgumentsDefiner::insertToAliasTable(
   ctx.template_argument_tables.emplace(std::move(template_argument_table));
 }
 
-[[nodiscard]] std::optional<std::pair<ClassTemplateTableValue, NamespaceStack>>
+[[nodiscard]] std::optional<
+  std::pair<const ClassTemplateTableValue&, NamespaceStack>>
 findClassTemplate(CGContext&                    ctx,
                   const std::string_view        name,
                   const ast::TemplateArguments& args)
 {
-  auto namespace_copy = ctx.ns_hierarchy;
-
-  for (;;) {
-    if (const auto value
-        = ctx.class_template_table[TemplateTableKey{name,
-                                                    args.types.size(),
-                                                    namespace_copy}]) {
-      return std::make_pair(*value, std::move(namespace_copy));
-    }
-
-    if (namespace_copy.empty())
-      return std::nullopt;
-
-    namespace_copy.pop();
-  }
-
-  unreachable();
+  return ctx.class_template_table.find(intern(name),
+                                       args.types.size(),
+                                       ctx.ns_hierarchy);
 }
 
 [[nodiscard]] llvm::AllocaInst* createEntryAlloca(llvm::Function*    func,
@@ -214,13 +199,13 @@ createEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::CmpInst::Predicate::FCMP_UEQ,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(llvm::ICmpInst::ICMP_EQ,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -230,13 +215,13 @@ createNotEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::CmpInst::Predicate::FCMP_UNE,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(llvm::ICmpInst::ICMP_NE,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -246,7 +231,7 @@ createLessThan(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_ULT,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(isSigned(logicalOrSign(ctx, lhs, rhs))
@@ -254,7 +239,7 @@ createLessThan(CGContext& ctx, const Value& lhs, const Value& rhs)
                                    : llvm::ICmpInst::ICMP_ULT,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -264,7 +249,7 @@ createGreaterThan(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_UGT,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(isSigned(logicalOrSign(ctx, lhs, rhs))
@@ -272,7 +257,7 @@ createGreaterThan(CGContext& ctx, const Value& lhs, const Value& rhs)
                                    : llvm::ICmpInst::ICMP_UGT,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -282,7 +267,7 @@ createLessOrEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_ULE,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(isSigned(logicalOrSign(ctx, lhs, rhs))
@@ -290,7 +275,7 @@ createLessOrEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
                                    : llvm::ICmpInst::ICMP_ULE,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -300,7 +285,7 @@ createGreaterOrEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_UGE,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(isSigned(logicalOrSign(ctx, lhs, rhs))
@@ -308,21 +293,21 @@ createGreaterOrEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
                                    : llvm::ICmpInst::ICMP_UGE,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
 createLogicalAnd(CGContext& ctx, const Value& lhs, const Value& rhs)
 {
   return {ctx.builder.CreateLogicalAnd(lhs.getValue(), rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
 createLogicalOr(CGContext& ctx, const Value& lhs, const Value& rhs)
 {
   return {ctx.builder.CreateLogicalOr(lhs.getValue(), rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -381,7 +366,7 @@ createDereference(CGContext& ctx, const PositionRange& pos, const Value& val)
                           const std::shared_ptr<Type>& left,
                           const std::shared_ptr<Type>& right)
 {
-  return left->getMangledName(ctx) == right->getMangledName(ctx);
+  return left->getCanonicalType(ctx) == right->getCanonicalType(ctx);
 }
 
 } // namespace twk::codegen
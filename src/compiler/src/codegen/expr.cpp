@@ -10,6 +10,7 @@
 #include <twk/codegen/kind.hpp>
 #include <twk/codegen/stmt.hpp>
 #include <twk/codegen/top_level.hpp>
+#include <llvm/Support/TimeProfiler.h>
 
 namespace twk::codegen
 {
@@ -76,7 +77,7 @@ private:
                                             const std::string& union_name,
                                             const std::string& tag_name)
 {
-  const auto union_type = ctx.union_table[union_name];
+  const auto union_type = ctx.union_table[intern(union_name)];
   assert(union_type);
 
   if (auto variant = union_type->get()->getUnionVariantType(tag_name))
@@ -140,15 +141,15 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const ast::NullPointer&) const
   {
     return {llvm::ConstantPointerNull::get(ctx.builder.getInt8PtrTy()),
-            std::make_shared<PointerType>(
-              std::make_shared<BuiltinType>(BuiltinTypeKind::i8, false),
+            ctx.types.getPointerType(
+              ctx.types.getBuiltinType(BuiltinTypeKind::i8, false),
               false)};
   }
 
   [[nodiscard]] Value operator()(const std::uint8_t node) const
   {
     return createAllocaUnsignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::u8, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::u8, false),
       node);
   }
 
@@ -156,7 +157,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const double node) const
   {
     return createAllocaFP(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::f64, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::f64, false),
       node);
   }
 
@@ -164,7 +165,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const std::uint32_t node) const
   {
     return createAllocaUnsignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::u32, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::u32, false),
       node);
   }
 
@@ -172,7 +173,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const std::int32_t node) const
   {
     return createAllocaSignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::i32, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::i32, false),
       node);
   }
 
@@ -180,7 +181,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const std::uint64_t node) const
   {
     return createAllocaUnsignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::u64, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::u64, false),
       node);
   }
 
@@ -188,7 +189,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const std::int64_t node) const
   {
     return createAllocaSignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::i64, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::i64, false),
       node);
   }
 
@@ -217,9 +218,9 @@ struct ExprVisitor : public boost::static_visitor<Value> {
       initializer_list.push_back(boost::apply_visitor(*this, elem));
 
     const auto type
-      = std::make_shared<ArrayType>(initializer_list.front().getType(),
-                                    initializer_list.size(),
-                                    false);
+      = ctx.types.getArrayType(initializer_list.front().getType(),
+                               initializer_list.size(),
+                               false);
 
     auto const alloca
       = createEntryAlloca(ctx.builder.GetInsertBlock()->getParent(),
@@ -247,11 +248,11 @@ struct ExprVisitor : public boost::static_visitor<Value> {
 
     case BuiltinMacroKind::infinity_:
       return createAllocaInfinityFP(
-        std::make_shared<BuiltinType>(BuiltinTypeKind::f32, false));
+        ctx.types.getBuiltinType(BuiltinTypeKind::f32, false));
 
     case BuiltinMacroKind::huge_val:
       return createAllocaInfinityFP(
-        std::make_shared<BuiltinType>(BuiltinTypeKind::f64, false));
+        ctx.types.getBuiltinType(BuiltinTypeKind::f64, false));
 
     case BuiltinMacroKind::unknown:
       unreachable();
@@ -479,7 +480,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
     // If not inserted (builder.Insert), malloc will be badref
     ctx.builder.Insert(malloc_inst);
 
-    const auto malloc_return_type = std::make_shared<PointerType>(type, false);
+    const auto malloc_return_type = ctx.types.getPointerType(type, false);
 
     if (is_class_ty && node.with_init) {
       auto args = createArgVals(node.initializer, ctx.positionOf(node));
@@ -517,7 +518,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
                                  ctx.builder.GetInsertBlock()));
 
     return {nullptr,
-            std::make_shared<BuiltinType>(BuiltinTypeKind::void_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::void_, false)};
   }
 
   [[nodiscard]] Value operator()(const ast::Dereference& node) const
@@ -529,19 +530,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
 
   [[nodiscard]] Value operator()(const ast::FunctionCall& node) const
   {
-    const auto pos = ctx.positionOf(node);
-
-    if (node.callee.type() != typeid(ast::Identifier)) {
-      throw CodegenError{
-        ctx.formatError(pos,
-                        "left-hand side of function call is not callable")};
-    }
-
-    const auto callee_name = boost::get<ast::Identifier>(node.callee).utf8();
-
-    auto args = createArgVals(node.args, pos);
-
-    return createFunctionCall(callee_name, createArgVals(node.args, pos), pos);
+    return createFunctionCall(node, nullptr);
   }
 
   [[nodiscard]] Value operator()(const ast::FunctionTemplateCall& node) const
@@ -589,6 +578,13 @@ struct ExprVisitor : public boost::static_visitor<Value> {
     const auto as = createType(ctx, node.as, ctx.positionOf(node));
 
     if (as->isPointerTy(ctx)) {
+      if (lhs.getType()->isIntegerTy(ctx)) {
+        // Integer to pointer
+        return {
+          ctx.builder.CreateIntToPtr(lhs.getValue(), as->getLLVMType(ctx)),
+          as};
+      }
+
       // Pointer to pointer
       return {
         ctx.builder.CreatePointerCast(lhs.getValue(), as->getLLVMType(ctx)),
@@ -642,11 +638,10 @@ struct ExprVisitor : public boost::static_visitor<Value> {
         "the right side of the pipeline requires a function call")};
     }
 
-    auto call = boost::get<ast::FunctionCall>(node.rhs);
-
-    call.args.push_front(node.lhs);
-
-    return (*this)(call);
+    // The left-hand side is passed as the first argument without copying the
+    // call
+    return createFunctionCall(boost::get<ast::FunctionCall>(node.rhs),
+                              &node.lhs);
   }
 
   [[nodiscard]] Value operator()(const ast::ClassLiteral& node) const
@@ -734,6 +729,28 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   }
 
 private:
+  // If 'first_arg' is not null, it is passed before the arguments of the call
+  [[nodiscard]] Value
+  createFunctionCall(const ast::FunctionCall& node,
+                     const ast::Expr* const   first_arg) const
+  {
+    const auto pos = ctx.positionOf(node);
+
+    if (node.callee.type() != typeid(ast::Identifier)) {
+      throw CodegenError{
+        ctx.formatError(pos,
+                        "left-hand side of function call is not callable")};
+    }
+
+    const auto& callee_name = boost::get<ast::Identifier>(node.callee).utf8();
+
+    auto args = createArgVals(first_arg, node.args, pos);
+
+    return createFunctionCall(callee_name,
+                              createArgVals(first_arg, node.args, pos),
+                              pos);
+  }
+
   [[nodiscard]] std::vector<std::string>
   stringifyExprs(const std::deque<ast::Expr>& exprs,
                  const std::function<void()>& on_error) const
@@ -795,7 +812,7 @@ private:
                      const ast::Expr&     initializer,
                      const PositionRange& pos) const
   {
-    if (const auto union_type = ctx.union_table[union_name]) {
+    if (const auto union_type = ctx.union_table[intern(union_name)]) {
       auto const alloca
         = createEntryAlloca(ctx.builder.GetInsertBlock()->getParent(),
                             "",
@@ -839,9 +856,8 @@ private:
                           "",
                           class_type->getLLVMType(ctx));
 
-    const auto this_pointer_type = std::make_shared<PointerType>(
-      std::make_shared<UserDefinedType>(real_class_name, false),
-      false);
+    const auto this_pointer_type
+      = ctx.types.getPointerType(class_type->withMutable(ctx, false), false);
 
     auto args = createArgVals(initializer_list, pos);
 
@@ -871,51 +887,24 @@ private:
     return createClassLiteral(class_type, initializer_list, pos);
   }
 
+  // The template is referred to in the table without copying it
   [[nodiscard]] std::optional<
-    std::pair<FunctionTemplateTableValue, NamespaceStack>>
+    std::pair<const FunctionTemplateTableValue&, NamespaceStack>>
   findFunctionTemplate(const std::string_view        name,
                        const ast::TemplateArguments& args) const
   {
-    auto namespace_copy = ctx.ns_hierarchy;
-
-    for (;;) {
-      if (const auto value
-          = ctx.func_template_table[TemplateTableKey{name,
-                                                     args.types.size(),
-                                                     namespace_copy}]) {
-        return std::make_pair(*value, std::move(namespace_copy));
-      }
-
-      if (namespace_copy.empty())
-        return std::nullopt;
-
-      namespace_copy.pop();
-    }
-
-    unreachable();
+    return ctx.func_template_table.find(intern(name),
+                                        args.types.size(),
+                                        ctx.ns_hierarchy);
   }
 
-  [[nodiscard]] std::optional<std::pair<ast::UnionDef, NamespaceStack>>
+  [[nodiscard]] std::optional<std::pair<const ast::UnionDef&, NamespaceStack>>
   findUnionTemplate(const std::string_view        name,
                     const ast::TemplateArguments& args) const
   {
-    auto namespace_copy = ctx.ns_hierarchy;
-
-    for (;;) {
-      if (const auto value
-          = ctx.union_template_table[TemplateTableKey{name,
-                                                      args.types.size(),
-                                                      namespace_copy}]) {
-        return std::make_pair(*value, std::move(namespace_copy));
-      }
-
-      if (namespace_copy.empty())
-        return std::nullopt;
-
-      namespace_copy.pop();
-    }
-
-    unreachable();
+    return ctx.union_template_table.find(intern(name),
+                                         args.types.size(),
+                                         ctx.ns_hierarchy);
   }
 
   [[nodiscard]] llvm::Function*
@@ -965,6 +954,8 @@ private:
 
     assert(func);
 
+    const llvm::TimeTraceScope scope{"InstantiateFunction", func->getName()};
+
     if (!ast.is_public)
       func->setLinkage(llvm::Function::LinkageTypes::InternalLinkage);
 
@@ -980,8 +971,6 @@ private:
                          createType(ctx, ast.decl.return_type, pos),
                          ast.body);
 
-      ctx.fpm.run(*func);
-
       // Return insert point to previous location
       ctx.builder.SetInsertPoint(return_bb);
     }
@@ -1056,7 +1045,7 @@ private:
   [[nodiscard]] Value createAllocaBool(const bool value) const
   {
     const auto type
-      = std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false);
+      = ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false);
     auto const llvm_type = type->getLLVMType(ctx);
 
     auto const alloca
@@ -1072,8 +1061,8 @@ private:
 
   [[nodiscard]] Value createAllocaString(const std::string_view str) const
   {
-    const auto type = std::make_shared<PointerType>(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::i8, false),
+    const auto type = ctx.types.getPointerType(
+      ctx.types.getBuiltinType(BuiltinTypeKind::i8, false),
       false);
     auto const llvm_type = type->getLLVMType(ctx);
 
@@ -1091,7 +1080,7 @@ private:
   [[nodiscard]] Value createAllocaChar(const unicode::Codepoint ch) const
   {
     const auto type
-      = std::make_shared<BuiltinType>(BuiltinTypeKind::char_, false);
+      = ctx.types.getBuiltinType(BuiltinTypeKind::char_, false);
     auto const llvm_type = type->getLLVMType(ctx);
 
     auto const alloca
@@ -1121,10 +1110,9 @@ private:
     return {ctx.builder.CreateLoad(alloca->getAllocatedType(), alloca), type};
   }
 
-  void
-  createConstructorCall(const boost::iterator_range<twk::InputIterator>& pos,
-                        const std::string&       class_name,
-                        const std::deque<Value>& args) const
+  void createConstructorCall(const PositionRange&     pos,
+                             const std::string&       class_name,
+                             const std::deque<Value>& args) const
   {
     ctx.ns_hierarchy.push({class_name, NamespaceKind::class_});
 
@@ -1145,12 +1133,12 @@ private:
   }
 
   [[nodiscard]] Value
-  createFunctionCall(const std::string&  callee_name,
-                     std::deque<Value>&& args,
-                     const boost::iterator_range<twk::InputIterator>& pos) const
+  createFunctionCall(const std::string&   callee_name,
+                     std::deque<Value>&&  args,
+                     const PositionRange& pos) const
   {
     if (auto const func = findCalleeMethod(callee_name, args)) {
-      args.push_front((*this)(ast::Identifier{std::u32string{U"this"}}));
+      args.push_front((*this)(ast::Identifier{"this"}));
       return createFunctionCall(func, args, pos);
     }
 
@@ -1165,7 +1153,7 @@ private:
   [[nodiscard]] Value
   createFunctionCall(llvm::Function* const    callee_func,
                      const std::deque<Value>& args,
-                     const boost::iterator_range<twk::InputIterator>& pos) const
+                     const PositionRange&     pos) const
   {
     if (!callee_func->isVarArg() && callee_func->arg_size() != args.size())
       throw CodegenError{ctx.formatError(pos, "incorrect arguments passed")};
@@ -1197,9 +1185,7 @@ private:
   [[nodiscard]] std::shared_ptr<Variable>
   findVariable(const ast::Identifier& node) const
   {
-    const auto ident = node.utf8();
-
-    if (const auto variable = scope[ident])
+    if (const auto variable = scope[node.name])
       return *variable;
 
     return nullptr;
@@ -1210,9 +1196,8 @@ private:
   [[nodiscard]] std::optional<Value>
   findMemberOfThis(const ast::Identifier& node) const
   {
-    if (scope["this"]) {
-      const auto this_p
-        = findVariable(ast::Identifier{std::u32string{U"this"}});
+    if (scope[intern("this")]) {
+      const auto this_p = findVariable(ast::Identifier{"this"});
 
       if (!this_p)
         return std::nullopt;
@@ -1364,7 +1349,7 @@ private:
   [[nodiscard]] Value createPointerToArray(const Value& array) const
   {
     return {llvm::getPointerOperand(array.getValue()),
-            std::make_shared<PointerType>(array.getType(), array.isMutable())};
+            ctx.types.getPointerType(array.getType(), array.isMutable())};
   }
 
   [[nodiscard]] Value createArraySubscript(const Value& array,
@@ -1428,20 +1413,20 @@ private:
         ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_OEQ,
                                value.getValue(),
                                llvm::ConstantFP::get(value.getLLVMType(), 0)),
-        std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+        ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
     }
 
     return {
       ctx.builder.CreateICmp(llvm::ICmpInst::ICMP_EQ,
                              value.getValue(),
                              llvm::ConstantInt::get(value.getLLVMType(), 0)),
-      std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+      ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   [[nodiscard]] Value createSizeOf(llvm::Type* const type) const
   {
     const auto usize_type
-      = std::make_shared<BuiltinType>(BuiltinTypeKind::usize, false);
+      = ctx.types.getBuiltinType(BuiltinTypeKind::usize, false);
 
     return {llvm::ConstantInt::get(
               usize_type->getLLVMType(ctx),
@@ -1458,7 +1443,7 @@ private:
                                       const PositionRange& pos) const
   {
     return {createAddressOf(val, pos).getValue(),
-            std::make_shared<ReferenceType>(val.getType(), false)};
+            ctx.types.getReferenceType(val.getType(), false)};
   }
 
   // Do not use for constants!
@@ -1470,7 +1455,7 @@ private:
     if (!ptr)
       throw CodegenError{ctx.formatError(pos, "operand has no address")};
 
-    return {ptr, std::make_shared<PointerType>(val.getType(), false)};
+    return {ptr, ctx.types.getPointerType(val.getType(), false)};
   }
 
   void verifyArguments(const std::deque<Value>& args,
@@ -1505,9 +1490,20 @@ private:
   [[nodiscard]] std::deque<Value>
   createArgVals(const std::deque<ast::Expr>& exprs,
                 const PositionRange&         pos) const
+  {
+    return createArgVals(nullptr, exprs, pos);
+  }
+
+  [[nodiscard]] std::deque<Value>
+  createArgVals(const ast::Expr* const       first,
+                const std::deque<ast::Expr>& exprs,
+                const PositionRange&         pos) const
   {
     std::deque<Value> args;
 
+    if (first)
+      args.push_back(boost::apply_visitor(*this, *first));
+
     for (const auto& r : exprs)
       args.push_back(boost::apply_visitor(*this, r));
 
@@ -1518,15 +1514,13 @@ private:
   findVarArgFunction(const std::vector<std::string>& mangled_names) const
   {
     const auto f = [&](const std::string_view mangled) -> llvm::Function* {
-      for (auto& func : ctx.module->getFunctionList()) {
-        const auto func_name = func.getName();
-
-        if (func_name.endswith(mangle::ellipsis)) {
-          // _Z1fv to _Z1f
-          const auto tmp = func_name.substr(0, func_name.size() - 2);
-          if (mangled.starts_with(tmp))
-            return &func;
-        }
+      for (auto const func : ctx.vararg_functions) {
+        const auto func_name = func->getName();
+
+        // _Z1fv to _Z1f
+        const auto tmp = func_name.substr(0, func_name.size() - 2);
+        if (mangled.starts_with(tmp))
+          return func;
       }
 
       return nullptr;
@@ -1623,7 +1617,7 @@ private:
     }
 
     const auto class_type
-      = ctx.class_table[class_val.getLLVMType()->getStructName().str()];
+      = ctx.class_table[intern(class_val.getLLVMType()->getStructName())];
 
     if (!class_type || class_type->get()->isOpaque(ctx)) {
       throw CodegenError{
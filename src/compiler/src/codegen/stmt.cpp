@@ -25,6 +25,14 @@ namespace twk::codegen
   return merged_table;
 }
 
+struct StmtVisitor;
+
+static void
+createScope(CGContext&                                     ctx,
+            const SymbolTable&                             scope_arg,
+            const StmtContext&                             stmt_ctx_arg,
+            const std::function<void(const StmtVisitor&)>& generate);
+
 //===----------------------------------------------------------------------===//
 // Statement visitor
 //===----------------------------------------------------------------------===//
@@ -86,7 +94,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
                         "type inference requires an initializer")};
     }
 
-    const auto name = node.name.utf8();
+    const auto& name = node.name.utf8();
 
     auto const func = ctx.builder.GetInsertBlock()->getParent();
 
@@ -96,7 +104,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
     if (node.type) {
       const auto type = createType(ctx, *node.type, ctx.positionOf(node));
 
-      scope.insertOrAssign(name,
+      scope.insertOrAssign(node.name.name,
                            std::make_shared<AllocaVariable>(
                              createAllocaVariable(ctx.positionOf(node),
                                                   func,
@@ -107,7 +115,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
     }
     else {
       scope.insertOrAssign(
-        name,
+        node.name.name,
         std::make_shared<AllocaVariable>(
           createAllocaVariableTyInference(ctx.positionOf(node),
                                           func,
@@ -138,7 +146,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
 
     const auto one
       = Value{llvm::ConstantInt::get(ctx.builder.getInt32Ty(), 1),
-              std::make_shared<BuiltinType>(BuiltinTypeKind::i32, false)};
+              ctx.types.getBuiltinType(BuiltinTypeKind::i32, false)};
 
     switch (node.kind()) {
     case ast::PrefixIncrementDecrement::Kind::unknown:
@@ -254,7 +262,8 @@ struct StmtVisitor : public boost::static_visitor<void> {
       llvm::ICmpInst::ICMP_NE,
       createExpr(ctx, getAllSymbols(), stmt_ctx, node.cond_expr).getValue(),
       llvm::ConstantInt::get(
-        BuiltinType{BuiltinTypeKind::bool_, false}.getLLVMType(ctx),
+        ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)
+          ->getLLVMType(ctx),
         0));
 
     ctx.builder.CreateCondBr(cond, body_bb, loop_end_bb);
@@ -307,7 +316,8 @@ struct StmtVisitor : public boost::static_visitor<void> {
         createExpr(ctx, getAllSymbols(), new_stmt_ctx, *node.cond_expr)
           .getValue(),
         llvm::ConstantInt::get(
-          BuiltinType{BuiltinTypeKind::bool_, false}.getLLVMType(ctx),
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)
+          ->getLLVMType(ctx),
           0));
 
       ctx.builder.CreateCondBr(cond, body_bb, loop_end_bb);
@@ -376,7 +386,17 @@ struct StmtVisitor : public boost::static_visitor<void> {
 private:
   using TagNameReadingValue = ast::FunctionCall;
 
+  // A case of a match targeting a union, which refers to the statement of the
+  // case instead of copying it
+  struct UnionCase {
+    ast::Expr                condition;
+    std::optional<ast::Stmt> binding; // Definition of the bound variable
+    const ast::Stmt*         statement;
+    const ast::MatchCase*    node;
+  };
+
   // Create a match statement targeting union
+  // It is generated as an if-else chain of the cases
   void createUnionMatch(const Value&                       target,
                         const std::vector<ast::MatchCase>& cases,
                         const PositionRange&               pos) const
@@ -387,14 +407,13 @@ private:
     const auto tag_offset
       = std::make_shared<Value>(getUnionTagOffsetFromValue(target));
 
-    ast::Stmt                cases_ast;
-    ast::Stmt*               before = nullptr;
-    std::optional<ast::Stmt> wildcard_statement;
+    std::vector<UnionCase> union_cases;
+    const ast::Stmt*       wildcard_statement = nullptr;
 
     for (const auto& cs /* case */ : cases) {
       // Wildcard
       if (isWildcard(cs.match_case)) {
-        wildcard_statement = cs.statement;
+        wildcard_statement = &cs.statement;
         continue;
       }
 
@@ -410,7 +429,7 @@ private:
             fmt::format("undeclared union tag name {}", offset.second))};
         }
 
-        ast::CompoundStatement case_statement;
+        std::optional<ast::Stmt> binding;
 
         if (const auto node
             = boost::get<TagNameReadingValue>(&union_tag->rhs)) {
@@ -419,33 +438,20 @@ private:
           const auto value
             = std::make_shared<Value>(readUnionValue(target, *offset.first));
 
-          {
-            auto tmp
-              = ast::VariableDef{VariableQual::no_qualifier,
-                                 boost::get<ast::Identifier>(node->args.at(0)),
-                                 std::nullopt,
-                                 ast::Value{value}};
-            assignPosition(tmp, cs);
-            case_statement.push_back(std::move(tmp));
-          }
+          auto tmp
+            = ast::VariableDef{VariableQual::no_qualifier,
+                               boost::get<ast::Identifier>(node->args.at(0)),
+                               std::nullopt,
+                               ast::Value{value}};
+          assignPosition(tmp, cs);
+          binding = std::move(tmp);
         }
 
         ast::BinOp eq{ast::Value{tag_offset}, U"==", *offset.first};
         assignPosition(eq, cs);
-        case_statement.push_back(cs.statement);
-        ast::If ast{std::move(eq), case_statement, std::nullopt};
-        assignPosition(ast, cs);
-
-        if (before) {
-          auto const tmp      = boost::get<ast::If>(before);
-          tmp->else_statement = std::move(ast);
-          before              = &*tmp->else_statement;
-        }
-        else {
-          // First time
-          cases_ast = std::move(ast);
-          before    = &cases_ast;
-        }
+
+        union_cases.push_back(
+          {std::move(eq), std::move(binding), &cs.statement, &cs});
 
         continue;
       }
@@ -458,20 +464,83 @@ private:
       unreachable();
     }
 
-    // Insert wildcard
-    if (wildcard_statement) {
-      auto const tmp      = boost::get<ast::If>(before);
-      tmp->else_statement = std::move(*wildcard_statement);
-    }
+    assert(!union_cases.empty());
 
     // Generate cases
-    (*this)(boost::get<ast::If>(cases_ast));
+    createUnionCases(union_cases, 0, wildcard_statement);
+  }
+
+  // Generate the case at 'idx' and the following cases as its else statement,
+  // in the same way as an if statement
+  void createUnionCases(const std::vector<UnionCase>& cases,
+                        const std::size_t             idx,
+                        const ast::Stmt* const        wildcard_statement) const
+  {
+    const auto& cs = cases[idx];
+
+    auto const func = ctx.builder.GetInsertBlock()->getParent();
+
+    auto const then_bb = llvm::BasicBlock::Create(ctx.context, "if_then", func);
+    auto const else_bb = llvm::BasicBlock::Create(ctx.context, "if_else");
+
+    auto const merge_bb = llvm::BasicBlock::Create(ctx.context, "if_merge");
+
+    auto const cond_value
+      = createExpr(ctx, getAllSymbols(), stmt_ctx, cs.condition);
+
+    auto const cond = ctx.builder.CreateICmp(
+      llvm::ICmpInst::ICMP_NE,
+      cond_value.getValue(),
+      llvm::Constant::getNullValue(cond_value.getLLVMType()));
+
+    ctx.builder.CreateCondBr(cond, then_bb, else_bb);
+
+    // Then statement codegen
+    ctx.builder.SetInsertPoint(then_bb);
+
+    {
+      std::vector<std::reference_wrapper<const ast::Stmt>> then_statements;
+
+      if (cs.binding)
+        then_statements.emplace_back(*cs.binding);
+
+      then_statements.emplace_back(*cs.statement);
+
+      createStatement(ctx, getAllSymbols(), stmt_ctx, then_statements);
+    }
+
+    if (!ctx.builder.GetInsertBlock()->getTerminator())
+      ctx.builder.CreateBr(merge_bb);
+
+    // Else statement codegen
+    func->getBasicBlockList().push_back(else_bb);
+    ctx.builder.SetInsertPoint(else_bb);
+
+    if (idx + 1 < cases.size()) {
+      createScope(ctx,
+                  getAllSymbols(),
+                  stmt_ctx,
+                  [&](const StmtVisitor& visitor) {
+                    visitor.createUnionCases(cases,
+                                             idx + 1,
+                                             wildcard_statement);
+                  });
+    }
+    else if (wildcard_statement)
+      createStatement(ctx, getAllSymbols(), stmt_ctx, *wildcard_statement);
+
+    if (!ctx.builder.GetInsertBlock()->getTerminator())
+      ctx.builder.CreateBr(merge_bb);
+
+    func->getBasicBlockList().push_back(merge_bb);
+
+    ctx.builder.SetInsertPoint(merge_bb);
   }
 
   [[nodiscard]] bool isWildcard(const ast::Expr& node) const
   {
     if (auto const ident = boost::get<ast::Identifier>(&node)) {
-      if (ident->utf32() == U"_")
+      if (ident->utf8() == "_")
         return true;
     }
 
@@ -551,7 +620,7 @@ private:
 
     return {
       ctx.builder.CreateLoad(value->getType()->getPointerElementType(), value),
-      std::make_shared<BuiltinType>(BuiltinTypeKind::u8, false)};
+      ctx.types.getBuiltinType(BuiltinTypeKind::u8, false)};
   }
 
   [[nodiscard]] SymbolTable getAllSymbols() const
@@ -628,7 +697,7 @@ private:
     }
 
     return {llvm::getPointerOperand(value.getValue()),
-            std::make_shared<PointerType>(value.getType(), value.isMutable())};
+            ctx.types.getPointerType(value.getType(), value.isMutable())};
   }
 
   void verifyVariableType(const PositionRange&         pos,
@@ -655,7 +724,7 @@ private:
     if (!initializer) {
       return {
         ctx,
-        {alloca, type->clone()},
+        {alloca, type},
         is_mutable
       };
     }
@@ -670,7 +739,7 @@ private:
 
     return {
       ctx,
-      {alloca, type->clone()},
+      {alloca, type},
       is_mutable
     };
   }
@@ -693,7 +762,7 @@ private:
 
     return {
       ctx,
-      {alloca, init_value.getType()->clone()},
+      {alloca, init_value.getType()},
       is_mutable
     };
   }
@@ -764,34 +833,19 @@ static void createDestructBB(CGContext&         ctx,
     ctx.builder.CreateBr(stmt_ctx.end_bb);
 }
 
-void createStatement(CGContext&         ctx,
-                     const SymbolTable& scope_arg,
-                     const StmtContext& stmt_ctx_arg,
-                     const ast::Stmt&   statement)
+// Generate statements in a new scope
+static void
+createScope(CGContext&                                     ctx,
+            const SymbolTable&                             scope_arg,
+            const StmtContext&                             stmt_ctx_arg,
+            const std::function<void(const StmtVisitor&)>& generate)
 {
   SymbolTable new_scope;
 
   auto new_stmt_ctx        = stmt_ctx_arg;
   new_stmt_ctx.destruct_bb = llvm::BasicBlock::Create(ctx.context, "destruct");
 
-  if (statement.type() == typeid(ast::CompoundStatement)) {
-    auto& statements = boost::get<ast::CompoundStatement>(statement);
-
-    for (const auto& r : statements) {
-      boost::apply_visitor(StmtVisitor{ctx, scope_arg, new_scope, new_stmt_ctx},
-                           r);
-
-      if (ctx.builder.GetInsertBlock()->getTerminator()) {
-        // Terminators cannot be placed in the middle of a basic block
-        // Therefore, break
-        break;
-      }
-    }
-  }
-  else {
-    boost::apply_visitor(StmtVisitor{ctx, scope_arg, new_scope, new_stmt_ctx},
-                         statement);
-  }
+  generate(StmtVisitor{ctx, scope_arg, new_scope, new_stmt_ctx});
 
   // The presence of a terminator means that there was a return statement
   if (ctx.builder.GetInsertBlock()->getTerminator())
@@ -802,4 +856,44 @@ void createStatement(CGContext&         ctx,
   }
 }
 
+template <typename Statements>
+static void visitStatements(CGContext&         ctx,
+                            const StmtVisitor& visitor,
+                            const Statements&  statements)
+{
+  for (const ast::Stmt& r : statements) {
+    boost::apply_visitor(visitor, r);
+
+    if (ctx.builder.GetInsertBlock()->getTerminator()) {
+      // Terminators cannot be placed in the middle of a basic block
+      // Therefore, break
+      break;
+    }
+  }
+}
+
+void createStatement(CGContext&         ctx,
+                     const SymbolTable& scope_arg,
+                     const StmtContext& stmt_ctx_arg,
+                     const ast::Stmt&   statement)
+{
+  createScope(ctx, scope_arg, stmt_ctx_arg, [&](const StmtVisitor& visitor) {
+    if (const auto statements = boost::get<ast::CompoundStatement>(&statement))
+      visitStatements(ctx, visitor, *statements);
+    else
+      boost::apply_visitor(visitor, statement);
+  });
+}
+
+void createStatement(
+  CGContext&                                                  ctx,
+  const SymbolTable&                                          scope_arg,
+  const StmtContext&                                          stmt_ctx_arg,
+  const std::vector<std::reference_wrapper<const ast::Stmt>>& statements)
+{
+  createScope(ctx, scope_arg, stmt_ctx_arg, [&](const StmtVisitor& visitor) {
+    visitStatements(ctx, visitor, statements);
+  });
+}
+
 } // namespace twk::codegen
@@ -9,6 +9,8 @@
 #include <twk/codegen/expr.hpp>
 #include <twk/codegen/stmt.hpp>
 #include <twk/codegen/exception.hpp>
+#include <twk/interface/interface.hpp>
+#include <llvm/Support/TimeProfiler.h>
 
 namespace twk::codegen
 {
@@ -119,7 +121,7 @@ createArgumentTable(CGContext&                ctx,
 
     // Add arguments to variable symbol table
     argument_table.insertOrAssign(
-      arg.getName().str(),
+      intern(arg.getName()),
       std::make_shared<AllocaVariable>(
         ctx,
         Value{alloca, param_type},
@@ -134,7 +136,8 @@ void createFunctionBody(CGContext&                  ctx,
                         const std::string_view      name,
                         const ast::ParameterList&   params,
                         const std::shared_ptr<Type> return_type,
-                        const ast::Stmt&            body)
+                        const ast::Stmt&            body,
+                        const ast::Stmt* const      prologue)
 {
   auto const entry_bb = llvm::BasicBlock::Create(ctx.context, "", func);
   ctx.builder.SetInsertPoint(entry_bb);
@@ -150,10 +153,16 @@ void createFunctionBody(CGContext&                  ctx,
         ? nullptr
         : createEntryAlloca(func, "", return_type->getLLVMType(ctx));
 
-  createStatement(ctx,
-                  argument_table,
-                  {nullptr, return_variable, end_bb, nullptr, nullptr},
-                  body);
+  const StmtContext stmt_ctx{nullptr,
+                             return_variable,
+                             end_bb,
+                             nullptr,
+                             nullptr};
+
+  if (prologue)
+    createStatement(ctx, argument_table, stmt_ctx, {*prologue, body});
+  else
+    createStatement(ctx, argument_table, stmt_ctx, body);
 
   // If there is no return, returns undef
   if (!ctx.builder.GetInsertBlock()->getTerminator()
@@ -233,6 +242,9 @@ declareFunction(CGContext&                   ctx,
   ctx.return_type_table.insert(func, return_type);
   ctx.param_types_table.insert(func, std::move(param_types));
 
+  if (func->getName().endswith(mangle::ellipsis))
+    ctx.vararg_functions.push_back(func);
+
   // Set names to all arguments
   for (std::size_t idx = 0; auto&& arg : func->args())
     arg.setName(node.params->at(idx++).name.utf8());
@@ -282,30 +294,6 @@ void verifyDestructor(CGContext&             ctx,
   }
 }
 
-void defineMethods(CGContext&          ctx,
-                   const ClassMethods& methods,
-                   const std::string&  class_name)
-{
-  ctx.ns_hierarchy.push({class_name, NamespaceKind::class_});
-
-  for (const auto& r : methods)
-    createTopLevel(ctx, ast::TopLevel{r});
-
-  ctx.ns_hierarchy.pop();
-}
-
-void declareMethods(CGContext&          ctx,
-                    const ClassMethods& methods,
-                    const std::string&  class_name)
-{
-  ctx.ns_hierarchy.push({class_name, NamespaceKind::class_});
-
-  for (const auto& r : methods)
-    createTopLevel(ctx, ast::TopLevel{r.decl});
-
-  ctx.ns_hierarchy.pop();
-}
-
 // Depending on the argument, it can be either declaration only, definition
 // only, or declaration and definition
 void createMethod(CGContext&             ctx,
@@ -336,19 +324,46 @@ void pushThisPointer(const ast::Identifier& class_name, ast::FunctionDecl& decl)
   auto type = ast::PointerType{ast::UserDefinedType{class_name}};
   assignPosition(type, decl);
 
-  auto ident = ast::Identifier{std::u32string{U"this"}};
+  auto ident = ast::Identifier{"this"};
   assignPosition(ident, decl);
 
   decl.params->push_front(
     {std::move(ident), {VariableQual::mutable_}, std::move(type), false});
 }
 
-[[nodiscard]] ast::FunctionDef
-createConstructorAST(CGContext&              ctx,
-                     const Accessibility&    accessibility,
-                     const bool              is_public,
-                     const ast::Identifier&  class_name,
-                     const ast::Constructor& constructor)
+[[nodiscard]] Method createMethodFromDecl(const bool               is_public,
+                                          const ast::Identifier&   class_name,
+                                          const ast::FunctionDecl& decl,
+                                          const ast::Stmt&         body)
+{
+  Method method{is_public, decl, &body, std::nullopt};
+
+  pushThisPointer(class_name, method.decl);
+
+  return method;
+}
+
+[[nodiscard]] ast::CompoundStatement
+createMemberInitStmt(const ast::MemberInitializerList& initializer_list)
+{
+  ast::CompoundStatement member_init_stmt;
+
+  for (const auto& initializer : initializer_list.initializers) {
+    ast::ClassMemberInit init{initializer.member_name,
+                              U"=",
+                              initializer.initializer};
+    assignPosition(init, initializer);
+    member_init_stmt.push_back(std::move(init));
+  }
+
+  return member_init_stmt;
+}
+
+[[nodiscard]] Method createConstructor(CGContext&              ctx,
+                                       const Accessibility&    accessibility,
+                                       const bool              is_public,
+                                       const ast::Identifier&  class_name,
+                                       const ast::Constructor& constructor)
 {
   if (accessibility != Accessibility::public_) {
     throw CodegenError{ctx.formatError(ctx.positionOf(constructor),
@@ -357,23 +372,24 @@ createConstructorAST(CGContext&              ctx,
 
   verifyConstructor(ctx, class_name.utf8(), constructor);
 
-  auto clone = constructor;
+  auto method = createMethodFromDecl(is_public,
+                                     class_name,
+                                     constructor.decl,
+                                     constructor.body);
 
-  clone.decl.is_constructor = true;
+  method.decl.is_constructor = true;
 
-  pushThisPointer(class_name, clone.decl);
+  // Initialization of member variables before the body
+  method.prologue = createMemberInitStmt(constructor.member_initializers);
 
-  return ast::FunctionDef{is_public,
-                          std::move(clone.decl),
-                          std::move(clone.body)};
+  return method;
 }
 
-[[nodiscard]] ast::FunctionDef
-createDestructorAST(CGContext&             ctx,
-                    const Accessibility&   accessibility,
-                    const bool             is_public,
-                    const ast::Identifier& class_name,
-                    const ast::Destructor& destructor)
+[[nodiscard]] Method createDestructor(CGContext&             ctx,
+                                      const Accessibility&   accessibility,
+                                      const bool             is_public,
+                                      const ast::Identifier& class_name,
+                                      const ast::Destructor& destructor)
 {
   if (accessibility != Accessibility::public_) {
     throw CodegenError{
@@ -382,43 +398,16 @@ createDestructorAST(CGContext&             ctx,
 
   verifyDestructor(ctx, class_name.utf8(), destructor);
 
-  auto clone = destructor;
-
-  clone.decl.is_destructor = true;
+  auto method = createMethodFromDecl(is_public,
+                                     class_name,
+                                     destructor.decl,
+                                     destructor.body);
 
-  pushThisPointer(class_name, clone.decl);
+  method.decl.is_destructor = true;
 
-  return ast::FunctionDef{is_public,
-                          std::move(clone.decl),
-                          std::move(clone.body)};
+  return method;
 }
 
-[[nodiscard]] ast::CompoundStatement
-createMemberInitStmt(const ast::MemberInitializerList& initializer_list)
-{
-  ast::CompoundStatement member_init_stmt;
-
-  for (const auto& initializer : initializer_list.initializers) {
-    ast::ClassMemberInit init{initializer.member_name,
-                              U"=",
-                              initializer.initializer};
-    assignPosition(init, initializer);
-    member_init_stmt.push_back(std::move(init));
-  }
-
-  return member_init_stmt;
-}
-
-[[nodiscard]] ast::FunctionDef
-injectMemberInitStmt(ast::FunctionDef&&                func,
-                     const ast::MemberInitializerList& initializer_list)
-{
-  // New body statement containing initialization of member variables
-  ast::CompoundStatement new_body{func.body};
-  new_body.push_front(createMemberInitStmt(initializer_list));
-  func.body = std::move(new_body);
-  return func;
-}
 
 // Setting template parameters is the caller's responsibility
 void createClass(CGContext&                        ctx,
@@ -446,10 +435,6 @@ void createClass(CGContext&                        ctx,
   std::vector<ClassType::MemberVariable> member_variables;
   ClassMethods                           method_def_asts;
 
-  const auto push_this_ptr = [&](ast::FunctionDecl& decl) {
-    pushThisPointer(class_name_ast, decl);
-  };
-
   for (const auto& member : node.members) {
     if (const auto variable
         = boost::get<ast::VariableDefWithoutInit>(&member)) {
@@ -458,21 +443,20 @@ void createClass(CGContext&                        ctx,
           && (*variable->qualifier == VariableQual::mutable_);
 
       const auto type
-        = createType(ctx, variable->type, ctx.positionOf(*variable));
-
-      type->setMutable(ctx, is_mutable);
+        = createType(ctx, variable->type, ctx.positionOf(*variable))
+            ->withMutable(ctx, is_mutable);
 
       member_variables.push_back({variable->name.utf8(), type, accessibility});
     }
     else if (const auto function = boost::get<ast::FunctionDef>(&member)) {
-      auto function_clone = *function;
+      auto method = createMethodFromDecl(node.is_public,
+                                         class_name_ast,
+                                         function->decl,
+                                         function->body);
 
-      push_this_ptr(function_clone.decl);
+      method.decl.accessibility = accessibility;
 
-      function_clone.decl.accessibility = accessibility;
-      function_clone.is_public          = node.is_public;
-
-      method_def_asts.push_back(std::move(function_clone));
+      method_def_asts.push_back(std::move(method));
     }
     else if (const auto access_specifier = boost::get<Accessibility>(&member)) {
       switch (*access_specifier) {
@@ -488,20 +472,18 @@ void createClass(CGContext&                        ctx,
       }
     }
     else if (const auto constructor = boost::get<ast::Constructor>(&member)) {
-      method_def_asts.push_back(
-        injectMemberInitStmt(createConstructorAST(ctx,
+      method_def_asts.push_back(createConstructor(ctx,
                                                   accessibility,
                                                   node.is_public,
                                                   class_name_ast,
-                                                  *constructor),
-                             constructor->member_initializers));
+                                                  *constructor));
     }
     else if (const auto destructor = boost::get<ast::Destructor>(&member)) {
-      method_def_asts.push_back(createDestructorAST(ctx,
-                                                    accessibility,
-                                                    node.is_public,
-                                                    class_name_ast,
-                                                    *destructor));
+      method_def_asts.push_back(createDestructor(ctx,
+                                                 accessibility,
+                                                 node.is_public,
+                                                 class_name_ast,
+                                                 *destructor));
     }
     else if (const auto class_ = boost::get<ast::ClassDef>(&member)) {
       if (class_->isTemplate()) {
@@ -515,7 +497,7 @@ void createClass(CGContext&                        ctx,
       unreachable();
   }
 
-  if (const auto opaque_class_ty = ctx.class_table[class_name]) {
+  if (const auto opaque_class_ty = ctx.class_table[class_name_ast.name]) {
     const auto type = opaque_class_ty->get();
 
     if (type->isOpaque(ctx)) {
@@ -534,11 +516,8 @@ void createClass(CGContext&                        ctx,
   }
   else {
     ctx.class_table.insert(
-      class_name,
-      std::make_shared<ClassType>(ctx,
-                                  std::move(member_variables),
-                                  class_name,
-                                  false));
+      class_name_ast.name,
+      ClassType::create(ctx, std::move(member_variables), class_name));
   }
 
   createMethod(ctx, method_def_asts, class_name, method_conv);
@@ -548,11 +527,11 @@ void createUnion(CGContext& ctx, const ast::UnionDef& node)
 {
   assert(!node.isTemplate());
 
-  const auto union_name = node.name.utf8();
+  const auto& union_name = node.name.utf8();
 
   const auto pos = ctx.positionOf(node);
 
-  if (ctx.union_table.exists(union_name)) {
+  if (ctx.union_table.exists(node.name.name)) {
     throw CodegenError{
       ctx.formatError(pos, fmt::format("redefinition of '{}'", union_name))};
   }
@@ -565,8 +544,8 @@ void createUnion(CGContext& ctx, const ast::UnionDef& node)
   }
 
   ctx.union_table.insert(
-    union_name,
-    std::make_shared<UnionType>(ctx, union_name, std::move(tags), false));
+    node.name.name,
+    UnionType::create(ctx, union_name, std::move(tags)));
 }
 
 //===----------------------------------------------------------------------===//
@@ -599,9 +578,9 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
     if (node.decl.isTemplate()) {
       verifyTemplateParameter(node.decl.template_params);
 
-      const auto name = node.decl.name.utf8();
+      const auto& name = node.decl.name.utf8();
 
-      const auto key = TemplateTableKey{name,
+      const auto key = TemplateTableKey{node.decl.name.name,
                                         node.decl.template_params->size(),
                                         ctx.ns_hierarchy};
 
@@ -616,55 +595,46 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
       return nullptr;
     }
 
-    const auto name = node.decl.name.utf8();
+    return defineFunction(node.is_public, node.decl, node.body, nullptr);
+  }
 
-    auto func = ctx.module->getFunction(mangleFunction(node.decl));
+  llvm::Function* operator()(const Method& node) const
+  {
+    if (node.decl.isTemplate()) {
+      assert(!node.prologue);
 
-    if (func && !func->isDeclaration()) {
-      throw CodegenError{
-        ctx.formatError(ctx.positionOf(node.decl),
-                        fmt::format("redefinition of '{}'", name))};
+      return (*this)(ast::FunctionDef{node.is_public,
+                                      ast::FunctionDecl{node.decl},
+                                      ast::Stmt{*node.body}});
     }
 
-    if (!func)
-      func = (*this)(node.decl);
-
-    assert(func);
-
-    if (!node.is_public && name != "main")
-      func->setLinkage(llvm::Function::LinkageTypes::InternalLinkage);
-
-    createFunctionBody(
-      ctx,
-      func,
-      name,
-      node.decl.params,
-      createType(ctx, node.decl.return_type, ctx.positionOf(node.decl)),
-      node.body);
-
-    ctx.fpm.run(*func);
-
-    return func;
+    return defineFunction(node.is_public,
+                          node.decl,
+                          *node.body,
+                          node.prologue ? &*node.prologue : nullptr);
   }
 
   llvm::Function* operator()(const ast::ClassDecl& node) const
   {
-    const auto name = node.name.utf8();
-
-    if (ctx.class_table.exists(name))
+    if (ctx.class_table.exists(node.name.name))
       return nullptr;
 
-    ctx.class_table.insert(name, ClassType::createOpaqueClass(ctx, name));
+    ctx.class_table.insert(node.name.name,
+                           ClassType::createOpaqueClass(ctx, node.name.utf8()));
 
     return nullptr;
   }
 
   llvm::Function* operator()(const ast::ClassDef& node) const
   {
-    if (node.isTemplate())
+    if (node.isTemplate()) {
       insertTemplateClassToTable(node);
-    else
-      createClass(ctx, node, MethodGeneration::define_and_declare);
+      return nullptr;
+    }
+
+    const llvm::TimeTraceScope scope{"ClassDef", node.name.utf8()};
+
+    createClass(ctx, node, MethodGeneration::define_and_declare);
 
     return nullptr;
   }
@@ -674,9 +644,9 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
     if (node.isTemplate()) {
       verifyTemplateParameter(node.template_params);
 
-      const auto name = node.name.utf8();
+      const auto& name = node.name.utf8();
 
-      const auto key = TemplateTableKey{name,
+      const auto key = TemplateTableKey{node.name.name,
                                         node.template_params->size(),
                                         ctx.ns_hierarchy};
 
@@ -701,7 +671,7 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
     // TODO: If there is already an alias of the same type, make an error
 
     ctx.alias_table.insertOrAssign(
-      node.alias.utf8(),
+      node.alias.name,
       createType(ctx, node.type, ctx.positionOf(node)));
 
     return nullptr;
@@ -713,15 +683,26 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
 
     auto path = ctx.current_file.parent_path() / fs::path{node.path.utf32()};
 
-    const auto result
-      = parse::Parser{loadFile(path, ctx.positionOf(node)), path}.getResult();
+    const llvm::TimeTraceScope scope{"Import", path.string()};
+
+    const auto imported = ctx.import_cache.load(path, [&]() {
+      return loadFile(path, ctx.positionOf(node));
+    });
+
+    ctx.imported_files.push_back(fs::absolute(path).lexically_normal());
+
+    // Keeps the imported file alive
+    ctx.addFile(path.string(),
+                imported->source,
+                std::shared_ptr<const PositionTable>{
+                  imported,
+                  &imported->interface.positions});
 
-    ctx.position_cache_table.insert(path.string(), std::move(result.positions));
     const auto file_backup = std::move(ctx.current_file);
-    ctx.current_file       = std::move(result.file);
+    ctx.current_file       = path;
 
-    for (const auto& node_with_attr : result.ast) {
-      const auto node = node_with_attr.top_level;
+    for (const auto& node_with_attr : imported->interface.ast) {
+      const auto& node = node_with_attr.top_level;
 
       if (const auto func_def = boost::get<ast::FunctionDef>(&node);
           func_def && func_def->is_public) {
@@ -758,16 +739,53 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
   }
 
 private:
+  llvm::Function* defineFunction(const bool               is_public,
+                                 const ast::FunctionDecl& decl,
+                                 const ast::Stmt&         body,
+                                 const ast::Stmt* const   prologue) const
+  {
+    const auto& name = decl.name.utf8();
+
+    const llvm::TimeTraceScope scope{"FunctionDef", name};
+
+    auto func = ctx.module->getFunction(mangleFunction(decl));
+
+    if (func && !func->isDeclaration()) {
+      throw CodegenError{
+        ctx.formatError(ctx.positionOf(decl),
+                        fmt::format("redefinition of '{}'", name))};
+    }
+
+    if (!func)
+      func = (*this)(decl);
+
+    assert(func);
+
+    if (!is_public && name != "main")
+      func->setLinkage(llvm::Function::LinkageTypes::InternalLinkage);
+
+    createFunctionBody(ctx,
+                       func,
+                       name,
+                       decl.params,
+                       createType(ctx, decl.return_type, ctx.positionOf(decl)),
+                       body,
+                       prologue);
+
+    return func;
+  }
+
   void insertTemplateClassToTable(const ast::ClassDef& node) const
   {
     assert(node.isTemplate());
 
     verifyTemplateParameter(node.template_params);
 
-    const auto name = node.name.utf8();
+    const auto& name = node.name.utf8();
 
-    const auto key
-      = TemplateTableKey{name, node.template_params->size(), ctx.ns_hierarchy};
+    const auto key = TemplateTableKey{node.name.name,
+                                      node.template_params->size(),
+                                      ctx.ns_hierarchy};
 
     if (ctx.class_template_table.exists(key)) {
       throw CodegenError{
@@ -800,8 +818,8 @@ private:
     createClass(ctx, node, MethodGeneration::declare /* Only declaration */);
   }
 
-  [[nodiscard]] std::string loadFile(const std::filesystem::path& path,
-                                     const PositionRange&         pos) const
+  [[nodiscard]] std::shared_ptr<const SourceFile>
+  loadFile(const std::filesystem::path& path, const PositionRange& pos) const
   {
     if (!std::filesystem::exists(path)) {
       throw CodegenError{ctx.formatError(
@@ -809,11 +827,8 @@ private:
         fmt::format("{}: No such file or directory", path.string()))};
     }
 
-    if (auto file = std::ifstream{path, std::ios_base::binary}) {
-      std::stringstream ss;
-      ss << file.rdbuf();
-      return ss.str();
-    }
+    if (auto file = ctx.source_manager.load(path))
+      return file;
 
     throw CodegenError{
       ctx.formatError(pos,
@@ -837,6 +852,30 @@ private:
   std::unordered_set<AttrKind> attr_kinds;
 };
 
+void defineMethods(CGContext&          ctx,
+                   const ClassMethods& methods,
+                   const std::string&  class_name)
+{
+  ctx.ns_hierarchy.push({class_name, NamespaceKind::class_});
+
+  for (const auto& r : methods)
+    TopLevelVisitor{ctx, {}}(r);
+
+  ctx.ns_hierarchy.pop();
+}
+
+void declareMethods(CGContext&          ctx,
+                    const ClassMethods& methods,
+                    const std::string&  class_name)
+{
+  ctx.ns_hierarchy.push({class_name, NamespaceKind::class_});
+
+  for (const auto& r : methods)
+    TopLevelVisitor{ctx, {}}(r.decl);
+
+  ctx.ns_hierarchy.pop();
+}
+
 llvm::Function* createTopLevel(CGContext& ctx, const ast::TopLevel& node)
 {
   return boost::apply_visitor(TopLevelVisitor{ctx, {}}, node);
@@ -10,11 +10,12 @@
 #include <twk/codegen/common.hpp>
 #include <twk/codegen/exception.hpp>
 #include <twk/codegen/top_level.hpp>
+#include <llvm/Support/TimeProfiler.h>
 
 namespace twk::codegen
 {
 
-[[nodiscard]] llvm::Type* BuiltinType::getLLVMType(CGContext& ctx) const
+[[nodiscard]] llvm::Type* BuiltinType::createLLVMType(CGContext& ctx) const
 {
   switch (kind) {
   case BuiltinTypeKind::void_:
@@ -141,32 +142,32 @@ namespace twk::codegen
 }
 
 [[nodiscard]] std::shared_ptr<Type>
-UserDefinedType::getRealType(CGContext& ctx) const
+BuiltinType::withMutable(CGContext& ctx, const bool is_mutable) const
 {
-  const auto clone_and_update_mutable = [&](const auto& type) {
-    auto cloned_type = type->get()->clone();
-    cloned_type->setMutable(ctx, isMutable());
-    return cloned_type;
-  };
+  return ctx.types.getBuiltinType(kind, is_mutable);
+}
 
+[[nodiscard]] std::shared_ptr<Type>
+UserDefinedType::getRealType(CGContext& ctx) const
+{
   if (const auto type = ctx.class_table[ident])
-    return clone_and_update_mutable(type);
+    return type->get()->withMutable(ctx, isMutable());
 
   if (const auto type = ctx.alias_table[ident])
-    return clone_and_update_mutable(type);
+    return type->get()->withMutable(ctx, isMutable());
 
   if (const auto type = ctx.union_table[ident])
-    return clone_and_update_mutable(type);
+    return type->get()->withMutable(ctx, isMutable());
 
   if (!ctx.template_argument_tables.empty()) {
     if (const auto type = ctx.template_argument_tables.top()[ident])
-      return clone_and_update_mutable(type);
+      return type->get()->withMutable(ctx, isMutable());
   }
 
   return {}; // Could not find a type
 }
 
-[[nodiscard]] llvm::Type* UserDefinedType::getLLVMType(CGContext& ctx) const
+[[nodiscard]] llvm::Type* UserDefinedType::createLLVMType(CGContext& ctx) const
 {
   const auto type = getRealType(ctx);
 
@@ -181,6 +182,12 @@ UserDefinedType::getRealType(CGContext& ctx) const
   return getRealType(ctx)->getMangledName(ctx);
 }
 
+[[nodiscard]] std::shared_ptr<Type>
+UserDefinedType::withMutable(CGContext& ctx, const bool is_mutable) const
+{
+  return ctx.types.getUserDefinedType(ident, is_mutable);
+}
+
 [[nodiscard]] llvm::StructType*
 createStructType(CGContext&                 ctx,
                  std::vector<llvm::Type*>&& members,
@@ -192,52 +199,39 @@ createStructType(CGContext&                 ctx,
   return llvm::StructType::create(ctx.context, members, name);
 }
 
-ClassType::ClassType(CGContext&                    ctx,
-                     std::vector<MemberVariable>&& members_arg,
-                     const std::u32string&         u32_name,
-                     const bool                    is_mutable)
-  : Type{is_mutable}
-  , is_opaque{false}
-  , members{std::move(members_arg)}
-  , name{unicode::utf32toUtf8(u32_name)}
-  , type{createStructType(ctx, extractTypes(ctx, members), name)}
+[[nodiscard]] std::shared_ptr<ClassType>
+ClassType::create(CGContext& ctx, std::shared_ptr<Body>&& body)
 {
-}
+  const std::shared_ptr<ClassType> type{new ClassType{std::move(body)}};
 
-ClassType::ClassType(CGContext&                    ctx,
-                     std::vector<MemberVariable>&& members_arg,
-                     const std::string&            name,
-                     const bool                    is_mutable)
-  : Type{is_mutable}
-  , is_opaque{false}
-  , members{std::move(members_arg)}
-  , name{name}
-  , type{createStructType(ctx, extractTypes(ctx, members), this->name)}
-{
+  ctx.types.addNominalType(
+    type,
+    std::shared_ptr<ClassType>{new ClassType{*type, true}});
+
+  return type;
 }
 
-ClassType::ClassType(CGContext&                    ctx,
-                     std::vector<MemberVariable>&& members,
-                     const std::string&            ident,
-                     llvm::StructType* const       type,
-                     const bool                    is_mutable)
-  : Type{is_mutable}
-  , is_opaque{true}
-  , members{std::move(members)}
-  , name{ident}
-  , type{type}
+[[nodiscard]] std::shared_ptr<ClassType>
+ClassType::create(CGContext&                    ctx,
+                  std::vector<MemberVariable>&& members,
+                  const std::string&            name)
 {
+  auto type = createStructType(ctx, extractTypes(ctx, members), name);
+
+  return create(
+    ctx,
+    std::make_shared<Body>(Body{false, std::move(members), name, type}));
 }
 
-std::shared_ptr<ClassType>
+[[nodiscard]] std::shared_ptr<ClassType>
 ClassType::createOpaqueClass(CGContext& ctx, const std::string& ident)
 {
-  return std::make_shared<ClassType>(
-    ctx,
-    std::vector<MemberVariable>{},
-    ident,
-    llvm::StructType::create(ctx.context, ident),
-    false);
+  return create(ctx,
+                std::make_shared<Body>(
+                  Body{true,
+                       std::vector<MemberVariable>{},
+                       ident,
+                       llvm::StructType::create(ctx.context, ident)}));
 }
 
 std::vector<llvm::Type*>
@@ -255,15 +249,15 @@ ClassType::extractTypes(CGContext&                         ctx,
 void ClassType::setBody(CGContext&                    ctx,
                         std::vector<MemberVariable>&& members_arg) noexcept
 {
-  llvm::cast<llvm::StructType>(type)->setBody(extractTypes(ctx, members_arg));
+  body->type->setBody(extractTypes(ctx, members_arg));
 
-  members = std::move(members_arg);
+  body->members = std::move(members_arg);
 }
 
 [[nodiscard]] std::optional<std::size_t>
 ClassType::offsetByName(const std::string_view member_name) const
 {
-  for (std::size_t offset = 0; const auto& member : members) {
+  for (std::size_t offset = 0; const auto& member : body->members) {
     if (member.name == member_name)
       return offset;
     ++offset;
@@ -336,14 +330,26 @@ UnionType::createVariants(CGContext&         ctx,
 
 UnionType::UnionType(CGContext&         ctx,
                      const std::string& name,
-                     Tags&&             members,
-                     const bool         is_mutable)
-  : Type{is_mutable}
+                     Tags&&             members)
+  : NominalType{false}
   , name{name}
   , actual{createActual(ctx, members, this->name)}
 {
 }
 
+[[nodiscard]] std::shared_ptr<UnionType>
+UnionType::create(CGContext& ctx, const std::string& name, Tags&& members)
+{
+  const std::shared_ptr<UnionType> type{
+    new UnionType{ctx, name, std::move(members)}};
+
+  ctx.types.addNominalType(
+    type,
+    std::shared_ptr<UnionType>{new UnionType{*type, true}});
+
+  return type;
+}
+
 [[nodiscard]] std::optional<const std::reference_wrapper<const UnionVariant>>
 UnionType::getUnionVariantType(const std::string& tag) const
 {
@@ -360,12 +366,141 @@ UnionType::getUnionVariantType(const std::string& tag) const
   return "P" + pointee_type->getMangledName(ctx);
 }
 
+[[nodiscard]] std::shared_ptr<Type>
+PointerType::withMutable(CGContext& ctx, const bool is_mutable) const
+{
+  return ctx.types.getPointerType(pointee_type->withMutable(ctx, is_mutable),
+                                  is_mutable);
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+PointerType::getCanonicalType(CGContext& ctx) const
+{
+  if (!dependsOnScope())
+    return withMutable(ctx, false);
+
+  return ctx.types.getPointerType(pointee_type->getCanonicalType(ctx), false);
+}
+
 [[nodiscard]] std::string ArrayType::getMangledName(CGContext& ctx) const
 {
   return "A" + boost::lexical_cast<std::string>(array_size) + "_"
          + element_type->getMangledName(ctx);
 }
 
+[[nodiscard]] std::shared_ptr<Type>
+ArrayType::withMutable(CGContext& ctx, const bool is_mutable) const
+{
+  return ctx.types.getArrayType(element_type->withMutable(ctx, is_mutable),
+                                array_size,
+                                is_mutable);
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+ArrayType::getCanonicalType(CGContext& ctx) const
+{
+  if (!dependsOnScope())
+    return withMutable(ctx, false);
+
+  return ctx.types.getArrayType(element_type->getCanonicalType(ctx),
+                                array_size,
+                                false);
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+ReferenceType::withMutable(CGContext& ctx, const bool is_mutable) const
+{
+  return ctx.types.getReferenceType(refee_type->withMutable(ctx, is_mutable),
+                                    is_mutable);
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+ReferenceType::getCanonicalType(CGContext& ctx) const
+{
+  if (!dependsOnScope())
+    return withMutable(ctx, false);
+
+  return ctx.types.getReferenceType(refee_type->getCanonicalType(ctx), false);
+}
+
+//===----------------------------------------------------------------------===//
+// Canonical type table
+//===----------------------------------------------------------------------===//
+
+[[nodiscard]] std::shared_ptr<Type>
+CanonicalTypeTable::getBuiltinType(const BuiltinTypeKind kind,
+                                   const bool            is_mutable)
+{
+  auto& type = builtin_types[static_cast<std::size_t>(kind)][is_mutable];
+
+  if (!type)
+    type.reset(new BuiltinType{kind, is_mutable});
+
+  return type;
+}
+
+[[nodiscard]] std::shared_ptr<UserDefinedType>
+CanonicalTypeTable::getUserDefinedType(const Symbol ident,
+                                       const bool   is_mutable)
+{
+  auto& type = user_defined_types[ident][is_mutable];
+
+  if (!type)
+    type.reset(new UserDefinedType{ident, is_mutable});
+
+  return type;
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+CanonicalTypeTable::getPointerType(const std::shared_ptr<Type>& pointee_type,
+                                   const bool                   is_mutable)
+{
+  auto& type = pointer_types[pointee_type.get()][is_mutable];
+
+  if (!type)
+    type.reset(new PointerType{pointee_type, is_mutable});
+
+  return type;
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+CanonicalTypeTable::getArrayType(const std::shared_ptr<Type>& element_type,
+                                 const std::uint64_t          array_size,
+                                 const bool                   is_mutable)
+{
+  auto& type = array_types[{element_type.get(), array_size}][is_mutable];
+
+  if (!type)
+    type.reset(new ArrayType{element_type, array_size, is_mutable});
+
+  return type;
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+CanonicalTypeTable::getReferenceType(const std::shared_ptr<Type>& refee_type,
+                                     const bool                   is_mutable)
+{
+  auto& type = reference_types[refee_type.get()][is_mutable];
+
+  if (!type)
+    type.reset(new ReferenceType{refee_type, is_mutable});
+
+  return type;
+}
+
+void CanonicalTypeTable::addNominalType(
+  const std::shared_ptr<NominalType>& immutable_type,
+  const std::shared_ptr<NominalType>& mutable_type)
+{
+  assert(!immutable_type->isMutable() && mutable_type->isMutable());
+
+  immutable_type->requalified = mutable_type.get();
+  mutable_type->requalified   = immutable_type.get();
+
+  nominal_types.push_back(immutable_type);
+  nominal_types.push_back(mutable_type);
+}
+
 void verifyType(CGContext&                   ctx,
                 const std::shared_ptr<Type>& type,
                 const PositionRange&         pos)
@@ -390,7 +525,7 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
   [[nodiscard]] std::shared_ptr<Type>
   operator()(const ast::BuiltinType& node) const
   {
-    return std::make_shared<BuiltinType>(node.kind, false);
+    return ctx.types.getBuiltinType(node.kind, false);
   }
 
   [[nodiscard]] std::shared_ptr<Type>
@@ -400,7 +535,7 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
 
     verifyType(ctx, type, ctx.positionOf(node));
 
-    return std::make_shared<ArrayType>(type, node.size, false);
+    return ctx.types.getArrayType(type, node.size, false);
   }
 
   [[nodiscard]] std::shared_ptr<Type>
@@ -413,7 +548,7 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
     verifyType(ctx, type, ctx.positionOf(node));
 
     for (std::size_t i = 0; i < node.n_ops.size(); ++i)
-      type = std::make_shared<PointerType>(type, false);
+      type = ctx.types.getPointerType(type, false);
 
     return type;
   }
@@ -423,8 +558,7 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
   {
     // If it was a template argument, it will be erased later, so return a real
     // type
-    return std::make_shared<UserDefinedType>(node.name.utf32(), true)
-      ->getRealType(ctx);
+    return ctx.types.getUserDefinedType(node.name.name, true)->getRealType(ctx);
   }
 
   [[nodiscard]] std::shared_ptr<Type>
@@ -432,13 +566,17 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
   {
     const auto pos = ctx.positionOf(node);
 
-    const auto class_name = node.template_type.name.utf8();
+    const auto& class_name = node.template_type.name.utf8();
 
-    const auto mangled_class_name
-      = ctx.mangler.mangleClassTemplateName(class_name, node.template_args);
+    const auto args_pos = ctx.positionOf(node.template_args);
 
-    const auto template_type
-      = std::make_shared<UserDefinedType>(mangled_class_name, false);
+    std::vector<const Type*> template_args;
+    template_args.reserve(node.template_args.types.size());
+
+    for (const auto& arg : node.template_args.types) {
+      template_args.push_back(
+        createType(ctx, arg, args_pos)->getCanonicalType(ctx).get());
+    }
 
     const auto class_template
       = findClassTemplate(ctx, class_name, node.template_args);
@@ -449,20 +587,26 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
         fmt::format("unknown class template '{}'", class_name))};
     }
 
-    auto table_key = CreatedClassTemplateTableKey{class_name,
-                                                  node.template_args,
-                                                  class_template->second};
+    auto table_key
+      = CreatedClassTemplateTableKey{node.template_type.name.name,
+                                     std::move(template_args),
+                                     class_template->second.path()};
 
     if (const auto type = ctx.created_class_template_table[table_key])
       return *type;
 
+    const auto mangled_class_name
+      = ctx.mangler.mangleClassTemplateName(class_name, node.template_args);
+
     const auto type = createClassFromTemplate(mangled_class_name,
                                               class_template->first,
                                               node.template_args,
                                               class_template->second,
                                               pos);
 
-    ctx.created_class_template_table.insert(std::move(table_key), type);
+    // The same class may have been instantiated while creating its methods
+    ctx.created_class_template_table.insertOrAssign(std::move(table_key),
+                                                    type);
 
     return type;
   }
@@ -470,9 +614,8 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
   [[nodiscard]] std::shared_ptr<Type>
   operator()(const ast::ReferenceType& node) const
   {
-    return std::make_shared<ReferenceType>(
-      createType(ctx, node.refee_type, pos),
-      false);
+    return ctx.types.getReferenceType(createType(ctx, node.refee_type, pos),
+                                      false);
   }
 
 private:
@@ -483,6 +626,8 @@ private:
     const NamespaceStack&          space, // FIXME: Use this argument
     const PositionRange&           pos) const
   {
+    const llvm::TimeTraceScope scope{"InstantiateClass", mangled_class_name};
+
     const TemplateArgumentsDefiner ta_definer{ctx,
                                               template_args,
                                               ast.template_params,
@@ -6,12 +6,17 @@
  */
 
 #include <twk/compile/compile.hpp>
+#include <twk/cache/cache.hpp>
 #include <twk/codegen/codegen.hpp>
 #include <twk/jit/jit.hpp>
 #include <twk/parse/parser.hpp>
+#include <twk/parse/exception.hpp>
 #include <twk/support/file.hpp>
 #include <twk/support/utils.hpp>
 #include <twk/support/exception.hpp>
+#include <twk/support/parallel.hpp>
+#include <twk/support/timing.hpp>
+#include <unordered_set>
 
 namespace twk
 {
@@ -21,6 +26,8 @@ namespace twk
 static FilePaths emitFile(codegen::CodeGenerator& generator,
                           const std::string&      target)
 {
+  const PhaseScope phase{"Emission"};
+
   if (target == EMIT_EXE_ARG)
     return generator.emitTemporaryObjectFiles();
 
@@ -52,23 +59,227 @@ getRelocationModel(const std::string_view reloc_model,
   }
 }
 
-std::optional<CompileResult> compile(const Context&         ctx,
-                                     const std::string_view argv_front)
-try {
+// Parse input files in parallel
+// The results and error messages are in the same order as the input files
+[[nodiscard]] static std::vector<parse::Parser::Result>
+parseInputFiles(SourceManager&                  source_manager,
+                const std::vector<std::string>& input_files,
+                const unsigned int              jobs,
+                const std::string_view          argv_front)
+{
+  const PhaseScope phase{"Parse"};
+
+  std::vector<std::optional<parse::Parser::Result>> results(
+    input_files.size());
+
+  // Error messages are buffered per file so that they are not interleaved
+  std::vector<std::ostringstream> err_ostms(input_files.size());
+
+  // Files and the chunks in each file share one budget of threads, so a single
+  // large file gets all of them, and many files get one each
+  const auto parser_jobs = static_cast<unsigned int>(
+    getWorkerCount(jobs, std::numeric_limits<std::size_t>::max())
+    / getWorkerCount(jobs, input_files.size()));
+
+  parallelFor(jobs,
+              input_files.size(),
+              [&](const std::size_t idx, std::size_t) {
+                const auto& path     = input_files[idx];
+                auto&       err_ostm = err_ostms[idx];
+
+                const llvm::TimeTraceScope scope{"ParseFile", path};
+
+                try {
+                  results[idx].emplace(
+                    parse::Parser{loadFile(source_manager, argv_front, path),
+                                  path,
+                                  err_ostm,
+                                  parser_jobs}
+                      .getResult());
+                }
+                catch (const parse::ParseError&) {
+                  // The error has already been written by the parser
+                }
+                catch (const ErrorBase& err) {
+                  err_ostm << err.what()
+                           << (isBackNewline(err.what()) ? "" : "\n");
+                }
+              });
+
+  bool failed = false;
+
+  for (std::size_t idx = 0; idx < input_files.size(); ++idx) {
+    std::cerr << err_ostms[idx].str();
+
+    if (!results[idx])
+      failed = true;
+  }
+
+  if (failed)
+    throw parse::ParseError{"compilation terminated."};
+
   std::vector<parse::Parser::Result> parse_results;
+  parse_results.reserve(input_files.size());
+
+  for (auto&& result : results)
+    parse_results.emplace_back(std::move(*result));
 
-  for (const auto& path : ctx.input_files) {
-    parse_results.emplace_back(
-      parse::Parser{loadFile(argv_front, path), path}.getResult());
+  return parse_results;
+}
+
+// Only object files are cached, and cached object files are used without
+// parsing and code generation
+[[nodiscard]] static FilePaths
+compileWithCache(const Context&           ctx,
+                 const std::string_view   argv_front,
+                 const llvm::Reloc::Model relocation_model)
+{
+  assert(ctx.cache_dir);
+
+  cache::ObjectCache cache{*ctx.cache_dir,
+                           ctx.opt_level,
+                           ctx.target_triple
+                             ? *ctx.target_triple
+                             : llvm::sys::getDefaultTargetTriple(),
+                           ctx.relocation_model};
+
+  const auto& input_files = ctx.input_files;
+
+  FilePaths created_files(input_files.size());
+
+  // The input files are read once for both the keys and parsing
+  SourceManager source_manager;
+
+  std::vector<std::optional<std::string>> keys(input_files.size());
+
+  // Indexes of the input files that missed the cache
+  std::vector<std::size_t> missed_idxs;
+  std::vector<std::string> missed_files;
+
+  for (std::size_t idx = 0; idx < input_files.size(); ++idx) {
+    const auto source = source_manager.load(input_files[idx]);
+
+    const auto& key = keys[idx]
+      = source ? cache.createKey(input_files[idx], source->text())
+               : std::nullopt;
+
+    if (const auto object_file = cache.lookup(key)) {
+      if (ctx.emit_target == EMIT_EXE_ARG) {
+        // Object files for linking can be used directly from the cache
+        created_files[idx] = *object_file;
+      }
+      else {
+        created_files[idx]
+          = std::filesystem::path{input_files[idx]}.stem().string() + ".o";
+
+        std::filesystem::copy_file(
+          *object_file,
+          created_files[idx],
+          std::filesystem::copy_options::overwrite_existing);
+      }
+
+      continue;
+    }
+
+    missed_idxs.push_back(idx);
+    missed_files.push_back(input_files[idx]);
+  }
+
+  // The cache is not used with JIT compilation, LTO or PGO
+  if (!missed_files.empty()) {
+    codegen::CodeGenerator code_generator{
+      argv_front,
+      source_manager,
+      parseInputFiles(source_manager, missed_files, ctx.jobs, argv_front),
+      ctx.opt_level,
+      relocation_model,
+      ctx.target_triple,
+      false,
+      false,
+      false,
+      false,
+      ctx.cache_dir,
+      ctx.jobs,
+      false,
+      std::nullopt};
+
+    const auto object_files   = emitFile(code_generator, ctx.emit_target);
+    const auto imported_files = code_generator.getImportedFiles();
+
+    for (std::size_t i = 0; i < missed_idxs.size(); ++i) {
+      const auto idx = missed_idxs[i];
+
+      created_files[idx] = object_files[i];
+
+      if (keys[idx])
+        cache.store(*keys[idx], imported_files[i], object_files[i]);
+    }
   }
 
+  if (ctx.print_cache_stats) {
+    fmt::print(stderr,
+               "cache hits: {}, cache misses: {}\n",
+               cache.getHits(),
+               cache.getMisses());
+  }
+
+  return created_files;
+}
+
+[[nodiscard]] static std::optional<CompileResult>
+compileFiles(const Context& ctx, const std::string_view argv_front)
+try {
+  const auto relocation_model
+    = getRelocationModel(ctx.relocation_model, argv_front);
+
+  if (ctx.lto && ctx.thin_lto) {
+    throw ErrorBase{
+      formatError(argv_front, "--lto and --thin-lto cannot be used together")};
+  }
+
+  if (ctx.profile_generate && ctx.profile_use) {
+    throw ErrorBase{formatError(
+      argv_front,
+      "--profile-generate and --profile-use cannot be used together")};
+  }
+
+  // The profile runtime cannot be loaded into the JIT compiler
+  if (ctx.profile_generate && ctx.jit) {
+    throw ErrorBase{
+      formatError(argv_front, "--profile-generate cannot be used with --JIT")};
+  }
+
+  if (ctx.profile_use)
+    codegen::verifyProfile(*ctx.profile_use, argv_front);
+
+  // Object files are cached per input file, which does not apply to LTO
+  // ThinLTO has its own cache in the cache directory
+  // The cache key does not include the profile
+  if (ctx.cache_dir && !ctx.jit && !ctx.lto && !ctx.thin_lto
+      && !ctx.profile_generate && !ctx.profile_use
+      && (ctx.emit_target == EMIT_EXE_ARG || ctx.emit_target == EMIT_OBJ_ARG))
+    return AOTResult{compileWithCache(ctx, argv_front, relocation_model)};
+
+  // Shared by the parser and the code generator, which reads imported files
+  SourceManager source_manager;
+
   codegen::CodeGenerator code_generator{
     argv_front,
-    std::move(parse_results),
+    source_manager,
+    parseInputFiles(source_manager, ctx.input_files, ctx.jobs, argv_front),
     ctx.opt_level,
-    getRelocationModel(ctx.relocation_model, argv_front),
+    relocation_model,
     ctx.target_triple,
-    ctx.jit};
+    ctx.jit,
+    ctx.lto,
+    ctx.thin_lto,
+    ctx.jit || ctx.emit_target == EMIT_EXE_ARG,
+    ctx.cache_dir,
+    ctx.jobs,
+    ctx.profile_generate,
+    ctx.profile_use ? std::make_optional(
+      std::filesystem::path{*ctx.profile_use})
+                    : std::nullopt};
 
   if (ctx.jit)
     return JITResult{code_generator.doJIT()};
@@ -84,4 +295,351 @@ catch (const ErrorBase& err) {
   return std::nullopt;
 }
 
+std::optional<CompileResult> compile(const Context&         ctx,
+                                     const std::string_view argv_front)
+{
+  std::optional<TimeTraceProfiler> profiler;
+  std::optional<TimeReport>        report;
+
+  if (ctx.time_trace) {
+    profiler.emplace(ctx.time_trace_granularity,
+                     std::filesystem::path{argv_front}.filename().string());
+  }
+
+  if (ctx.time_report)
+    report.emplace();
+
+  // The strings interned by this compilation are freed at the end of it
+  StringInterner      interner;
+  const InternerScope interner_scope{interner};
+
+  const auto result = compileFiles(ctx, argv_front);
+
+  if (report)
+    report->print(llvm::errs());
+
+  if (profiler && !ctx.input_files.empty()) {
+    const auto path
+      = std::filesystem::path{ctx.input_files.front()}.stem().string()
+        + ".time-trace.json";
+
+    if (!profiler->write(path)) {
+      std::cerr << formatError(
+        argv_front,
+        fmt::format("{}: Could not write the time trace\n", path))
+                << std::flush;
+
+      return std::nullopt;
+    }
+  }
+
+  return result;
+}
+
+void initializeCompiler()
+{
+  codegen::initializeTargets();
+}
+
+//===----------------------------------------------------------------------===//
+// Incremental compilation
+//===----------------------------------------------------------------------===//
+
+// Files are identified by their absolute paths, in the same way as the
+// imported files of the code generator
+[[nodiscard]] static std::filesystem::path
+normalizePath(const std::filesystem::path& path)
+{
+  return std::filesystem::absolute(path).lexically_normal();
+}
+
+// Collect the imported files including the ones imported in namespaces
+static void collectImports(const ast::TopLevelList&            ast,
+                           const std::filesystem::path&        dir,
+                           std::vector<std::filesystem::path>& imports)
+{
+  for (const auto& node : ast) {
+    if (const auto import = boost::get<ast::Import>(&node.top_level)) {
+      imports.push_back(
+        normalizePath(dir / std::filesystem::path{import->path.utf32()}));
+    }
+    else if (const auto name_space
+             = boost::get<ast::Namespace>(&node.top_level))
+      collectImports(name_space->top_levels, dir, imports);
+  }
+}
+
+struct IncrementalCompiler::State {
+  struct InputFile {
+    std::filesystem::path path;
+
+    // If not set, the file is compiled by the next compilation
+    std::optional<std::filesystem::path> created_file;
+  };
+
+  State(const Context& ctx, const std::string_view argv_front)
+    : ctx{ctx}
+    , argv_front{argv_front}
+    , relocation_model{getRelocationModel(ctx.relocation_model, argv_front)}
+  {
+    // The created files of all input files are needed by every compilation
+    if (ctx.jit || ctx.lto || ctx.thin_lto) {
+      throw ErrorBase{formatError(
+        argv_front,
+        "--watch cannot be used with --JIT, --lto or --thin-lto")};
+    }
+
+    if (ctx.profile_generate && ctx.profile_use) {
+      throw ErrorBase{formatError(
+        argv_front,
+        "--profile-generate and --profile-use cannot be used together")};
+    }
+
+    if (ctx.profile_use)
+      codegen::verifyProfile(*ctx.profile_use, argv_front);
+
+    for (const auto& file : ctx.input_files)
+      input_files.push_back({normalizePath(file), std::nullopt});
+  }
+
+  // Returns the files importing the changed files directly or indirectly,
+  // including the changed files
+  [[nodiscard]] std::unordered_set<std::string>
+  findAffectedFiles(const std::vector<std::filesystem::path>& changed_files)
+    const
+  {
+    std::unordered_map<std::string, std::vector<std::string>> importers;
+
+    for (const auto& [file, imported_files] : imports) {
+      for (const auto& imported_file : imported_files)
+        importers[imported_file.string()].push_back(file);
+    }
+
+    std::unordered_set<std::string> affected;
+    std::vector<std::string>        work_list;
+
+    for (const auto& file : changed_files) {
+      if (affected.insert(file.string()).second)
+        work_list.push_back(file.string());
+    }
+
+    while (!work_list.empty()) {
+      const auto file = std::move(work_list.back());
+      work_list.pop_back();
+
+      if (const auto iter = importers.find(file); iter != importers.end()) {
+        for (const auto& importer : iter->second) {
+          if (affected.insert(importer).second)
+            work_list.push_back(importer);
+        }
+      }
+    }
+
+    return affected;
+  }
+
+  // The imports of the imported files are found by parsing them, since the
+  // code generator only reads their interfaces
+  void scanImportedFiles()
+  {
+    std::vector<std::filesystem::path> work_list;
+
+    for (const auto& [file, imported_files] : imports) {
+      work_list.insert(work_list.end(),
+                       imported_files.begin(),
+                       imported_files.end());
+    }
+
+    while (!work_list.empty()) {
+      const auto file = std::move(work_list.back());
+      work_list.pop_back();
+
+      if (imports.contains(file.string()))
+        continue;
+
+      auto& imported_files = imports[file.string()];
+
+      // Errors are reported by the code generator
+      try {
+        if (auto source = source_manager.load(file)) {
+          std::ostringstream discarded;
+
+          collectImports(
+            parse::Parser{std::move(source), file, discarded}.getResult().ast,
+            file.parent_path(),
+            imported_files);
+        }
+      }
+      catch (const ErrorBase&) {
+      }
+
+      work_list.insert(work_list.end(),
+                       imported_files.begin(),
+                       imported_files.end());
+    }
+  }
+
+  [[nodiscard]] AOTResult
+  compile(const std::vector<std::filesystem::path>& changed_files)
+  {
+    // The profile may be replaced while watching
+    if (ctx.profile_use)
+      codegen::verifyProfile(*ctx.profile_use, argv_front);
+
+    // Each compilation has its own interner, so parse results are not kept
+    // between compilations, and the strings of replaced code are freed
+    StringInterner      interner;
+    const InternerScope interner_scope{interner};
+
+    for (const auto& file : changed_files) {
+      source_manager.invalidate(file);
+      imports.erase(file.string());
+    }
+
+    const auto affected = findAffectedFiles(changed_files);
+
+    std::vector<std::size_t> compiled_idxs;
+    std::vector<std::string> compiled_files;
+
+    for (std::size_t idx = 0; idx < input_files.size(); ++idx) {
+      auto& input_file = input_files[idx];
+
+      if (!affected.contains(input_file.path.string())
+          && input_file.created_file)
+        continue;
+
+      // Object files for linking are temporary files, which are replaced
+      if (ctx.emit_target == EMIT_EXE_ARG && input_file.created_file) {
+        std::error_code ec;
+        std::filesystem::remove(*input_file.created_file, ec);
+      }
+
+      // Compiled again by the next compilation if this compilation fails
+      input_file.created_file.reset();
+      compiled_idxs.push_back(idx);
+      compiled_files.push_back(ctx.input_files[idx]);
+    }
+
+    if (!compiled_files.empty()) {
+      auto parse_results = parseInputFiles(source_manager,
+                                           compiled_files,
+                                           ctx.jobs,
+                                           argv_front);
+
+      for (std::size_t i = 0; i < compiled_idxs.size(); ++i) {
+        const auto& input_file = input_files[compiled_idxs[i]];
+
+        auto& imported_files = imports[input_file.path.string()];
+        imported_files.clear();
+        collectImports(parse_results[i].ast,
+                       input_file.path.parent_path(),
+                       imported_files);
+      }
+
+      scanImportedFiles();
+
+      codegen::CodeGenerator code_generator{
+        argv_front,
+        source_manager,
+        std::move(parse_results),
+        ctx.opt_level,
+        relocation_model,
+        ctx.target_triple,
+        false,
+        false,
+        false,
+        false,
+        ctx.cache_dir,
+        ctx.jobs,
+        ctx.profile_generate,
+        ctx.profile_use ? std::make_optional(
+          std::filesystem::path{*ctx.profile_use})
+                        : std::nullopt};
+
+      const auto created_files = emitFile(code_generator, ctx.emit_target);
+
+      for (std::size_t i = 0; i < compiled_idxs.size(); ++i)
+        input_files[compiled_idxs[i]].created_file = created_files[i];
+    }
+
+    FilePaths created_files;
+
+    for (const auto& input_file : input_files)
+      created_files.push_back(*input_file.created_file);
+
+    return AOTResult{std::move(created_files)};
+  }
+
+  const Context& ctx;
+
+  const std::string_view argv_front;
+
+  const llvm::Reloc::Model relocation_model;
+
+  // Changed files are invalidated, so that the other files are read once
+  SourceManager source_manager;
+
+  std::vector<InputFile> input_files;
+
+  // The files imported from each file, keyed by its path
+  std::unordered_map<std::string, std::vector<std::filesystem::path>> imports;
+};
+
+IncrementalCompiler::IncrementalCompiler(const Context&         ctx,
+                                         const std::string_view argv_front)
+  : state{std::make_unique<State>(ctx, argv_front)}
+{
+}
+
+IncrementalCompiler::~IncrementalCompiler() = default;
+
+[[nodiscard]] std::optional<AOTResult> IncrementalCompiler::compile(
+  const std::vector<std::filesystem::path>& changed_files)
+try {
+  std::vector<std::filesystem::path> normalized_files;
+
+  for (const auto& file : changed_files)
+    normalized_files.push_back(normalizePath(file));
+
+  std::optional<TimeReport> report;
+
+  if (state->ctx.time_report)
+    report.emplace();
+
+  auto result = state->compile(normalized_files);
+
+  if (report)
+    report->print(llvm::errs());
+
+  return result;
+}
+catch (const ErrorBase& err) {
+  std::cerr << err.what() << (isBackNewline(err.what()) ? "" : "\n")
+            << std::flush;
+
+  return std::nullopt;
+}
+
+[[nodiscard]] std::vector<std::filesystem::path>
+IncrementalCompiler::getSourceFiles() const
+{
+  std::unordered_set<std::string>    found;
+  std::vector<std::filesystem::path> files;
+
+  const auto add = [&](const std::filesystem::path& file) {
+    if (found.insert(file.string()).second)
+      files.push_back(file);
+  };
+
+  for (const auto& input_file : state->input_files)
+    add(input_file.path);
+
+  for (const auto& [file, imported_files] : state->imports) {
+    for (const auto& imported_file : imported_files)
+      add(imported_file);
+  }
+
+  return files;
+}
+
 } // namespace twk
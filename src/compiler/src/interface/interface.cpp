@@ -0,0 +1,1692 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twk/interface/interface.hpp>
+#include <twk/support/file.hpp>
+#include <twk/support/utils.hpp>
+#include <llvm/Support/xxhash.h>
+#include <boost/mpl/at.hpp>
+#include <boost/mpl/for_each.hpp>
+#include <boost/mpl/size.hpp>
+#include <boost/type_traits/add_pointer.hpp>
+#include <bit>
+#include <typeinfo>
+
+namespace
+{
+
+using namespace twk;
+
+constexpr std::string_view MAGIC = "TWKI";
+
+// Bumped when the encoding changes other than by changes to the AST
+constexpr std::uint64_t FORMAT_VERSION = 2;
+
+[[nodiscard]] std::uint64_t hashSource(const std::string_view source)
+{
+  return llvm::xxHash64(source);
+}
+
+template <typename T>
+struct Tag {};
+
+template <typename Variant>
+void describeVariant(std::string& layout)
+{
+  boost::mpl::for_each<typename Variant::types,
+                       boost::add_pointer<boost::mpl::_1>>(
+    [&]<typename T>(T*) {
+      using Node = typename boost::unwrap_recursive<T>::type;
+
+      layout += fmt::format("{} {}\n", typeid(Node).name(), sizeof(Node));
+    });
+}
+
+// The encoding follows the AST, so interface files written with another AST
+// are not used
+// The hash covers the alternatives of the variants in order, which are
+// encoded as indexes, and the sizes of the nodes, which change with their
+// members
+[[nodiscard]] std::uint64_t getLayoutHash()
+{
+  static const auto hash = [] {
+    std::string layout;
+
+    describeVariant<ast::Type>(layout);
+    describeVariant<ast::Expr>(layout);
+    describeVariant<ast::Stmt>(layout);
+    describeVariant<ast::ClassMember>(layout);
+    describeVariant<ast::TopLevel>(layout);
+
+    return llvm::xxHash64(layout);
+  }();
+
+  return hash;
+}
+
+struct MalformedInterface {};
+
+//===----------------------------------------------------------------------===//
+// Writer
+//===----------------------------------------------------------------------===//
+
+// Positions are written as byte offsets in the source code, and are given new
+// ids when read
+struct Writer {
+  explicit Writer(const PositionTable& positions)
+    : positions{positions}
+  {
+  }
+
+  void writeInt(std::uint64_t value)
+  {
+    // LEB128
+    do {
+      const auto byte = static_cast<char>(value & 0x7f);
+      value >>= 7;
+      buffer += value ? static_cast<char>(byte | 0x80) : byte;
+    } while (value);
+  }
+
+  void write(const std::u32string& str)
+  {
+    writeInt(str.size());
+
+    for (const auto ch : str)
+      writeInt(ch);
+  }
+
+  void write(const bool value)
+  {
+    writeInt(value);
+  }
+
+  template <typename T>
+    requires std::is_enum_v<T>
+  void write(const T value)
+  {
+    writeInt(static_cast<std::uint64_t>(value));
+  }
+
+  void writePosition(const x3::position_tagged& node)
+  {
+    const auto pos = positions.find(node);
+
+    if (!pos) {
+      writeInt(0);
+      return;
+    }
+
+    writeInt(1);
+    writeInt(pos->first);
+    writeInt(pos->last);
+  }
+
+  template <typename T>
+  void write(const std::optional<T>& value)
+  {
+    write(value.has_value());
+
+    if (value)
+      write(*value);
+  }
+
+  template <typename T>
+  void writeRange(const T& range)
+  {
+    writeInt(range.size());
+
+    for (const auto& r : range)
+      write(r);
+  }
+
+  template <typename T>
+  void write(const std::vector<T>& range)
+  {
+    writeRange(range);
+  }
+
+  template <typename T>
+  void write(const std::deque<T>& range)
+  {
+    writeRange(range);
+  }
+
+  template <typename... Ts>
+  void write(const boost::variant<Ts...>& variant)
+  {
+    writeInt(variant.which());
+    boost::apply_visitor([this](const auto& r) { write(r); }, variant);
+  }
+
+  void write(const boost::blank)
+  {
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Common AST
+  //===--------------------------------------------------------------------===//
+
+  void write(const ast::Identifier& node)
+  {
+    writePosition(node);
+    write(node.utf32());
+  }
+
+  void write(const ast::TemplateParameters& node)
+  {
+    writePosition(node);
+    write(node.type_names);
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Type AST
+  //===--------------------------------------------------------------------===//
+
+  void write(const ast::BuiltinType& node)
+  {
+    writePosition(node);
+    write(node.kind);
+  }
+
+  void write(const ast::UserDefinedType& node)
+  {
+    writePosition(node);
+    write(node.name);
+  }
+
+  void write(const ast::TemplateArguments& node)
+  {
+    writePosition(node);
+    write(node.types);
+  }
+
+  void write(const ast::UserDefinedTemplateType& node)
+  {
+    writePosition(node);
+    write(node.template_type);
+    write(node.template_args);
+  }
+
+  void write(const ast::ArrayType& node)
+  {
+    writePosition(node);
+    write(node.element_type);
+    writeInt(node.size);
+  }
+
+  void write(const ast::PointerType& node)
+  {
+    writePosition(node);
+    writeInt(node.n_ops.size());
+    write(node.pointee_type);
+  }
+
+  void write(const ast::ReferenceType& node)
+  {
+    writePosition(node);
+    write(node.refee_type);
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Expression AST
+  //===--------------------------------------------------------------------===//
+
+  void write(const double value)
+  {
+    writeInt(std::bit_cast<std::uint64_t>(value));
+  }
+
+  template <typename T>
+    requires std::is_integral_v<T>
+  void write(const T value)
+  {
+    writeInt(static_cast<std::uint64_t>(value));
+  }
+
+  void write(const ast::Value&)
+  {
+    // Never created from parsing
+    unreachable();
+  }
+
+  void write(const ast::NullPointer& node)
+  {
+    writePosition(node);
+  }
+
+  void write(const ast::StringLiteral& node)
+  {
+    writePosition(node);
+    write(node.str);
+  }
+
+  void write(const ast::CharLiteral& node)
+  {
+    writePosition(node);
+    writeInt(node.ch);
+  }
+
+  void write(const ast::BuiltinMacro& node)
+  {
+    writePosition(node);
+    write(node.kind);
+  }
+
+  void write(const ast::SizeOfType& node)
+  {
+    writePosition(node);
+    write(node.type);
+  }
+
+  void write(const ast::BinOp& node)
+  {
+    writePosition(node);
+    write(node.lhs);
+    write(node.op);
+    write(node.rhs);
+  }
+
+  void write(const ast::UnaryOp& node)
+  {
+    writePosition(node);
+    write(node.op);
+    write(node.operand);
+  }
+
+  void write(const ast::Reference& node)
+  {
+    writePosition(node);
+    write(node.operand);
+  }
+
+  void write(const ast::New& node)
+  {
+    writePosition(node);
+    write(node.type);
+    write(node.with_init);
+    write(node.initializer);
+  }
+
+  void write(const ast::Delete& node)
+  {
+    writePosition(node);
+    write(node.operand);
+  }
+
+  void write(const ast::Dereference& node)
+  {
+    writePosition(node);
+    write(node.operand);
+  }
+
+  void write(const ast::MemberAccess& node)
+  {
+    writePosition(node);
+    write(node.lhs);
+    write(node.rhs);
+  }
+
+  void write(const ast::Subscript& node)
+  {
+    writePosition(node);
+    write(node.lhs);
+    write(node.subscript);
+  }
+
+  void write(const ast::FunctionCall& node)
+  {
+    writePosition(node);
+    write(node.callee);
+    write(node.args);
+  }
+
+  void write(const ast::FunctionTemplateCall& node)
+  {
+    writePosition(node);
+    write(node.callee);
+    write(node.template_args);
+    write(node.args);
+  }
+
+  void write(const ast::Cast& node)
+  {
+    writePosition(node);
+    write(node.lhs);
+    write(node.as);
+  }
+
+  void write(const ast::Pipeline& node)
+  {
+    writePosition(node);
+    write(node.lhs);
+    write(node.op);
+    write(node.rhs);
+  }
+
+  void write(const ast::ArrayLiteral& node)
+  {
+    writePosition(node);
+    write(node.elements);
+  }
+
+  void write(const ast::ClassLiteral& node)
+  {
+    writePosition(node);
+    write(node.type);
+    write(node.initializer_list);
+  }
+
+  void write(const ast::ScopeResolution& node)
+  {
+    writePosition(node);
+    write(node.lhs);
+    write(node.rhs);
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Statement AST
+  //===--------------------------------------------------------------------===//
+
+  void write(const ast::Return& node)
+  {
+    writePosition(node);
+    write(node.rhs);
+  }
+
+  void write(const ast::VariableDef& node)
+  {
+    writePosition(node);
+    write(node.qualifier);
+    write(node.name);
+    write(node.type);
+    write(node.initializer);
+  }
+
+  void write(const ast::Assignment& node)
+  {
+    writePosition(node);
+    write(node.lhs);
+    write(node.op);
+    write(node.rhs);
+  }
+
+  void write(const ast::PrefixIncrementDecrement& node)
+  {
+    writePosition(node);
+    write(node.op);
+    write(node.operand);
+  }
+
+  void write(const ast::Break& node)
+  {
+    writePosition(node);
+  }
+
+  void write(const ast::Continue& node)
+  {
+    writePosition(node);
+  }
+
+  void write(const ast::If& node)
+  {
+    writePosition(node);
+    write(node.condition);
+    write(node.then_statement);
+    write(node.else_statement);
+  }
+
+  void write(const ast::Loop& node)
+  {
+    writePosition(node);
+    write(node.body);
+  }
+
+  void write(const ast::While& node)
+  {
+    writePosition(node);
+    write(node.cond_expr);
+    write(node.body);
+  }
+
+  void write(const ast::For& node)
+  {
+    writePosition(node);
+    write(node.init_stmt);
+    write(node.cond_expr);
+    write(node.loop_stmt);
+    write(node.body);
+  }
+
+  void write(const ast::MatchCase& node)
+  {
+    writePosition(node);
+    write(node.match_case);
+    write(node.statement);
+  }
+
+  void write(const ast::Match& node)
+  {
+    writePosition(node);
+    write(node.target);
+    write(node.cases);
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Top level AST
+  //===--------------------------------------------------------------------===//
+
+  void write(const ast::Parameter& node)
+  {
+    writePosition(node);
+    write(node.name);
+
+    // Sorted so that the same source code always gives the same file
+    std::vector<VariableQual> qualifier{node.qualifier.begin(),
+                                        node.qualifier.end()};
+    std::sort(qualifier.begin(), qualifier.end());
+    write(qualifier);
+
+    write(node.type);
+    write(node.is_vararg);
+  }
+
+  void write(const ast::ParameterList& node)
+  {
+    writePosition(node);
+    write(node.params);
+  }
+
+  void write(const ast::FunctionDecl& node)
+  {
+    writePosition(node);
+    write(node.name);
+    write(node.template_params);
+    write(node.params);
+    write(node.return_type);
+    write(node.accessibility);
+    write(node.is_constructor);
+    write(node.is_destructor);
+  }
+
+  void write(const ast::FunctionDef& node)
+  {
+    writePosition(node);
+    write(node.is_public);
+    write(node.decl);
+    write(node.body);
+  }
+
+  void write(const ast::VariableDefWithoutInit& node)
+  {
+    writePosition(node);
+    write(node.qualifier);
+    write(node.name);
+    write(node.type);
+  }
+
+  void write(const ast::MemberInitializer& node)
+  {
+    writePosition(node);
+    write(node.member_name);
+    write(node.initializer);
+  }
+
+  void write(const ast::MemberInitializerList& node)
+  {
+    writePosition(node);
+    write(node.initializers);
+  }
+
+  void write(const ast::Constructor& node)
+  {
+    writePosition(node);
+    write(node.decl);
+    write(node.member_initializers);
+    write(node.body);
+  }
+
+  void write(const ast::Destructor& node)
+  {
+    writePosition(node);
+    write(node.decl);
+    write(node.body);
+  }
+
+  void write(const ast::ClassDef& node)
+  {
+    writePosition(node);
+    write(node.is_public);
+    write(node.name);
+    write(node.template_params);
+    write(node.members);
+  }
+
+  void write(const ast::ClassDecl& node)
+  {
+    writePosition(node);
+    write(node.name);
+  }
+
+  void write(const ast::UnionTag& node)
+  {
+    writePosition(node);
+    write(node.tag_name);
+    write(node.type);
+  }
+
+  void write(const ast::UnionDef& node)
+  {
+    writePosition(node);
+    write(node.is_public);
+    write(node.name);
+    write(node.template_params);
+    write(node.type_list);
+  }
+
+  void write(const ast::Typedef& node)
+  {
+    writePosition(node);
+    write(node.alias);
+    write(node.type);
+  }
+
+  void write(const ast::Path& node)
+  {
+    writePosition(node);
+    write(node.path);
+  }
+
+  void write(const ast::Import& node)
+  {
+    writePosition(node);
+    write(node.path);
+  }
+
+  void write(const ast::Namespace& node)
+  {
+    writePosition(node);
+    write(node.name);
+    write(node.top_levels);
+  }
+
+  void write(const ast::TopLevelWithAttr& node)
+  {
+    writePosition(node);
+    write(node.attrs);
+    write(node.top_level);
+  }
+
+  std::string buffer;
+
+private:
+  const PositionTable& positions;
+};
+
+//===----------------------------------------------------------------------===//
+// Reader
+//===----------------------------------------------------------------------===//
+
+// Throws MalformedInterface if the data is malformed
+struct Reader {
+  Reader(const std::string_view data, const SourceFile& source)
+    : data{data}
+    , source{source.text()}
+    , positions{source}
+  {
+  }
+
+  [[nodiscard]] std::uint64_t readInt()
+  {
+    std::uint64_t value{};
+
+    for (unsigned int shift = 0;; shift += 7) {
+      if (data.empty() || shift >= 64)
+        throw MalformedInterface{};
+
+      const auto byte = static_cast<unsigned char>(data.front());
+      data.remove_prefix(1);
+
+      value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+
+      if (!(byte & 0x80))
+        return value;
+    }
+  }
+
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return data.empty();
+  }
+
+  [[nodiscard]] PositionTable&& takePositions() noexcept
+  {
+    return std::move(positions);
+  }
+
+  template <typename T>
+  [[nodiscard]] T read()
+  {
+    return read(Tag<T>{});
+  }
+
+  [[nodiscard]] std::u32string read(Tag<std::u32string>)
+  {
+    std::u32string str(readSize(), U'\0');
+
+    for (auto& ch : str)
+      ch = static_cast<char32_t>(readInt());
+
+    return str;
+  }
+
+  [[nodiscard]] bool read(Tag<bool>)
+  {
+    return readInt() != 0;
+  }
+
+  template <typename T>
+    requires std::is_enum_v<T>
+  [[nodiscard]] T read(Tag<T>)
+  {
+    return static_cast<T>(readInt());
+  }
+
+  template <typename T>
+  [[nodiscard]] std::optional<T> read(Tag<std::optional<T>>)
+  {
+    if (read<bool>())
+      return read<T>();
+
+    return std::nullopt;
+  }
+
+  template <typename T>
+  [[nodiscard]] std::vector<T> read(Tag<std::vector<T>>)
+  {
+    std::vector<T> range;
+
+    for (auto size = readSize(); size; --size)
+      range.push_back(read<T>());
+
+    return range;
+  }
+
+  template <typename T>
+  [[nodiscard]] std::deque<T> read(Tag<std::deque<T>>)
+  {
+    std::deque<T> range;
+
+    for (auto size = readSize(); size; --size)
+      range.push_back(read<T>());
+
+    return range;
+  }
+
+  template <typename... Ts>
+  [[nodiscard]] boost::variant<Ts...> read(Tag<boost::variant<Ts...>>)
+  {
+    return readVariant<boost::variant<Ts...>>(readInt());
+  }
+
+  [[nodiscard]] boost::blank read(Tag<boost::blank>)
+  {
+    return {};
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Common AST
+  //===--------------------------------------------------------------------===//
+
+  [[nodiscard]] ast::Identifier read(Tag<ast::Identifier>)
+  {
+    const auto pos = readPosition();
+
+    ast::Identifier node{read<std::u32string>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::TemplateParameters read(Tag<ast::TemplateParameters>)
+  {
+    const auto pos = readPosition();
+
+    ast::TemplateParameters node;
+    node.type_names = read<ast::TemplateParameters::TypeNames>();
+    annotate(node, pos);
+    return node;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Type AST
+  //===--------------------------------------------------------------------===//
+
+  [[nodiscard]] ast::BuiltinType read(Tag<ast::BuiltinType>)
+  {
+    const auto pos = readPosition();
+
+    ast::BuiltinType node{read<codegen::BuiltinTypeKind>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::UserDefinedType read(Tag<ast::UserDefinedType>)
+  {
+    const auto pos = readPosition();
+
+    ast::UserDefinedType node{read<ast::Identifier>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::TemplateArguments read(Tag<ast::TemplateArguments>)
+  {
+    const auto pos = readPosition();
+
+    ast::TemplateArguments node;
+    node.types = read<ast::TemplateArguments::Types>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::UserDefinedTemplateType
+    read(Tag<ast::UserDefinedTemplateType>)
+  {
+    const auto pos = readPosition();
+
+    auto template_type = read<ast::UserDefinedType>();
+    auto template_args = read<ast::TemplateArguments>();
+
+    ast::UserDefinedTemplateType node{std::move(template_type),
+                                      std::move(template_args)};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::ArrayType read(Tag<ast::ArrayType>)
+  {
+    const auto pos = readPosition();
+
+    auto element_type = read<ast::Type>();
+
+    ast::ArrayType node{std::move(element_type), readInt()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::PointerType read(Tag<ast::PointerType>)
+  {
+    const auto pos = readPosition();
+
+    std::vector<boost::blank> n_ops(readSize());
+
+    ast::PointerType node{std::move(n_ops), read<ast::Type>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::ReferenceType read(Tag<ast::ReferenceType>)
+  {
+    const auto pos = readPosition();
+
+    ast::ReferenceType node{read<ast::Type>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Expression AST
+  //===--------------------------------------------------------------------===//
+
+  [[nodiscard]] double read(Tag<double>)
+  {
+    return std::bit_cast<double>(readInt());
+  }
+
+  template <typename T>
+    requires std::is_integral_v<T>
+  [[nodiscard]] T read(Tag<T>)
+  {
+    return static_cast<T>(readInt());
+  }
+
+  [[nodiscard]] ast::Value read(Tag<ast::Value>)
+  {
+    // Never written
+    throw MalformedInterface{};
+  }
+
+  [[nodiscard]] ast::NullPointer read(Tag<ast::NullPointer>)
+  {
+    const auto pos = readPosition();
+
+    ast::NullPointer node;
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::StringLiteral read(Tag<ast::StringLiteral>)
+  {
+    const auto pos = readPosition();
+
+    ast::StringLiteral node;
+    node.str = read<std::u32string>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::CharLiteral read(Tag<ast::CharLiteral>)
+  {
+    const auto pos = readPosition();
+
+    ast::CharLiteral node;
+    node.ch = static_cast<unicode::Codepoint>(readInt());
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::BuiltinMacro read(Tag<ast::BuiltinMacro>)
+  {
+    const auto pos = readPosition();
+
+    ast::BuiltinMacro node;
+    node.kind = read<codegen::BuiltinMacroKind>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::SizeOfType read(Tag<ast::SizeOfType>)
+  {
+    const auto pos = readPosition();
+
+    ast::SizeOfType node;
+    node.type = read<ast::Type>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::BinOp read(Tag<ast::BinOp>)
+  {
+    const auto pos = readPosition();
+
+    auto lhs = read<ast::Expr>();
+    auto op  = read<std::u32string>();
+
+    ast::BinOp node{std::move(lhs), std::move(op), read<ast::Expr>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::UnaryOp read(Tag<ast::UnaryOp>)
+  {
+    const auto pos = readPosition();
+
+    auto op = read<std::u32string>();
+
+    ast::UnaryOp node{std::move(op), read<ast::Expr>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Reference read(Tag<ast::Reference>)
+  {
+    const auto pos = readPosition();
+
+    ast::Reference node;
+    node.operand = read<ast::Expr>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::New read(Tag<ast::New>)
+  {
+    const auto pos = readPosition();
+
+    ast::New node;
+    node.type        = read<ast::Type>();
+    node.with_init   = read<bool>();
+    node.initializer = read<std::vector<ast::Expr>>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Delete read(Tag<ast::Delete>)
+  {
+    const auto pos = readPosition();
+
+    ast::Delete node;
+    node.operand = read<ast::Expr>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Dereference read(Tag<ast::Dereference>)
+  {
+    const auto pos = readPosition();
+
+    ast::Dereference node{read<ast::Expr>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::MemberAccess read(Tag<ast::MemberAccess>)
+  {
+    const auto pos = readPosition();
+
+    auto lhs = read<ast::Expr>();
+
+    ast::MemberAccess node{std::move(lhs), read<ast::Expr>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Subscript read(Tag<ast::Subscript>)
+  {
+    const auto pos = readPosition();
+
+    auto lhs = read<ast::Expr>();
+
+    ast::Subscript node{std::move(lhs), read<ast::Expr>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::FunctionCall read(Tag<ast::FunctionCall>)
+  {
+    const auto pos = readPosition();
+
+    auto callee = read<ast::Expr>();
+
+    ast::FunctionCall node{std::move(callee), read<std::deque<ast::Expr>>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::FunctionTemplateCall read(Tag<ast::FunctionTemplateCall>)
+  {
+    const auto pos = readPosition();
+
+    auto callee        = read<ast::Expr>();
+    auto template_args = read<ast::TemplateArguments>();
+
+    ast::FunctionTemplateCall node{std::move(callee),
+                                   std::move(template_args),
+                                   read<std::deque<ast::Expr>>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Cast read(Tag<ast::Cast>)
+  {
+    const auto pos = readPosition();
+
+    auto lhs = read<ast::Expr>();
+
+    ast::Cast node{std::move(lhs), read<ast::Type>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Pipeline read(Tag<ast::Pipeline>)
+  {
+    const auto pos = readPosition();
+
+    auto lhs = read<ast::Expr>();
+    auto op  = read<std::u32string>();
+
+    ast::Pipeline node{std::move(lhs), std::move(op), read<ast::Expr>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::ArrayLiteral read(Tag<ast::ArrayLiteral>)
+  {
+    const auto pos = readPosition();
+
+    ast::ArrayLiteral node;
+    node.elements = read<std::vector<ast::Expr>>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::ClassLiteral read(Tag<ast::ClassLiteral>)
+  {
+    const auto pos = readPosition();
+
+    ast::ClassLiteral node;
+    node.type             = read<ast::Type>();
+    node.initializer_list = read<std::vector<ast::Expr>>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::ScopeResolution read(Tag<ast::ScopeResolution>)
+  {
+    const auto pos = readPosition();
+
+    auto lhs = read<ast::Expr>();
+
+    ast::ScopeResolution node{std::move(lhs), read<ast::Expr>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Statement AST
+  //===--------------------------------------------------------------------===//
+
+  [[nodiscard]] ast::Return read(Tag<ast::Return>)
+  {
+    const auto pos = readPosition();
+
+    ast::Return node;
+    node.rhs = read<std::optional<ast::Expr>>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::VariableDef read(Tag<ast::VariableDef>)
+  {
+    const auto pos = readPosition();
+
+    ast::VariableDef node;
+    node.qualifier   = read<std::optional<VariableQual>>();
+    node.name        = read<ast::Identifier>();
+    node.type        = read<std::optional<ast::Type>>();
+    node.initializer = read<std::optional<ast::Expr>>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Assignment read(Tag<ast::Assignment>)
+  {
+    return readAssignment<ast::Assignment>();
+  }
+
+  [[nodiscard]] ast::ClassMemberInit read(Tag<ast::ClassMemberInit>)
+  {
+    return readAssignment<ast::ClassMemberInit>();
+  }
+
+  [[nodiscard]] ast::PrefixIncrementDecrement
+    read(Tag<ast::PrefixIncrementDecrement>)
+  {
+    const auto pos = readPosition();
+
+    ast::PrefixIncrementDecrement node;
+    node.op      = read<std::u32string>();
+    node.operand = read<ast::Expr>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Break read(Tag<ast::Break>)
+  {
+    const auto pos = readPosition();
+
+    ast::Break node;
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Continue read(Tag<ast::Continue>)
+  {
+    const auto pos = readPosition();
+
+    ast::Continue node;
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::If read(Tag<ast::If>)
+  {
+    const auto pos = readPosition();
+
+    ast::If node;
+    node.condition      = read<ast::Expr>();
+    node.then_statement = read<ast::Stmt>();
+    node.else_statement = read<std::optional<ast::Stmt>>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Loop read(Tag<ast::Loop>)
+  {
+    const auto pos = readPosition();
+
+    ast::Loop node;
+    node.body = read<ast::Stmt>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::While read(Tag<ast::While>)
+  {
+    const auto pos = readPosition();
+
+    ast::While node;
+    node.cond_expr = read<ast::Expr>();
+    node.body      = read<ast::Stmt>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::For read(Tag<ast::For>)
+  {
+    const auto pos = readPosition();
+
+    ast::For node;
+    node.init_stmt = read<std::optional<ast::ForInitVariant>>();
+    node.cond_expr = read<std::optional<ast::Expr>>();
+    node.loop_stmt = read<std::optional<ast::ForLoopVariant>>();
+    node.body      = read<ast::Stmt>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::MatchCase read(Tag<ast::MatchCase>)
+  {
+    const auto pos = readPosition();
+
+    ast::MatchCase node;
+    node.match_case = read<ast::Expr>();
+    node.statement  = read<ast::Stmt>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Match read(Tag<ast::Match>)
+  {
+    const auto pos = readPosition();
+
+    ast::Match node;
+    node.target = read<ast::Expr>();
+    node.cases  = read<ast::MatchCaseList>();
+    annotate(node, pos);
+    return node;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Top level AST
+  //===--------------------------------------------------------------------===//
+
+  [[nodiscard]] ast::Parameter read(Tag<ast::Parameter>)
+  {
+    const auto pos = readPosition();
+
+    auto name = read<ast::Identifier>();
+
+    std::unordered_set<VariableQual> qualifier;
+    for (const auto r : read<std::vector<VariableQual>>())
+      qualifier.insert(r);
+
+    auto type = read<ast::Type>();
+
+    ast::Parameter node{std::move(name),
+                        std::move(qualifier),
+                        std::move(type),
+                        read<bool>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::ParameterList read(Tag<ast::ParameterList>)
+  {
+    const auto pos = readPosition();
+
+    ast::ParameterList node;
+    node.params = read<std::deque<ast::Parameter>>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::FunctionDecl read(Tag<ast::FunctionDecl>)
+  {
+    const auto pos = readPosition();
+
+    ast::FunctionDecl node;
+    node.name            = read<ast::Identifier>();
+    node.template_params = read<ast::TemplateParameters>();
+    node.params          = read<ast::ParameterList>();
+    node.return_type     = read<ast::Type>();
+    node.accessibility   = read<Accessibility>();
+    node.is_constructor  = read<bool>();
+    node.is_destructor   = read<bool>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::FunctionDef read(Tag<ast::FunctionDef>)
+  {
+    const auto pos = readPosition();
+
+    const auto is_public = read<bool>();
+
+    auto decl = read<ast::FunctionDecl>();
+
+    ast::FunctionDef node{is_public, std::move(decl), read<ast::Stmt>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::VariableDefWithoutInit
+    read(Tag<ast::VariableDefWithoutInit>)
+  {
+    const auto pos = readPosition();
+
+    auto qualifier = read<std::optional<VariableQual>>();
+    auto name      = read<ast::Identifier>();
+
+    ast::VariableDefWithoutInit node{std::move(qualifier),
+                                     std::move(name),
+                                     read<ast::Type>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::MemberInitializer read(Tag<ast::MemberInitializer>)
+  {
+    const auto pos = readPosition();
+
+    ast::MemberInitializer node;
+    node.member_name = read<ast::Identifier>();
+    node.initializer = read<ast::Expr>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::MemberInitializerList
+    read(Tag<ast::MemberInitializerList>)
+  {
+    const auto pos = readPosition();
+
+    ast::MemberInitializerList node;
+    node.initializers = read<std::vector<ast::MemberInitializer>>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Constructor read(Tag<ast::Constructor>)
+  {
+    const auto pos = readPosition();
+
+    ast::Constructor node;
+    node.decl                = read<ast::FunctionDecl>();
+    node.member_initializers = read<ast::MemberInitializerList>();
+    node.body                = read<ast::Stmt>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Destructor read(Tag<ast::Destructor>)
+  {
+    const auto pos = readPosition();
+
+    ast::Destructor node;
+    node.decl = read<ast::FunctionDecl>();
+    node.body = read<ast::Stmt>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::ClassDef read(Tag<ast::ClassDef>)
+  {
+    const auto pos = readPosition();
+
+    const auto is_public = read<bool>();
+
+    auto name            = read<ast::Identifier>();
+    auto template_params = read<ast::TemplateParameters>();
+
+    ast::ClassDef node{is_public,
+                       std::move(name),
+                       std::move(template_params),
+                       read<ast::ClassMemberList>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::ClassDecl read(Tag<ast::ClassDecl>)
+  {
+    const auto pos = readPosition();
+
+    ast::ClassDecl node{read<ast::Identifier>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::UnionTag read(Tag<ast::UnionTag>)
+  {
+    const auto pos = readPosition();
+
+    ast::UnionTag node;
+    node.tag_name = read<ast::Identifier>();
+    node.type     = read<ast::Type>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::UnionDef read(Tag<ast::UnionDef>)
+  {
+    const auto pos = readPosition();
+
+    const auto is_public = read<bool>();
+
+    auto name            = read<ast::Identifier>();
+    auto template_params = read<ast::TemplateParameters>();
+
+    ast::UnionDef node{is_public,
+                       std::move(name),
+                       std::move(template_params),
+                       read<ast::UnionTagList>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Typedef read(Tag<ast::Typedef>)
+  {
+    const auto pos = readPosition();
+
+    ast::Typedef node;
+    node.alias = read<ast::Identifier>();
+    node.type  = read<ast::Type>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Path read(Tag<ast::Path>)
+  {
+    const auto pos = readPosition();
+
+    ast::Path node{read<std::u32string>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Import read(Tag<ast::Import>)
+  {
+    const auto pos = readPosition();
+
+    ast::Import node;
+    node.path = read<ast::Path>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::Namespace read(Tag<ast::Namespace>)
+  {
+    const auto pos = readPosition();
+
+    ast::Namespace node;
+    node.name       = read<ast::Identifier>();
+    node.top_levels = read<ast::TopLevelList>();
+    annotate(node, pos);
+    return node;
+  }
+
+  [[nodiscard]] ast::TopLevelWithAttr read(Tag<ast::TopLevelWithAttr>)
+  {
+    const auto pos = readPosition();
+
+    ast::TopLevelWithAttr node;
+    node.attrs     = read<ast::Attrs>();
+    node.top_level = read<ast::TopLevel>();
+    annotate(node, pos);
+    return node;
+  }
+
+private:
+  // Byte offsets of the first and last of a node
+  using Position = std::optional<std::pair<std::uint64_t, std::uint64_t>>;
+
+  [[nodiscard]] std::size_t readSize()
+  {
+    const auto size = readInt();
+
+    // Each element takes at least one byte, so this rejects sizes that would
+    // exhaust memory
+    if (size > data.size())
+      throw MalformedInterface{};
+
+    return static_cast<std::size_t>(size);
+  }
+
+  [[nodiscard]] Position readPosition()
+  {
+    if (!read<bool>())
+      return std::nullopt;
+
+    const auto first = readInt();
+    const auto last  = readInt();
+
+    // The first can be after the last for an empty node, since it is after
+    // the skipped spaces
+    if (first > source.size() || last > source.size())
+      throw MalformedInterface{};
+
+    return std::make_pair(first, last);
+  }
+
+  void annotate(x3::position_tagged& node, const Position& pos)
+  {
+    if (!pos)
+      return;
+
+    positions.annotate(node,
+                       static_cast<std::uint32_t>(pos->first),
+                       static_cast<std::uint32_t>(pos->second));
+  }
+
+  template <typename T>
+  [[nodiscard]] T readAssignment()
+  {
+    const auto pos = readPosition();
+
+    auto lhs = read<ast::Expr>();
+    auto op  = read<std::u32string>();
+
+    T node{std::move(lhs), std::move(op), read<ast::Expr>()};
+    annotate(node, pos);
+    return node;
+  }
+
+  template <typename Variant, std::size_t I = 0>
+  [[nodiscard]] Variant readVariant(const std::uint64_t which)
+  {
+    using Types = typename Variant::types;
+
+    if constexpr (I < boost::mpl::size<Types>::value) {
+      if (which == I) {
+        using T = typename boost::unwrap_recursive<
+          typename boost::mpl::at_c<Types, I>::type>::type;
+
+        return Variant{read<T>()};
+      }
+
+      return readVariant<Variant, I + 1>(which);
+    }
+    else
+      throw MalformedInterface{};
+  }
+
+  std::string_view       data;
+  const std::string_view source;
+
+  PositionTable positions;
+};
+
+//===----------------------------------------------------------------------===//
+// Interface
+//===----------------------------------------------------------------------===//
+
+// Function bodies are not needed, but classes are needed as a whole since
+// class templates are instantiated by the files importing them
+[[nodiscard]] ast::TranslationUnit
+extractInterface(const ast::TranslationUnit& ast)
+{
+  ast::TranslationUnit interface;
+
+  for (const auto& node_with_attr : ast) {
+    const auto& node = node_with_attr.top_level;
+
+    if (const auto func_def = boost::get<ast::FunctionDef>(&node);
+        func_def && func_def->is_public) {
+      auto& r = interface.emplace_back(node_with_attr);
+      boost::get<ast::FunctionDef>(r.top_level).body = boost::blank{};
+      continue;
+    }
+
+    if (const auto class_def = boost::get<ast::ClassDef>(&node);
+        class_def && class_def->is_public) {
+      interface.push_back(node_with_attr);
+      continue;
+    }
+  }
+
+  return interface;
+}
+
+} // namespace
+
+namespace twk::interface
+{
+
+[[nodiscard]] std::optional<std::filesystem::path>
+getInterfacePath(const std::filesystem::path& interface_dir,
+                 const std::filesystem::path& source_file)
+{
+  std::error_code ec;
+  const auto      absolute_path = std::filesystem::absolute(source_file, ec);
+
+  if (ec)
+    return std::nullopt;
+
+  const auto hash = llvm::xxHash64(absolute_path.lexically_normal().string());
+
+  return interface_dir / fmt::format("{:016x}.twki", hash);
+}
+
+[[nodiscard]] std::string
+serializeInterface(const parse::Parser::Result& parse_result)
+{
+  Writer writer{parse_result.positions};
+
+  writer.buffer += MAGIC;
+  writer.writeInt(FORMAT_VERSION);
+  writer.writeInt(getLayoutHash());
+  writer.writeInt(VERSION);
+  writer.writeInt(hashSource(parse_result.source->text()));
+
+  writer.write(extractInterface(parse_result.ast));
+
+  return std::move(writer.buffer);
+}
+
+[[nodiscard]] std::optional<Interface>
+deserializeInterface(std::string_view data, const SourceFile& source)
+{
+  if (!data.starts_with(MAGIC))
+    return std::nullopt;
+
+  data.remove_prefix(MAGIC.size());
+
+  try {
+    Reader reader{data, source};
+
+    if (reader.readInt() != FORMAT_VERSION
+        || reader.readInt() != getLayoutHash() || reader.readInt() != VERSION
+        || reader.readInt() != hashSource(source.text()))
+      return std::nullopt;
+
+    auto ast = reader.read<ast::TranslationUnit>();
+
+    if (!reader.empty())
+      return std::nullopt;
+
+    return Interface{std::move(ast), reader.takePositions()};
+  }
+  catch (const MalformedInterface&) {
+    return std::nullopt;
+  }
+}
+
+[[nodiscard]] Interface
+loadInterface(const std::filesystem::path&                source_file,
+              const std::shared_ptr<const SourceFile>&    source,
+              const std::optional<std::filesystem::path>& interface_dir)
+{
+  const auto interface_path
+    = interface_dir ? getInterfacePath(*interface_dir, source_file)
+                    : std::nullopt;
+
+  if (const auto data = interface_path ? readFile(*interface_path)
+                                       : std::nullopt) {
+    if (auto interface = deserializeInterface(*data, *source))
+      return std::move(*interface);
+  }
+
+  // The parser shares the source code with the caller, so the positions of
+  // the parse result can be used as they are
+  auto parse_result
+    = parse::Parser{std::shared_ptr{source}, source_file}.getResult();
+
+  if (interface_path) {
+    std::error_code ec;
+    std::filesystem::create_directories(interface_path->parent_path(), ec);
+
+    writeFileAtomically(*interface_path, serializeInterface(parse_result));
+  }
+
+  return {extractInterface(parse_result.ast),
+          std::move(parse_result.positions)};
+}
+
+ImportedFile::ImportedFile(
+  std::shared_ptr<const SourceFile>&&         source,
+  const std::filesystem::path&                file,
+  const std::optional<std::filesystem::path>& interface_dir)
+  : source{std::move(source)}
+  , interface{loadInterface(file, this->source, interface_dir)}
+{
+}
+
+[[nodiscard]] std::shared_ptr<const ImportedFile>
+ImportCache::load(
+  const std::filesystem::path&                              file,
+  const std::function<std::shared_ptr<const SourceFile>()>& load_source)
+{
+  std::error_code ec;
+  auto            key = std::filesystem::weakly_canonical(file, ec).string();
+
+  if (ec)
+    key = std::filesystem::absolute(file).lexically_normal().string();
+
+  std::shared_ptr<Entry> entry;
+
+  {
+    const std::lock_guard lock{mutex};
+
+    auto& r = entries[key];
+
+    if (!r)
+      r = std::make_shared<Entry>();
+
+    entry = r;
+  }
+
+  // Other files are loaded in parallel while this file is loaded
+  const std::lock_guard lock{entry->mutex};
+
+  if (!entry->file)
+    entry->file = std::make_shared<const ImportedFile>(load_source(),
+                                                       file,
+                                                       interface_dir);
+
+  return entry->file;
+}
+
+} // namespace twk::interface
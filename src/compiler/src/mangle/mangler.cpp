@@ -274,9 +274,10 @@ Mangler::mangleNamespaceHierarchy(const NamespaceStack& namespaces) const
 [[nodiscard]] std::string
 Mangler::mangleThisPointer(const std::string& class_name) const
 {
-  return PointerType{std::make_shared<UserDefinedType>(class_name, false),
-                     false}
-    .getMangledName(ctx);
+  return ctx.types
+    .getPointerType(ctx.types.getUserDefinedType(intern(class_name), false),
+                    false)
+    ->getMangledName(ctx);
 }
 
 [[nodiscard]] std::string
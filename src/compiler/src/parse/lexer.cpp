@@ -0,0 +1,344 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twk/parse/lexer.hpp>
+#include <twk/unicode/unicode.hpp>
+
+namespace twk::parse
+{
+
+// Sorted to be binary searched
+static constexpr std::array<std::string_view, 47> keywords = {
+  "__builtin_huge_val",
+  "__builtin_huge_valf",
+  "__builtin_infinity",
+  "as",
+  "bool",
+  "break",
+  "char",
+  "class",
+  "continue",
+  "declare",
+  "delete",
+  "else",
+  "f32",
+  "f64",
+  "false",
+  "for",
+  "func",
+  "i16",
+  "i32",
+  "i64",
+  "i8",
+  "if",
+  "import",
+  "isize",
+  "let",
+  "loop",
+  "match",
+  "mut",
+  "namespace",
+  "new",
+  "nullptr",
+  "private",
+  "pub",
+  "public",
+  "ref",
+  "return",
+  "sizeof",
+  "true",
+  "typedef",
+  "u16",
+  "u32",
+  "u64",
+  "u8",
+  "union",
+  "usize",
+  "void",
+  "while",
+};
+
+static_assert(std::ranges::is_sorted(keywords));
+static_assert(keywords.size() < NOT_KEYWORD);
+
+[[nodiscard]] KeywordID findKeyword(const std::string_view word) noexcept
+{
+  const auto iter = std::ranges::lower_bound(keywords, word);
+
+  if (iter == keywords.end() || *iter != word)
+    return NOT_KEYWORD;
+
+  return static_cast<KeywordID>(std::distance(keywords.begin(), iter));
+}
+
+//===----------------------------------------------------------------------===//
+// Character classes
+//===----------------------------------------------------------------------===//
+
+[[nodiscard]] static constexpr bool isSpace(const char ch) noexcept
+{
+  return ch == ' ' || ('\t' <= ch && ch <= '\r');
+}
+
+[[nodiscard]] static constexpr bool isDigit(const char ch) noexcept
+{
+  return '0' <= ch && ch <= '9';
+}
+
+[[nodiscard]] static constexpr bool isAsciiWordChar(const char ch) noexcept
+{
+  return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || isDigit(ch)
+         || ch == '_';
+}
+
+// Punctuations that the grammar uses
+// Others such as $ and @ can never be parsed, so they are reported by the lexer
+[[nodiscard]] static constexpr bool isPunct(const char ch) noexcept
+{
+  return std::string_view{"!%&()*+,-./:;<=>[]^{|}~"}.find(ch)
+         != std::string_view::npos;
+}
+
+// Non-ASCII characters in words, which are graphic characters other than
+// punctuations
+[[nodiscard]] static bool isUnicodeWordChar(const char32_t ch) noexcept
+{
+  namespace encoding = boost::spirit::char_encoding;
+
+  return encoding::unicode::isgraph(ch) && !encoding::unicode::ispunct(ch);
+}
+
+// Decode a non-ASCII character of valid UTF-8
+// Returns the codepoint and its length
+[[nodiscard]] static std::pair<char32_t, std::size_t>
+decodeUtf8(const char* first) noexcept
+{
+  const auto lead = static_cast<unsigned char>(*first);
+
+  const std::size_t length = lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+
+  char32_t ch = lead & (0x7F >> length);
+
+  for (std::size_t i = 1; i < length; ++i)
+    ch = (ch << 6) | (static_cast<unsigned char>(first[i]) & 0x3F);
+
+  return {ch, length};
+}
+
+//===----------------------------------------------------------------------===//
+// Lexer
+//===----------------------------------------------------------------------===//
+
+struct Lexer {
+  explicit Lexer(const std::string_view source) noexcept
+    : source{source}
+    , iter{source.data()}
+    , last{source.data() + source.size()}
+  {
+  }
+
+  [[nodiscard]] std::vector<Token> tokenize()
+  {
+    // Characters are decoded without checking, since the source code is
+    // validated once here
+    if (const auto offset = unicode::findInvalidUtf8(source))
+      throw error(source.data() + *offset, "invalid UTF-8 sequence");
+
+    // Tokens are a few times fewer than characters
+    tokens.reserve(source.size() / 4 + 1);
+
+    while (skipSpacesAndComments(), iter != last) {
+      const auto first = iter;
+
+      if (isDigit(*first) || (*first == '.' && isNumberAfterDot()))
+        lexNumber();
+      else if (isAsciiWordChar(*first))
+        lexWord();
+      else if (*first == '"')
+        lexQuoted('"', TokenKind::string_literal, "string literal");
+      else if (*first == '\'')
+        lexQuoted('\'', TokenKind::char_literal, "character literal");
+      else if (isPunct(*first)) {
+        ++iter;
+        push(first, TokenKind::punct, NOT_KEYWORD, *first);
+      }
+      else if (static_cast<unsigned char>(*first) >= 0x80)
+        lexWord();
+      else
+        throw error(first, "invalid character");
+    }
+
+    push(iter, TokenKind::eoi);
+
+    return std::move(tokens);
+  }
+
+private:
+  void skipSpacesAndComments()
+  {
+    while (iter != last) {
+      if (isSpace(*iter))
+        ++iter;
+      else if (startsWith("//"))
+        iter = std::find(iter, last, '\n');
+      else if (startsWith("/*"))
+        skipBlockComment();
+      else
+        break;
+    }
+  }
+
+  // Block comments can be nested
+  void skipBlockComment()
+  {
+    const auto first = iter;
+
+    std::size_t depth = 0;
+
+    do {
+      if (startsWith("/*")) {
+        ++depth;
+        iter += 2;
+      }
+      else if (startsWith("*/")) {
+        --depth;
+        iter += 2;
+      }
+      else if (iter == last)
+        throw error(first, "unterminated block comment");
+      else
+        ++iter;
+    } while (depth);
+  }
+
+  void lexWord()
+  {
+    const auto first = iter;
+
+    for (;;) {
+      if (iter == last)
+        break;
+      else if (isAsciiWordChar(*iter))
+        ++iter;
+      else if (static_cast<unsigned char>(*iter) < 0x80
+               || !consumeUnicodeWordChar())
+        break;
+    }
+
+    if (iter == first)
+      throw error(first, "invalid character");
+
+    push(first,
+         TokenKind::word,
+         findKeyword({first, static_cast<std::size_t>(iter - first)}));
+  }
+
+  // Consume the non-ASCII character if it can be part of a word
+  [[nodiscard]] bool consumeUnicodeWordChar()
+  {
+    const auto [ch, length] = decodeUtf8(iter);
+
+    if (!isUnicodeWordChar(ch))
+      return false;
+
+    iter += length;
+    return true;
+  }
+
+  // Floating points can start with a dot, and no other token starts with a dot
+  // followed by a digit
+  [[nodiscard]] bool isNumberAfterDot() const noexcept
+  {
+    return std::next(iter) != last && isDigit(iter[1]);
+  }
+
+  // The value of a number is parsed by the grammar, so the lexer only finds
+  // its end
+  // Signs are part of the number only in the exponent of a floating point
+  void lexNumber()
+  {
+    const auto first = iter;
+
+    const auto has_exponent = !startsWith("0x") && !startsWith("0b");
+
+    while (iter != last) {
+      if (isAsciiWordChar(*iter) || *iter == '.')
+        ++iter;
+      else if ((*iter == '+' || *iter == '-') && has_exponent
+               && (iter[-1] == 'e' || iter[-1] == 'E'))
+        ++iter;
+      else
+        break;
+    }
+
+    push(first, TokenKind::number);
+  }
+
+  // The escape sequences are parsed by the grammar, so the lexer only skips
+  // the escaped characters
+  void lexQuoted(const char quote, const TokenKind kind, const char* what)
+  {
+    const auto first = iter++;
+
+    for (;;) {
+      if (iter == last || *iter == '\n' || *iter == '\r')
+        throw error(first, fmt::format("unterminated {}", what));
+      else if (*iter == quote)
+        break;
+      else if (*iter == '\\' && std::next(iter) != last)
+        iter += 2;
+      else
+        ++iter;
+    }
+
+    ++iter;
+    push(first, kind);
+  }
+
+  void push(const char*     first,
+            const TokenKind kind,
+            const KeywordID keyword = NOT_KEYWORD,
+            const char      punct   = '\0')
+  {
+    const auto first_offset = offsetOf(first);
+
+    if (!tokens.empty())
+      tokens.back().joined = tokens.back().last == first_offset;
+
+    tokens.push_back({first_offset, offsetOf(iter), kind, keyword, punct});
+  }
+
+  [[nodiscard]] bool startsWith(const std::string_view str) const noexcept
+  {
+    return static_cast<std::size_t>(last - iter) >= str.size()
+           && std::equal(str.begin(), str.end(), iter);
+  }
+
+  [[nodiscard]] std::uint32_t offsetOf(const char* pos) const noexcept
+  {
+    return static_cast<std::uint32_t>(pos - source.data());
+  }
+
+  [[nodiscard]] LexError error(const char* pos, const std::string& what) const
+  {
+    return LexError{what, offsetOf(pos)};
+  }
+
+  const std::string_view source;
+
+  const char*       iter;
+  const char* const last;
+
+  std::vector<Token> tokens;
+};
+
+[[nodiscard]] std::vector<Token> tokenize(const std::string_view source)
+{
+  return Lexer{source}.tokenize();
+}
+
+} // namespace twk::parse
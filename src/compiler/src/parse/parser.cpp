@@ -11,10 +11,353 @@
 #include <twk/codegen/type.hpp>
 #include <twk/codegen/kind.hpp>
 #include <twk/parse/exception.hpp>
+#include <twk/parse/lexer.hpp>
+#include <twk/support/typedef.hpp>
+#include <twk/support/parallel.hpp>
+#include <twk/unicode/unicode.hpp>
+#include <boost/iterator/iterator_adaptor.hpp>
+#include <deque>
+#include <sstream>
 
 namespace x3     = boost::spirit::x3;
 namespace fusion = boost::fusion;
 
+//===----------------------------------------------------------------------===//
+// Token parsers
+//===----------------------------------------------------------------------===//
+
+namespace twk::parse::syntax
+{
+
+// Tag used to get the source code from the context.
+struct SourceTag;
+
+template <typename Context>
+[[nodiscard]] std::string_view textOf(const Token& token, const Context& ctx)
+{
+  return x3::get<SourceTag>(ctx).substr(token.first, token.last - token.first);
+}
+
+// Keyword or punctuation, whose attribute is the text if Attribute is
+// std::u32string
+// A punctuation of several characters matches punctuation tokens without
+// spaces between them, so that >> also closes two template argument lists
+template <typename Attribute>
+struct TokenLiteral : x3::parser<TokenLiteral<Attribute>> {
+  using attribute_type = Attribute;
+
+  static constexpr bool has_attribute
+    = !std::is_same_v<Attribute, x3::unused_type>;
+
+  explicit TokenLiteral(const std::u32string_view str)
+    : str{str}
+    , keyword{findKeyword(unicode::utf32toUtf8(str))}
+  {
+    assert(keyword != NOT_KEYWORD || !std::isalpha(static_cast<int>(str[0])));
+  }
+
+  template <typename Iterator,
+            typename Context,
+            typename RContext,
+            typename Attr>
+  bool parse(Iterator&       first,
+             const Iterator& last,
+             const Context&,
+             RContext&,
+             Attr& attr) const
+  {
+    auto iter = first;
+
+    if (keyword != NOT_KEYWORD) {
+      if (iter == last || iter->kind != TokenKind::word
+          || iter->keyword != keyword)
+        return false;
+
+      ++iter;
+    }
+    else {
+      for (const auto ch : str) {
+        if (iter == last || iter->kind != TokenKind::punct
+            || iter->punct != static_cast<char>(ch)
+            || (iter != first && !std::prev(iter)->joined))
+          return false;
+
+        ++iter;
+      }
+    }
+
+    if constexpr (has_attribute)
+      x3::traits::move_to(std::u32string{str}, attr);
+
+    first = iter;
+    return true;
+  }
+
+  const std::u32string_view str;
+
+  const KeywordID keyword;
+};
+
+[[nodiscard]] inline auto lit(const char32_t* str)
+{
+  return TokenLiteral<x3::unused_type>{str};
+}
+
+[[nodiscard]] inline auto string(const char32_t* str)
+{
+  return TokenLiteral<std::u32string>{str};
+}
+
+// Identifier or keyword, whose attribute is the text in UTF-32, or the
+// identifier interned without decoding the text
+template <typename Attribute>
+struct WordParser : x3::parser<WordParser<Attribute>> {
+  using attribute_type = Attribute;
+
+  static constexpr bool has_attribute = true;
+
+  template <typename Iterator,
+            typename Context,
+            typename RContext,
+            typename Attr>
+  bool parse(Iterator&       first,
+             const Iterator& last,
+             const Context&  ctx,
+             RContext&,
+             Attr& attr) const
+  {
+    if (first == last || first->kind != TokenKind::word)
+      return false;
+
+    if constexpr (std::is_same_v<Attribute, ast::Identifier>)
+      x3::traits::move_to(ast::Identifier{textOf(*first, ctx)}, attr);
+    else
+      x3::traits::move_to(unicode::utf8toUtf32(textOf(*first, ctx)), attr);
+
+    ++first;
+    return true;
+  }
+};
+
+const WordParser<std::u32string>  word{};
+const WordParser<ast::Identifier> identifier_word{};
+
+// Symbol table whose keys are keywords, so that a word is looked up by its
+// keyword ID
+template <typename T>
+struct KeywordSymbols : x3::parser<KeywordSymbols<T>> {
+  using attribute_type = T;
+
+  static constexpr bool has_attribute = true;
+
+  KeywordSymbols& add(const std::u32string_view key, const T& value)
+  {
+    const auto keyword = findKeyword(unicode::utf32toUtf8(key));
+
+    assert(keyword != NOT_KEYWORD);
+    values[keyword] = value;
+
+    return *this;
+  }
+
+  KeywordSymbols& operator()(const std::u32string_view key, const T& value)
+  {
+    return add(key, value);
+  }
+
+  template <typename Iterator,
+            typename Context,
+            typename RContext,
+            typename Attr>
+  bool parse(Iterator&       first,
+             const Iterator& last,
+             const Context&,
+             RContext&,
+             Attr& attr) const
+  {
+    if (first == last || first->kind != TokenKind::word
+        || first->keyword == NOT_KEYWORD || !values[first->keyword])
+      return false;
+
+    x3::traits::move_to(*values[first->keyword], attr);
+
+    ++first;
+    return true;
+  }
+
+private:
+  std::array<std::optional<T>, NOT_KEYWORD> values;
+};
+
+// Iterates ASCII text as codepoints without decoding
+struct AsciiIterator
+  : boost::iterator_adaptor<AsciiIterator,
+                            const char*,
+                            char32_t,
+                            boost::random_access_traversal_tag,
+                            char32_t> {
+  AsciiIterator() = default;
+
+  explicit AsciiIterator(const char* iter) noexcept
+    : iterator_adaptor_{iter}
+  {
+  }
+
+private:
+  friend class boost::iterator_core_access;
+
+  [[nodiscard]] char32_t dereference() const noexcept
+  {
+    return static_cast<char32_t>(*base());
+  }
+};
+
+// Parses the text of a token of Kind with the characters parser, which must
+// consume the whole text
+// Only text containing non-ASCII characters is decoded
+template <TokenKind Kind, typename Subject>
+struct TokenText : x3::unary_parser<Subject, TokenText<Kind, Subject>> {
+  using base_type = x3::unary_parser<Subject, TokenText<Kind, Subject>>;
+
+  static constexpr bool is_pass_through_unary = true;
+
+  constexpr TokenText(const Subject& subject)
+    : base_type{subject}
+  {
+  }
+
+  template <typename Iterator,
+            typename Context,
+            typename RContext,
+            typename Attr>
+  bool parse(Iterator&       first,
+             const Iterator& last,
+             const Context&  ctx,
+             RContext&,
+             Attr& attr) const
+  {
+    if (first == last || first->kind != Kind)
+      return false;
+
+    const auto text = textOf(*first, ctx);
+
+    bool parsed;
+
+    // Numbers are always ASCII, and are parsed as chars
+    if constexpr (Kind == TokenKind::number)
+      parsed = parseText<const char*>(text, attr);
+    else {
+      parsed = unicode::isAscii(text) ? parseText<AsciiIterator>(text, attr)
+                                      : parseText<InputIterator>(text, attr);
+    }
+
+    if (!parsed)
+      return false;
+
+    ++first;
+    return true;
+  }
+
+private:
+  template <typename CharIterator, typename Attr>
+  bool parseText(const std::string_view text, Attr& attr) const
+  {
+    CharIterator       char_first{text.data()};
+    const CharIterator char_last{text.data() + text.size()};
+
+    return x3::parse(char_first, char_last, this->subject, attr)
+           && char_first == char_last;
+  }
+};
+
+template <TokenKind Kind, typename Subject>
+[[nodiscard]] constexpr auto tokenText(const Subject& subject)
+{
+  return TokenText<Kind, Subject>{subject};
+}
+
+// Results of a parser by the position where it started, and std::nullopt for
+// failures
+template <typename Attribute>
+using MemoTable = std::unordered_map<
+  const Token*,
+  std::optional<std::pair<const Token*, Attribute>>>;
+
+// Parses the subject once at each position, and copies the result when it is
+// tried again at the same position
+// The table is got from the context by ID
+template <typename ID, typename Subject>
+struct Memoize : x3::unary_parser<Subject, Memoize<ID, Subject>> {
+  using base_type = x3::unary_parser<Subject, Memoize<ID, Subject>>;
+
+  static constexpr bool is_pass_through_unary = true;
+
+  constexpr Memoize(const Subject& subject)
+    : base_type{subject}
+  {
+  }
+
+  template <typename Iterator,
+            typename Context,
+            typename RContext,
+            typename Attr>
+  bool parse(Iterator&       first,
+             const Iterator& last,
+             const Context&  ctx,
+             RContext&       rctx,
+             Attr&           attr) const
+  {
+    auto&& table = x3::get<ID>(ctx);
+
+    // References to elements are not invalidated by rehashing, unlike
+    // iterators
+    auto&& [iter, inserted] = table.try_emplace(first);
+    auto&& result           = iter->second;
+
+    if (!inserted) {
+      if (!result)
+        return false;
+
+      first = result->first;
+      x3::traits::move_to(decltype(result->second){result->second}, attr);
+      return true;
+    }
+
+    decltype(result->second) value;
+
+    if (!this->subject.parse(first, last, ctx, rctx, value))
+      return false;
+
+    result.emplace(first, value);
+    x3::traits::move_to(std::move(value), attr);
+    return true;
+  }
+};
+
+template <typename ID, typename Subject>
+[[nodiscard]] constexpr auto memoize(const Subject& subject)
+{
+  return Memoize<ID, Subject>{subject};
+}
+
+} // namespace twk::parse::syntax
+
+namespace boost::spirit::x3
+{
+
+template <typename Attribute>
+struct get_info<twk::parse::syntax::TokenLiteral<Attribute>> {
+  using result_type = std::string;
+
+  [[nodiscard]] std::string
+  operator()(const twk::parse::syntax::TokenLiteral<Attribute>& p) const
+  {
+    return '"' + twk::unicode::utf32toUtf8(p.str) + '"';
+  }
+};
+
+} // namespace boost::spirit::x3
+
 namespace twk::parse
 {
 
@@ -22,6 +365,42 @@ namespace twk::parse
 // Error handling
 //===----------------------------------------------------------------------===//
 
+// Reports errors in the same format as x3::error_handler
+struct ErrorReporter {
+  void operator()(const std::uint32_t offset, const std::string& message) const
+  {
+    const auto line_number = source.lineOf(offset);
+    const auto line        = source.line(line_number);
+
+    err_ostm << "In file " << file << ", line " << line_number << ":\n"
+             << message << '\n'
+             << line << '\n';
+
+    // Each character before the error is indicated, and a tab is 4 characters
+    const auto column = std::min(
+      static_cast<std::size_t>(source.text().data() + offset - line.data()),
+      line.size());
+
+    for (const auto ch : line.substr(0, column)) {
+      if (ch == '\t')
+        err_ostm << "____";
+      else if ((static_cast<unsigned char>(ch) & 0xC0) != 0x80)
+        err_ostm << '_';
+    }
+
+    err_ostm << "^_" << std::endl;
+  }
+
+  const SourceFile& source;
+
+  const std::string file;
+
+  std::ostream& err_ostm;
+};
+
+// Tag used to get the error reporter from the context.
+struct ErrorReporterTag;
+
 struct ErrorHandle {
   template <typename Iterator, typename Context>
   x3::error_handler_result on_error(Iterator&,
@@ -29,10 +408,11 @@ struct ErrorHandle {
                                     const x3::expectation_failure<Iterator>& x,
                                     Context const& context) const
   {
-    auto& error_handler = x3::get<x3::error_handler_tag>(context).get();
+    auto&& error_reporter = x3::get<ErrorReporterTag>(context);
 
-    error_handler(
-      x.where(),
+    // The tokens end with the eoi token, so the position can be dereferenced
+    error_reporter(
+      x.where()->first,
       formatError("expected: " + boost::core::demangle(x.which().c_str())));
 
     return x3::error_handler_result::fail;
@@ -43,8 +423,22 @@ struct ErrorHandle {
 // Annotations
 //===----------------------------------------------------------------------===//
 
-// Tag used to get the position cache from the context.
-struct PositionCacheTag;
+// Tag used to get the position table from the context.
+struct PositionTableTag;
+
+// Annotate the AST with the byte offsets of the tokens
+// An empty node is placed at the beginning of the next token
+template <typename T, typename Context>
+void annotatePosition(T&                  ast,
+                      const Token* const  first,
+                      const Token* const  last,
+                      const Context&      ctx)
+{
+  auto&& position_table = x3::get<PositionTableTag>(ctx);
+  position_table.annotate(ast,
+                          first->first,
+                          first == last ? first->first : std::prev(last)->last);
+}
 
 struct AnnotatePosition {
   template <typename T, typename Iterator, typename Context>
@@ -53,8 +447,23 @@ struct AnnotatePosition {
                   T&              ast,
                   const Context&  ctx)
   {
-    auto&& position_cache = x3::get<PositionCacheTag>(ctx);
-    position_cache.annotate(ast, first, last);
+    annotatePosition(ast, first, last, ctx);
+  }
+};
+
+// Statements starting with an expression are made after the expression, so
+// they are annotated from the beginning of the expression here
+struct AnnotateExprLeadingStmt {
+  template <typename Iterator, typename Context>
+  void on_success(const Iterator& first,
+                  const Iterator& last,
+                  ast::Stmt&      stmt,
+                  const Context&  ctx)
+  {
+    if (const auto match = boost::get<ast::Match>(&stmt))
+      annotatePosition(*match, first, last, ctx);
+    else if (const auto assignment = boost::get<ast::Assignment>(&stmt))
+      annotatePosition(*assignment, first, last, ctx);
   }
 };
 
@@ -139,15 +548,31 @@ private:
   {
     // FIXME: There is a bug that causes the position to be annotated one
     // position further than the actual position.
-    auto&& position_cache = x3::get<PositionCacheTag>(ctx);
-    position_cache.annotate(ast,
-                            x3::_where(ctx).begin(),
-                            x3::_where(ctx).end());
+    annotatePosition(ast, x3::_where(ctx).begin(), x3::_where(ctx).end(), ctx);
 
     x3::_val(ctx) = std::forward<T>(ast);
   }
 };
 
+// Make the statement from the expression parsed as the value
+template <typename T>
+struct makeStmtFromExprAs {
+  template <typename Ctx>
+  void operator()(const Ctx& ctx) const
+  {
+    auto&& expr = boost::get<ast::Expr>(x3::_val(ctx));
+    auto&& attr = x3::_attr(ctx);
+
+    if constexpr (std::is_same_v<T, ast::Match>)
+      x3::_val(ctx) = T{{}, std::move(expr), std::move(attr)};
+    else {
+      x3::_val(ctx) = T{std::move(expr),
+                        std::move(fusion::at_c<0>(attr)),
+                        std::move(fusion::at_c<1>(attr))};
+    }
+  }
+};
+
 } // namespace action
 
 //===----------------------------------------------------------------------===//
@@ -160,22 +585,72 @@ namespace syntax
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Woverloaded-shift-op-parentheses"
 
+// The reason for using x3::rule where a rule is not a recursive rule is to
+// speed up compilation.
+
+//===----------------------------------------------------------------------===//
+// Characters in tokens
+//===----------------------------------------------------------------------===//
+
+namespace chars
+{
+
 using x3::unicode::lit;
 using x3::unicode::char_;
-using x3::unicode::string;
 
 template <typename T>
 using UnicodeSymbols
   = x3::symbols_parser<boost::spirit::char_encoding::unicode, T>;
 
-// The reason for using x3::rule where a rule is not a recursive rule is to
-// speed up compilation.
+struct EscapeCharSymbols : UnicodeSymbols<char32_t> {
+  EscapeCharSymbols()
+  {
+    // clang-format off
+    add
+      (U"\\a", U'\a')
+      (U"\\b", U'\b')
+      (U"\\f", U'\f')
+      (U"\\n", U'\n')
+      (U"\\r", U'\r')
+      (U"\\t", U'\t')
+      (U"\\v", U'\v')
+      (U"\\0", U'\0')
+      (U"\\\\", U'\\')
+      (U"\\\'", U'\'')
+      (U"\\\"", U'\"')
+    ;
+    // clang-format on
+  }
+} escape_char_symbols;
+
+const x3::rule<struct EscapeCharTag, unsigned char> escape_char
+  = "escape character";
+
+const auto escape_char_def
+  = lit(U"\\") >> x3::int_parser<char, 8, 1, 3>{}     // Octal
+    | lit(U"\\x") >> x3::int_parser<char, 16, 2, 2>{} // Hexadecimal
+    | escape_char_symbols;
+
+BOOST_SPIRIT_DEFINE(escape_char)
+
+const auto string_literal
+  = lit(U"\"")
+    >> *(char_ - (lit(U"\"") | x3::eol | lit(U"\\")) | escape_char)
+    >> lit(U"\"");
+
+const auto char_literal
+  = lit(U"'") >> (char_ - (lit(U"'") | x3::eol | lit(U"\\")) | escape_char)
+    >> lit(U"'");
+
+const auto path = lit(U"\"") >> *(char_ - lit(U"\"")) >> lit(U"\"");
+
+} // namespace chars
 
 //===----------------------------------------------------------------------===//
 // Symbol table
 //===----------------------------------------------------------------------===//
 
-struct VariableQualifierSymbols : UnicodeSymbols<VariableQual> {
+struct VariableQualifierSymbols : KeywordSymbols<VariableQual> {
   VariableQualifierSymbols()
   {
     // clang-format off
@@ -186,7 +661,7 @@ struct VariableQualifierSymbols : UnicodeSymbols<VariableQual> {
   }
 } variable_qualifier_symbols;
 
-struct AccessSpecifierSymbols : UnicodeSymbols<Accessibility> {
+struct AccessSpecifierSymbols : KeywordSymbols<Accessibility> {
   AccessSpecifierSymbols()
   {
     // clang-format off
@@ -198,28 +673,7 @@ struct AccessSpecifierSymbols : UnicodeSymbols<Accessibility> {
   }
 } access_specifier_symbols;
 
-struct EscapeCharSymbols : UnicodeSymbols<char32_t> {
-  EscapeCharSymbols()
-  {
-    // clang-format off
-    add
-      (U"\\a", U'\a')
-      (U"\\b", U'\b')
-      (U"\\f", U'\f')
-      (U"\\n", U'\n')
-      (U"\\r", U'\r')
-      (U"\\t", U'\t')
-      (U"\\v", U'\v')
-      (U"\\0", U'\0')
-      (U"\\\\", U'\\')
-      (U"\\\'", U'\'')
-      (U"\\\"", U'\"')
-    ;
-    // clang-format on
-  }
-} escape_char_symbols;
-
-struct BuiltinTypeNameSymbolsTag : UnicodeSymbols<codegen::BuiltinTypeKind> {
+struct BuiltinTypeNameSymbolsTag : KeywordSymbols<codegen::BuiltinTypeKind> {
   BuiltinTypeNameSymbolsTag()
   {
     // clang-format off
@@ -244,7 +698,7 @@ struct BuiltinTypeNameSymbolsTag : UnicodeSymbols<codegen::BuiltinTypeKind> {
   }
 } builtin_type_symbols;
 
-struct BuiltinMacroSymbols : UnicodeSymbols<codegen::BuiltinMacroKind> {
+struct BuiltinMacroSymbols : KeywordSymbols<codegen::BuiltinMacroKind> {
   BuiltinMacroSymbols()
   {
     // clang-format off
@@ -291,7 +745,6 @@ DECLARE_X3_RULE(type_primary, ast::Type, "type primary")
 // Common rules declaration
 //===----------------------------------------------------------------------===//
 
-DECLARE_X3_RULE_NO_ATTR(punct, "punctuation character")
 DECLARE_X3_RULE(identifier_internal, std::u32string, "identifier")
 DECLARE_X3_RULE(identifier, ast::Identifier, "identifier")
 DECLARE_X3_RULE(path_internal, std::u32string, "path")
@@ -307,12 +760,10 @@ DECLARE_X3_RULE(uint_64bit, std::uint64_t, "integral number (64bit)")
 DECLARE_X3_RULE(int_64bit, std::int64_t, "integral number (64bit)")
 DECLARE_X3_RULE(float_64bit, double, "double precision floating point number")
 DECLARE_X3_RULE(boolean_literal, bool, "boolean literal")
-DECLARE_X3_RULE(escape_char, unsigned char, "escape character")
 DECLARE_X3_RULE(string_literal, ast::StringLiteral, "string literal")
 DECLARE_X3_RULE(char_literal, ast::CharLiteral, "character literal")
 DECLARE_X3_RULE(attribute, ast::Attrs, "attribute")
 DECLARE_X3_RULE(builtin_macro, ast::BuiltinMacro, "builtin macro")
-DECLARE_X3_RULE_NO_ATTR(space, "space")
 DECLARE_X3_RULE(array_literal, ast::ArrayLiteral, "array literal")
 DECLARE_X3_RULE(class_literal, ast::ClassLiteral, "class literal")
 DECLARE_X3_RULE(template_args, ast::TemplateArguments, "template arguments")
@@ -361,7 +812,6 @@ DECLARE_X3_RULE(primary, ast::Expr, "primary")
 // Statement rules declaration
 //===----------------------------------------------------------------------===//
 
-DECLARE_X3_RULE(expr_stmt, ast::Expr, "expression statement")
 DECLARE_X3_RULE(variable_def, ast::VariableDef, "variable definition")
 DECLARE_X3_RULE(assignment, ast::Assignment, "assignment statement")
 DECLARE_X3_RULE(prefix_increment_decrement,
@@ -375,7 +825,17 @@ DECLARE_X3_RULE(_for, ast::For, "for statement")
 DECLARE_X3_RULE(_break, ast::Break, "break statement")
 DECLARE_X3_RULE(_continue, ast::Continue, "continue statement")
 DECLARE_X3_RULE(match_case, ast::MatchCase, "match statement case")
-DECLARE_X3_RULE(match, ast::Match, "match statement")
+
+// Expression, assignment and match statements, which are told apart after the
+// expression, so that it is parsed once
+DECLARE_X3_RULE(expr_leading_stmt_internal, ast::Stmt, "expression statement")
+
+const x3::rule<struct expr_leading_stmt_tag, ast::Stmt> expr_leading_stmt{
+  "expression statement"};
+struct expr_leading_stmt_tag
+  : ErrorHandle
+  , AnnotateExprLeadingStmt {};
+
 DECLARE_X3_RULE(stmt, ast::Stmt, "statement")
 
 //===----------------------------------------------------------------------===//
@@ -415,20 +875,6 @@ DECLARE_X3_RULE(top_level, ast::TopLevel, "top level")
 DECLARE_X3_RULE(top_level_with_attr, ast::TopLevelWithAttr, "top level")
 DECLARE_X3_RULE(top_level_list, ast::TopLevelList, "top level list")
 
-//===----------------------------------------------------------------------===//
-// Comment rules declaration
-//===----------------------------------------------------------------------===//
-
-DECLARE_X3_RULE_NO_ATTR(single_line_comment, "single line comment")
-DECLARE_X3_RULE_NO_ATTR(block_comment, "block comment")
-DECLARE_X3_RULE_NO_ATTR(comment, "comment")
-
-//===----------------------------------------------------------------------===//
-// Skipper rule declaration
-//===----------------------------------------------------------------------===//
-
-DECLARE_X3_RULE_NO_ATTR(skipper, "skipper")
-
 //===----------------------------------------------------------------------===//
 // Translation unit rule declaration
 //===----------------------------------------------------------------------===//
@@ -446,22 +892,14 @@ DECLARE_X3_RULE(translation_unit, ast::TranslationUnit, "translation unit")
 // Common rules definition
 //===----------------------------------------------------------------------===//
 
-const auto punct_def
-  = x3::unicode::punct | lit(U"^") | lit(U"\"") | lit(U"<") | lit(U">");
-
-const auto identifier_internal_def
-  = x3::raw[x3::lexeme[(x3::unicode::graph - (x3::unicode::digit | punct)
-                        | lit(U"_"))
-                       >> *((x3::unicode::graph - punct) | lit(U"_"))]];
+const auto identifier_internal_def = word;
 
 const auto identifier_def
-  = identifier_internal - (lit(U"true") | lit(U"false") | lit(U"nullptr"));
+  = identifier_word - (lit(U"true") | lit(U"false") | lit(U"nullptr"));
 
+// The contents of a string literal without escape sequences
 const auto path_internal_def
-  = x3::raw[x3::lexeme[(x3::unicode::graph - (x3::unicode::digit | punct)
-                        | lit(U"_") | lit(U".") | lit(U"/"))
-                       >> *(x3::unicode::graph - punct | lit(U"_") | lit(U".")
-                            | lit(U"/"))]];
+  = tokenText<TokenKind::string_literal>(chars::path);
 
 const auto path_def = path_internal;
 
@@ -469,42 +907,40 @@ const auto variable_qualifier_def = variable_qualifier_symbols;
 
 const auto access_specifier_def = access_specifier_symbols;
 
+template <typename Subject>
+[[nodiscard]] constexpr auto number(const Subject& subject)
+{
+  return tokenText<TokenKind::number>(subject);
+}
+
 const auto binary_literal_def
-  = x3::lexeme[lit(U"0b") >> x3::uint_parser<std::uint32_t, 2>{}];
+  = number(x3::standard::lit("0b") >> x3::uint_parser<std::uint32_t, 2>{});
 
 const auto octal_literal_def
-  = x3::lexeme[lit(U"0") >> x3::uint_parser<std::uint32_t, 8>{}];
+  = number(x3::standard::lit("0") >> x3::uint_parser<std::uint32_t, 8>{});
 
 const auto hex_literal_def
-  = x3::lexeme[lit(U"0x") >> x3::uint_parser<std::uint32_t, 16>{}];
+  = number(x3::standard::lit("0x") >> x3::uint_parser<std::uint32_t, 16>{});
 
-const auto uint_32bit_def = x3::uint32;
+const auto uint_32bit_def = number(x3::uint32);
 
-const auto int_32bit_def = x3::int32;
+const auto int_32bit_def = number(x3::int32);
 
-const auto uint_64bit_def = x3::uint64;
+const auto uint_64bit_def = number(x3::uint64);
 
-const auto int_64bit_def = x3::int64;
+const auto int_64bit_def = number(x3::int64);
 
-const auto float_64bit_def = boost::spirit::x3::
-  real_parser<double, boost::spirit::x3::strict_real_policies<double>>{};
+const auto float_64bit_def = number(
+  x3::real_parser<double, x3::strict_real_policies<double>>{});
 
 const auto boolean_literal_def
   = lit(U"true") >> x3::attr(true) | lit(U"false") >> x3::attr(false);
 
-const auto escape_char_def
-  = lit(U"\\") >> x3::int_parser<char, 8, 1, 3>{}     // Octal
-    | lit(U"\\x") >> x3::int_parser<char, 16, 2, 2>{} // Hexadecimal
-    | escape_char_symbols;
-
 const auto string_literal_def
-  = x3::lexeme[lit(U"\"")
-               >> *(char_ - (lit(U"\"") | x3::eol | lit(U"\\")) | escape_char)
-               > lit(U"\"")];
+  = tokenText<TokenKind::string_literal>(chars::string_literal);
 
 const auto char_literal_def
-  = lit(U"'") >> (char_ - (lit(U"'") | x3::eol | lit(U"\\")) | escape_char)
-    > lit(U"'");
+  = tokenText<TokenKind::char_literal>(chars::char_literal);
 
 const auto attribute_def
   = lit(U"[[") >> (identifier_internal % lit(U",")) > lit(U"]]");
@@ -522,9 +958,6 @@ const auto class_literal_def
 
 const auto builtin_macro_def = builtin_macro_symbols;
 
-const auto space_def = x3::unicode::space;
-
-BOOST_SPIRIT_DEFINE(punct)
 BOOST_SPIRIT_DEFINE(identifier_internal)
 BOOST_SPIRIT_DEFINE(identifier)
 BOOST_SPIRIT_DEFINE(path_internal)
@@ -540,12 +973,10 @@ BOOST_SPIRIT_DEFINE(uint_64bit)
 BOOST_SPIRIT_DEFINE(int_64bit)
 BOOST_SPIRIT_DEFINE(float_64bit)
 BOOST_SPIRIT_DEFINE(boolean_literal)
-BOOST_SPIRIT_DEFINE(escape_char)
 BOOST_SPIRIT_DEFINE(string_literal)
 BOOST_SPIRIT_DEFINE(char_literal)
 BOOST_SPIRIT_DEFINE(attribute)
 BOOST_SPIRIT_DEFINE(builtin_macro)
-BOOST_SPIRIT_DEFINE(space)
 BOOST_SPIRIT_DEFINE(array_literal)
 BOOST_SPIRIT_DEFINE(class_literal)
 BOOST_SPIRIT_DEFINE(template_args)
@@ -556,7 +987,12 @@ BOOST_SPIRIT_DEFINE(template_args)
 
 const auto builtin_type_def = builtin_type_symbols;
 
-const auto type_name_def = reference_type;
+// Tag used to get the memo table of type names from the context.
+struct TypeNameMemoTag;
+
+// Expressions that start with a type, such as class literals, try the same
+// type at the same position
+const auto type_name_def = memoize<TypeNameMemoTag>(reference_type);
 
 const auto reference_type_internal_def = lit(U"&") > array_type;
 
@@ -700,15 +1136,15 @@ const auto cast_def
 const auto unary_internal_def = unary_operator >> reference;
 const auto unary_def          = unary_internal | reference;
 
-const auto reference_internal_def = lit(U"ref") >> x3::no_skip[space] > new_;
+const auto reference_internal_def = lit(U"ref") > new_;
 const auto reference_def          = reference_internal | new_;
 
-const auto new_internal_def = lit(U"new") >> x3::no_skip[space] > type_name
+const auto new_internal_def = lit(U"new") > type_name
                               > x3::matches[lit(U"{")]
                               > -(expr % lit(U",") > lit(U"}"));
 const auto new__def = new_internal | delete_;
 
-const auto delete_internal_def = lit(U"delete") >> x3::no_skip[space] > expr;
+const auto delete_internal_def = lit(U"delete") > expr;
 const auto delete__def         = delete_internal | member_access;
 
 const auto member_access_def
@@ -784,8 +1220,6 @@ BOOST_SPIRIT_DEFINE(primary)
 // Statement rules definition
 //===----------------------------------------------------------------------===//
 
-const auto expr_stmt_def = expr;
-
 const auto assignment_def = expr >> assignment_operator > expr;
 
 const auto prefix_increment_decrement_def
@@ -816,18 +1250,24 @@ const auto _continue_def = lit(U"continue") >> x3::attr(ast::Continue{});
 
 const auto match_case_def = expr > lit(U"=>") > stmt;
 
-const auto match_def
-  = expr >> lit(U"match") > lit(U"{") > *match_case > lit(U"}");
+const auto expr_leading_stmt_internal_def
+  = expr[action::assignAttrToVal]
+    >> ((lit(U"match") > lit(U"{") > *match_case
+         > lit(U"}"))[action::makeStmtFromExprAs<ast::Match>{}]
+        | (assignment_operator > expr
+           > lit(U";"))[action::makeStmtFromExprAs<ast::Assignment>{}]
+        | lit(U";"));
+
+const auto expr_leading_stmt_def = expr_leading_stmt_internal;
 
 const auto stmt_def
   = lit(U";")                       /* Null statement */
     | lit(U"{") > *stmt > lit(U"}") /* Compound statement */
-    | _loop | _while | _for | _if | match | _break >> lit(U";")
+    | _loop | _while | _for | _if | _break >> lit(U";")
     | _continue >> lit(U";") | _return >> lit(U";")
-    | prefix_increment_decrement >> lit(U";") | assignment >> lit(U";")
-    | variable_def >> lit(U";") | expr_stmt >> lit(U";");
+    | prefix_increment_decrement >> lit(U";") | variable_def >> lit(U";")
+    | expr_leading_stmt;
 
-BOOST_SPIRIT_DEFINE(expr_stmt)
 BOOST_SPIRIT_DEFINE(variable_def)
 BOOST_SPIRIT_DEFINE(assignment)
 BOOST_SPIRIT_DEFINE(prefix_increment_decrement)
@@ -839,7 +1279,8 @@ BOOST_SPIRIT_DEFINE(_for)
 BOOST_SPIRIT_DEFINE(_break)
 BOOST_SPIRIT_DEFINE(_continue)
 BOOST_SPIRIT_DEFINE(match_case)
-BOOST_SPIRIT_DEFINE(match)
+BOOST_SPIRIT_DEFINE(expr_leading_stmt_internal)
+BOOST_SPIRIT_DEFINE(expr_leading_stmt)
 BOOST_SPIRIT_DEFINE(stmt)
 
 //===----------------------------------------------------------------------===//
@@ -903,8 +1344,7 @@ const auto function_def_def = is_public >> lit(U"func") > function_proto > stmt;
 const auto type_def_def
   = lit(U"typedef") > identifier > lit(U"=") > type_name > lit(U";");
 
-const auto import__def
-  = lit(U"import") > lit(U"\"") > path > lit(U"\"") > lit(U";");
+const auto import__def = lit(U"import") > path > lit(U";");
 
 const auto name_space_def
   = lit(U"namespace") > identifier > lit(U"{") > top_level_list > lit(U"}");
@@ -945,67 +1385,217 @@ BOOST_SPIRIT_DEFINE(top_level_with_attr)
 BOOST_SPIRIT_DEFINE(top_level_list)
 
 //===----------------------------------------------------------------------===//
-// Comment rules definition
+// Translation unit rule and tag definition
 //===----------------------------------------------------------------------===//
 
-const auto single_line_comment_def
-  = lit(U"//") >> *(char_ - x3::eol) >> (x3::eol | x3::eoi);
+const auto translation_unit_def = top_level_list > x3::eoi;
 
-const auto block_comment_def
-  = lit(U"/*") >> *(block_comment | (char_ - lit(U"*/"))) >> lit(U"*/");
+BOOST_SPIRIT_DEFINE(translation_unit)
 
-const auto comment_def = single_line_comment | block_comment;
+#pragma clang diagnostic pop
 
-BOOST_SPIRIT_DEFINE(single_line_comment)
-BOOST_SPIRIT_DEFINE(comment)
-BOOST_SPIRIT_DEFINE(block_comment)
+} // namespace syntax
 
-//===----------------------------------------------------------------------===//
-// Skipper rules definition
-//===----------------------------------------------------------------------===//
+// Parse the tokens as top levels
+// Returns false if an error occurred, which is written by the error reporter
+[[nodiscard]] static bool parseTopLevels(const Token*          first,
+                                         const Token* const    last,
+                                         const std::string_view text,
+                                         const ErrorReporter&  error_reporter,
+                                         PositionBuilder&      positions,
+                                         ast::TranslationUnit& ast)
+{
+  syntax::MemoTable<ast::Type> type_name_memo;
 
-const auto skipper_def = x3::space | comment;
+  const auto parser = x3::with<ErrorReporterTag>(
+    error_reporter)[x3::with<PositionTableTag>(positions)[x3::with<
+    syntax::SourceTag>(text)[x3::with<syntax::TypeNameMemoTag>(
+    type_name_memo)[syntax::translation_unit]]]];
 
-BOOST_SPIRIT_DEFINE(skipper)
+  return x3::parse(first, last, parser, ast) && first == last;
+}
 
-//===----------------------------------------------------------------------===//
-// Translation unit rule and tag definition
-//===----------------------------------------------------------------------===//
+// Whether the token can start a top level, which is a keyword or an attribute
+[[nodiscard]] static bool startsTopLevel(const Token* const token)
+{
+  static const std::array<KeywordID, 8> keywords = {
+    findKeyword("class"),
+    findKeyword("declare"),
+    findKeyword("func"),
+    findKeyword("import"),
+    findKeyword("namespace"),
+    findKeyword("pub"),
+    findKeyword("typedef"),
+    findKeyword("union"),
+  };
 
-const auto translation_unit_def = top_level_list > x3::eoi;
+  if (token->kind == TokenKind::punct)
+    return token->punct == '[' && token->joined && token[1].punct == '[';
 
-BOOST_SPIRIT_DEFINE(translation_unit)
+  return token->kind == TokenKind::word
+         && std::ranges::find(keywords, token->keyword) != keywords.end();
+}
 
-#pragma clang diagnostic pop
+// Split the tokens into chunks of at least chunk_size tokens, which are parsed
+// independently
+// A chunk ends with ';' or '}' outside of any brackets, followed by the
+// beginning of a top level
+// Keywords are not reserved, so a chunk may be split in the middle of a top
+// level in rare cases, where the chunk fails to parse
+// Returns the boundaries of the chunks including both ends
+[[nodiscard]] static std::vector<const Token*>
+splitIntoChunks(const Token* const first,
+                const Token* const last,
+                const std::size_t  chunk_size)
+{
+  std::vector<const Token*> boundaries{first};
+
+  std::size_t depth = 0;
+
+  for (auto iter = first; iter != last; ++iter) {
+    if (iter->kind != TokenKind::punct)
+      continue;
+
+    switch (iter->punct) {
+    case '(':
+    case '[':
+    case '{':
+      ++depth;
+      continue;
+    case ')':
+    case ']':
+    case '}':
+      // Unbalanced brackets are reported by the grammar
+      if (depth)
+        --depth;
+      break;
+    case ';':
+      break;
+    default:
+      continue;
+    }
+
+    const auto next = std::next(iter);
+
+    if (!depth && (iter->punct == ';' || iter->punct == '}')
+        && chunk_size <= static_cast<std::size_t>(next - boundaries.back())
+        && next != last && startsTopLevel(next))
+      boundaries.push_back(next);
+  }
 
-} // namespace syntax
+  boundaries.push_back(last);
 
-Parser::Parser(std::string&& input, const std::filesystem::path& file)
-  : input{std::move(input)}
-  , u32_first{this->input.cbegin()}
-  , u32_last{this->input.cend()}
-  , positions{u32_first, u32_last}
+  return boundaries;
+}
+
+Parser::Parser(std::shared_ptr<const SourceFile>&& source,
+               const std::filesystem::path&        file,
+               std::ostream&                       err_ostm,
+               const unsigned int                  jobs)
+  : source{std::move(source)}
+  , positions{*this->source}
   , file{file}
+  , err_ostm{err_ostm}
 {
-  parse();
+  parse(jobs);
 }
 
-void Parser::parse()
+void Parser::parse(const unsigned int jobs)
 {
-  x3::error_handler<InputIterator> error_handler{u32_first,
-                                                 u32_last,
-                                                 std::cerr,
-                                                 file.string()};
+  const auto text = source->text();
+
+  const ErrorReporter error_reporter{*source, file.string(), err_ostm};
 
-  const auto parser = x3::with<x3::error_handler_tag>(
-    std::ref(error_handler))[x3::with<PositionCacheTag>(
-    positions)[syntax::translation_unit]];
+  std::vector<Token> tokens;
 
-  if (!x3::phrase_parse(u32_first, u32_last, parser, syntax::skipper, ast)
-      || u32_first != u32_last) {
+  try {
+    tokens = tokenize(text);
+  }
+  catch (const LexError& e) {
+    error_reporter(e.offset, formatError(e.what()));
+    throw ParseError{"compilation terminated."};
+  }
+
+  // The eoi token is not parsed, but positions at the end refer to it
+  const Token* const first = tokens.data();
+  const Token* const last  = tokens.data() + tokens.size() - 1;
+
+  // Small chunks are not worth the threads
+  constexpr std::size_t MIN_CHUNK_SIZE = 1 << 14;
+
+  // A few chunks per worker balance the load
+  const auto chunk_size
+    = std::max(MIN_CHUNK_SIZE,
+               tokens.size() / (getWorkerCount(jobs, tokens.size()) * 4));
+
+  if (getWorkerCount(jobs, tokens.size()) != 1
+      && parseChunks(splitIntoChunks(first, last, chunk_size), jobs))
+    return;
+
+  // If a chunk failed, the whole file is parsed again, so that the error is
+  // reported in the same way as parsing in one thread
+  std::atomic<std::uint32_t> next_id{};
+  PositionBuilder            builder{positions, next_id};
+
+  if (!parseTopLevels(first, last, text, error_reporter, builder, ast)) {
     // Some error occurred in parsing.
     throw ParseError{"compilation terminated."};
   }
+
+  builder.copyTo(positions);
+}
+
+[[nodiscard]] bool
+Parser::parseChunks(const std::vector<const Token*>& boundaries,
+                    const unsigned int               jobs)
+{
+  const auto chunk_count = boundaries.size() - 1;
+
+  if (chunk_count == 1)
+    return false;
+
+  std::vector<ast::TranslationUnit> chunks(chunk_count);
+  std::deque<PositionBuilder>       builders;
+
+  std::atomic<std::uint32_t> next_id{};
+
+  for (std::size_t idx = 0; idx < chunk_count; ++idx)
+    builders.emplace_back(positions, next_id);
+
+  std::atomic<bool> failed{};
+
+  parallelFor(jobs, chunk_count, [&](const std::size_t idx, std::size_t) {
+    if (failed.load(std::memory_order_relaxed))
+      return;
+
+    const llvm::TimeTraceScope scope{"ParseChunk"};
+
+    // Errors are reported when parsing again
+    std::ostringstream  discarded;
+    const ErrorReporter error_reporter{*source, file.string(), discarded};
+
+    if (!parseTopLevels(boundaries[idx],
+                        boundaries[idx + 1],
+                        source->text(),
+                        error_reporter,
+                        builders[idx],
+                        chunks[idx]))
+      failed.store(true, std::memory_order_relaxed);
+  });
+
+  if (failed)
+    return false;
+
+  // Spliced in the source order
+  for (std::size_t idx = 0; idx < chunk_count; ++idx) {
+    builders[idx].copyTo(positions);
+
+    ast.insert(ast.end(),
+               std::make_move_iterator(chunks[idx].begin()),
+               std::make_move_iterator(chunks[idx].end()));
+  }
+
+  return true;
 }
 
 } // namespace twk::parse
@@ -7,13 +7,16 @@
 
 #include <twk/support/file.hpp>
 #include <twk/support/utils.hpp>
+#include <boost/filesystem.hpp>
 
 namespace twk
 {
 
-// Load a file to std::string
-[[nodiscard]] std::string loadFile(const std::string_view       program_name,
-                                   const std::filesystem::path& path)
+// Load a source file through the source manager
+[[nodiscard]] std::shared_ptr<const SourceFile>
+loadFile(SourceManager&               source_manager,
+         const std::string_view       program_name,
+         const std::filesystem::path& path)
 {
   if (!std::filesystem::exists(path)) {
     throw FileError{
@@ -21,15 +24,49 @@ namespace twk
                   fmt::format("{}: No such file or directory", path.string()))};
   }
 
+  if (auto file = source_manager.load(path))
+    return file;
+
+  throw FileError{
+    formatError(program_name,
+                fmt::format("{}: Could not open file", path.string()))};
+}
+
+[[nodiscard]] std::optional<std::string>
+readFile(const std::filesystem::path& path)
+{
   if (auto file = std::ifstream{path, std::ios_base::binary}) {
     std::stringstream ss;
     ss << file.rdbuf();
     return ss.str();
   }
 
-  throw FileError{
-    formatError(program_name,
-                fmt::format("{}: Could not open file", path.string()))};
+  return std::nullopt;
+}
+
+void writeFileAtomically(const std::filesystem::path& path,
+                         const std::string_view       contents)
+{
+  namespace fs = std::filesystem;
+
+  const auto tmp_path
+    = path.string() + '.' + boost::filesystem::unique_path().string() + ".tmp";
+
+  std::error_code ec;
+
+  {
+    std::ofstream file{tmp_path, std::ios_base::binary};
+
+    if (!file.write(contents.data(), contents.size())) {
+      fs::remove(tmp_path, ec);
+      return;
+    }
+  }
+
+  fs::rename(tmp_path, path, ec);
+
+  if (ec)
+    fs::remove(tmp_path, ec);
 }
 
 } // namespace twk
@@ -0,0 +1,67 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twk/support/interner.hpp>
+
+namespace twk
+{
+
+[[nodiscard]] Symbol StringInterner::intern(const std::string_view str)
+{
+  if (str.empty())
+    return {};
+
+  const auto hash = std::hash<std::string_view>{}(str);
+
+  auto& shard = shards[hash % SHARD_COUNT];
+
+  {
+    std::shared_lock lock{shard.mutex};
+
+    if (const auto iter = shard.index.find(str); iter != shard.index.end())
+      return Symbol{iter->second};
+  }
+
+  std::unique_lock lock{shard.mutex};
+
+  // Interned by another thread while unlocked
+  if (const auto iter = shard.index.find(str); iter != shard.index.end())
+    return Symbol{iter->second};
+
+  const auto& entry = shard.strings.emplace_back(detail::InternedString{
+    std::string{str},
+    hash,
+    next_id.fetch_add(1, std::memory_order_relaxed)});
+
+  shard.index.emplace(entry.str, &entry);
+
+  return Symbol{&entry};
+}
+
+static thread_local StringInterner* current_interner = nullptr;
+
+InternerScope::InternerScope(StringInterner& interner) noexcept
+  : previous{current_interner}
+{
+  current_interner = &interner;
+}
+
+InternerScope::~InternerScope()
+{
+  current_interner = previous;
+}
+
+[[nodiscard]] StringInterner& getStringInterner() noexcept
+{
+  if (current_interner)
+    return *current_interner;
+
+  static StringInterner interner;
+  return interner;
+}
+
+} // namespace twk
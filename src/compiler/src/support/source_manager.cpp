@@ -0,0 +1,121 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twk/support/source_manager.hpp>
+
+namespace twk
+{
+
+SourceFile::SourceFile(std::unique_ptr<llvm::MemoryBuffer>&& buffer,
+                       const std::uint32_t                   id)
+  : buffer{std::move(buffer)}
+  , id{id}
+{
+  assert(this->buffer);
+}
+
+[[nodiscard]] std::size_t SourceFile::lineOf(const std::size_t offset) const
+{
+  assert(offset <= text().size());
+
+  const auto& offsets = getLineOffsets();
+
+  // The first line starts at 0, so the result is never the beginning
+  return static_cast<std::size_t>(
+    std::distance(offsets.begin(),
+                  std::upper_bound(offsets.begin(), offsets.end(), offset)));
+}
+
+[[nodiscard]] std::string_view
+SourceFile::line(const std::size_t line_number) const
+{
+  const auto& offsets = getLineOffsets();
+
+  assert(1 <= line_number && line_number <= offsets.size());
+
+  const auto source = text();
+  const auto first  = offsets[line_number - 1];
+  const auto last   = line_number < offsets.size() ? offsets[line_number] - 1
+                                                   : source.size();
+
+  auto line = source.substr(first, last - first);
+
+  if (line.ends_with('\r'))
+    line.remove_suffix(1);
+
+  return line;
+}
+
+[[nodiscard]] const std::vector<std::size_t>& SourceFile::getLineOffsets() const
+{
+  std::call_once(line_offsets_flag, [this] {
+    const auto source = text();
+
+    line_offsets.push_back(0);
+
+    for (auto pos = source.find('\n'); pos != std::string_view::npos;
+         pos      = source.find('\n', pos + 1))
+      line_offsets.push_back(pos + 1);
+  });
+
+  return line_offsets;
+}
+
+// Files are keyed by their canonical paths
+[[nodiscard]] static std::string makeKey(const std::filesystem::path& path)
+{
+  std::error_code ec;
+  auto            key = std::filesystem::weakly_canonical(path, ec).string();
+
+  if (ec)
+    key = std::filesystem::absolute(path).lexically_normal().string();
+
+  return key;
+}
+
+[[nodiscard]] std::shared_ptr<const SourceFile>
+SourceManager::load(const std::filesystem::path& path)
+{
+  auto key = makeKey(path);
+
+  {
+    const std::lock_guard lock{mutex};
+
+    if (const auto iter = files.find(key); iter != files.end())
+      return iter->second;
+  }
+
+  // Other files are read while this file is read
+  // The file is not null-terminated, so large files are always mapped
+  auto buffer = llvm::MemoryBuffer::getFile(path.string(),
+                                            /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false);
+
+  if (!buffer
+      || (*buffer)->getBufferSize() > std::numeric_limits<std::uint32_t>::max())
+    return nullptr;
+
+  const std::lock_guard lock{mutex};
+
+  // If another thread has read the same file, its contents are used
+  if (const auto iter = files.find(key); iter != files.end())
+    return iter->second;
+
+  return files[std::move(key)]
+    = std::make_shared<const SourceFile>(std::move(*buffer), next_id++);
+}
+
+void SourceManager::invalidate(const std::filesystem::path& path)
+{
+  const auto key = makeKey(path);
+
+  const std::lock_guard lock{mutex};
+
+  files.erase(key);
+}
+
+} // namespace twk
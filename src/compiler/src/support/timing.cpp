@@ -0,0 +1,133 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twk/support/timing.hpp>
+
+namespace
+{
+
+// Worker threads start recording with the same settings as the main thread
+unsigned int time_trace_granularity{};
+std::string  time_trace_process_name;
+
+thread_local twk::TimeReport* current_report{};
+
+} // namespace
+
+namespace twk
+{
+
+//===----------------------------------------------------------------------===//
+// Time trace
+//===----------------------------------------------------------------------===//
+
+TimeTraceProfiler::TimeTraceProfiler(const unsigned int     granularity,
+                                     const std::string_view process_name)
+{
+  time_trace_granularity  = granularity;
+  time_trace_process_name = process_name;
+
+  llvm::timeTraceProfilerInitialize(granularity, time_trace_process_name);
+}
+
+TimeTraceProfiler::~TimeTraceProfiler()
+{
+  llvm::timeTraceProfilerCleanup();
+}
+
+[[nodiscard]] bool
+TimeTraceProfiler::write(const std::filesystem::path& path) const
+{
+  std::error_code      ec;
+  llvm::raw_fd_ostream ostm{path.string(), ec, llvm::sys::fs::OF_Text};
+
+  if (ec)
+    return false;
+
+  llvm::timeTraceProfilerWrite(ostm);
+
+  ostm.close();
+
+  const auto failed = ostm.has_error();
+  ostm.clear_error();
+
+  return !failed;
+}
+
+[[nodiscard]] unsigned int getTimeTraceGranularity() noexcept
+{
+  return time_trace_granularity;
+}
+
+WorkerTimeTraceScope::WorkerTimeTraceScope(const bool enabled)
+  : enabled{enabled}
+{
+  if (enabled) {
+    llvm::timeTraceProfilerInitialize(time_trace_granularity,
+                                      time_trace_process_name);
+  }
+}
+
+WorkerTimeTraceScope::~WorkerTimeTraceScope()
+{
+  // The spans are moved to the profiler of the main thread
+  if (enabled)
+    llvm::timeTraceProfilerFinishThread();
+}
+
+//===----------------------------------------------------------------------===//
+// Time report
+//===----------------------------------------------------------------------===//
+
+TimeReport::TimeReport()
+  : group{"twk", "twk time report"}
+  , prev{current_report}
+{
+  current_report = this;
+}
+
+TimeReport::~TimeReport()
+{
+  current_report = prev;
+
+  // Otherwise the unprinted times are printed when the timers are destroyed
+  group.clear();
+}
+
+void TimeReport::print(llvm::raw_ostream& ostm)
+{
+  group.print(ostm, true);
+}
+
+[[nodiscard]] llvm::Timer& TimeReport::getTimer(const std::string_view name)
+{
+  const llvm::StringRef name_ref{name.data(), name.size()};
+
+  for (const auto& r : timers) {
+    if (r->getName() == name_ref)
+      return *r;
+  }
+
+  return *timers.emplace_back(
+    std::make_unique<llvm::Timer>(name_ref, name_ref, group));
+}
+
+PhaseScope::PhaseScope(const std::string_view name)
+  : trace_scope{llvm::StringRef{name.data(), name.size()}}
+  , timer{current_report ? &current_report->getTimer(name) : nullptr}
+{
+  if (timer)
+    timer->startTimer();
+}
+
+PhaseScope::~PhaseScope()
+{
+  if (timer)
+    timer->stopTimer();
+}
+
+} // namespace twk
@@ -6,6 +6,7 @@
  */
 
 #include <twk/unicode/unicode.hpp>
+#include <cstring>
 
 namespace twk::unicode
 {
@@ -28,9 +29,106 @@ namespace twk::unicode
 
 [[nodiscard]] std::u32string utf8toUtf32(const std::string_view utf8_str)
 {
+  if (isAscii(utf8_str))
+    return std::u32string(cbegin(utf8_str), cend(utf8_str));
+
   boost::u8_to_u32_iterator first{cbegin(utf8_str)}, last{cend(utf8_str)};
 
   return std::u32string(first, last);
 }
 
+// Bytes are checked 16 at a time as two 64-bit words, so that ASCII text is
+// skipped without branching on each byte
+static constexpr std::size_t BLOCK_SIZE = 16;
+
+[[nodiscard]] static bool isAsciiBlock(const char* block) noexcept
+{
+  std::uint64_t first, second;
+
+  std::memcpy(&first, block, sizeof first);
+  std::memcpy(&second, block + sizeof first, sizeof second);
+
+  return ((first | second) & 0x8080808080808080) == 0;
+}
+
+[[nodiscard]] bool isAscii(const std::string_view str) noexcept
+{
+  std::size_t i = 0;
+
+  for (; i + BLOCK_SIZE <= str.size(); i += BLOCK_SIZE)
+    if (!isAsciiBlock(str.data() + i))
+      return false;
+
+  return std::all_of(str.begin() + i, str.end(), [](const char ch) {
+    return static_cast<unsigned char>(ch) < 0x80;
+  });
+}
+
+// Returns the length of the well-formed sequence, or 0 if it is ill-formed
+// See Table 3-7 of the Unicode Standard
+[[nodiscard]] static std::size_t
+sequenceLength(const unsigned char* first, const unsigned char* last) noexcept
+{
+  const auto lead = *first;
+
+  std::size_t   length;
+  unsigned char second_min = 0x80, second_max = 0xBF;
+
+  if (0xC2 <= lead && lead <= 0xDF)
+    length = 2;
+  else if (0xE0 <= lead && lead <= 0xEF) {
+    length = 3;
+
+    if (lead == 0xE0)
+      second_min = 0xA0; // Overlong
+    else if (lead == 0xED)
+      second_max = 0x9F; // Surrogates
+  }
+  else if (0xF0 <= lead && lead <= 0xF4) {
+    length = 4;
+
+    if (lead == 0xF0)
+      second_min = 0x90; // Overlong
+    else if (lead == 0xF4)
+      second_max = 0x8F; // Over U+10FFFF
+  }
+  else
+    return 0;
+
+  if (static_cast<std::size_t>(last - first) < length || first[1] < second_min
+      || second_max < first[1])
+    return 0;
+
+  for (std::size_t i = 2; i < length; ++i) {
+    if ((first[i] & 0xC0) != 0x80)
+      return 0;
+  }
+
+  return length;
+}
+
+[[nodiscard]] std::optional<std::size_t>
+findInvalidUtf8(const std::string_view str) noexcept
+{
+  const auto first = reinterpret_cast<const unsigned char*>(str.data());
+  const auto last  = first + str.size();
+
+  auto iter = first;
+
+  while (iter != last) {
+    // Source code is mostly ASCII
+    if (static_cast<std::size_t>(last - iter) >= BLOCK_SIZE
+        && isAsciiBlock(reinterpret_cast<const char*>(iter)))
+      iter += BLOCK_SIZE;
+    else if (*iter < 0x80)
+      ++iter;
+    else if (const auto length = sequenceLength(iter, last))
+      iter += length;
+    else
+      return static_cast<std::size_t>(iter - first);
+  }
+
+  return std::nullopt;
+}
+
 } // namespace twk::unicode
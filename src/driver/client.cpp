@@ -0,0 +1,107 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "client.hpp"
+#include "socket.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef TWK_SERVER_SUPPORTED
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace twk
+{
+
+[[nodiscard]] std::optional<int>
+requestServer(const std::string&              socket_path,
+              const std::vector<std::string>& args,
+              const std::string_view          argv_front)
+{
+  const FileDescriptor fd{socket(AF_UNIX, SOCK_STREAM, 0)};
+
+  sockaddr_un addr{};
+
+  if (fd.fd == -1 || !setSocketPath(addr, socket_path)
+      || connect(fd.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))
+           == -1)
+    return std::nullopt;
+
+  // The server of another user could read the sources and write files here
+  if (!isPeerSameUser(fd.fd)) {
+    std::cerr << argv_front << ": warning: " << socket_path
+              << ": the compile server is run by another user, and is not "
+                 "used\n"
+              << std::flush;
+    return std::nullopt;
+  }
+
+  std::error_code ec;
+  const auto      cwd = std::filesystem::current_path(ec);
+
+  if (ec)
+    return std::nullopt;
+
+  std::vector<std::string> environment;
+
+  for (auto env = environ; *env; ++env)
+    environment.emplace_back(*env);
+
+  MessageWriter writer;
+  writer.writeString(cwd.string());
+  writer.writeStrings(args);
+  writer.writeStrings(environment);
+
+  const StandardStreams streams{STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+
+  // Nothing has been run until the request is sent
+  if (!sendMessage(fd.fd, writer.buffer)
+      || !sendStandardStreams(fd.fd, streams))
+    return std::nullopt;
+
+  // The request may have written to the standard streams, so it is not run
+  // again in this process
+  if (const auto response = receiveMessage(fd.fd)) {
+    try {
+      MessageReader reader{*response};
+      return static_cast<int>(reader.readInt());
+    }
+    catch (const std::runtime_error&) {
+    }
+  }
+
+  std::cerr << argv_front
+            << ": error: the compile server stopped while running the "
+               "request\n"
+            << std::flush;
+
+  return EXIT_FAILURE;
+}
+
+} // namespace twk
+
+#else // TWK_SERVER_SUPPORTED
+
+namespace twk
+{
+
+[[nodiscard]] std::optional<int>
+requestServer([[maybe_unused]] const std::string&              socket_path,
+              [[maybe_unused]] const std::vector<std::string>& args,
+              [[maybe_unused]] const std::string_view          argv_front)
+{
+  return std::nullopt;
+}
+
+} // namespace twk
+
+#endif // TWK_SERVER_SUPPORTED
@@ -0,0 +1,35 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _3eda5b5e_2d4a_4c51_a55b_e65d26408f80
+#define _3eda5b5e_2d4a_4c51_a55b_e65d26408f80
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace twk
+{
+
+// Request the compile server to run twk with the arguments, in the current
+// directory and the environment of this process, reading and writing the
+// standard streams of this process
+// Returns the exit status of the request, or std::nullopt if no server of this
+// user is listening on the socket, in which case nothing has been run
+[[nodiscard]] std::optional<int>
+requestServer(const std::string&              socket_path,
+              const std::vector<std::string>& args,
+              const std::string_view          argv_front);
+
+} // namespace twk
+
+#endif
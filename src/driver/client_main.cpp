@@ -0,0 +1,67 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+// twk-client requests the compile server to run twk with its arguments
+// It does not load LLVM, so that a request only pays for starting this small
+// process. If no server is listening, twk is run instead
+// Usage: twk-client [--socket <path>] [twk options] file...
+
+#include "client.hpp"
+#include "socket.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+
+// Replaces this process with twk next to twk-client, or with twk in PATH
+[[noreturn]] void execTwk(const char* const* const argv)
+{
+  const std::filesystem::path self{*argv};
+
+  const auto twk = self.has_parent_path()
+                   ? (self.parent_path() / "twk").string()
+                   : std::string{"twk"};
+
+  std::vector<char*> twk_argv{const_cast<char*>(twk.c_str())};
+
+  for (auto arg = argv + 1; *arg; ++arg)
+    twk_argv.push_back(const_cast<char*>(*arg));
+
+  twk_argv.push_back(nullptr);
+
+  execvp(twk_argv.front(), twk_argv.data());
+
+  std::cerr << *argv << ": error: " << twk << ": " << std::strerror(errno)
+            << '\n'
+            << std::flush;
+  std::exit(EXIT_FAILURE);
+}
+
+} // namespace
+
+int main(const int argc, const char* const* const argv)
+{
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  auto socket_path = twk::getDefaultSocketPath();
+
+  // Also passed to the server, which ignores it
+  if (2 <= args.size() && args.front() == "--socket")
+    socket_path = args[1];
+
+  if (const auto exit_status = twk::requestServer(socket_path, args, *argv))
+    return *exit_status;
+
+  execTwk(argv);
+}
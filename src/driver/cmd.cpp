@@ -6,6 +6,7 @@
  */
 
 #include "cmd.hpp"
+#include "socket.hpp"
 #include <boost/program_options.hpp>
 #include <twk/support/utils.hpp>
 #include <fmt/color.h>
@@ -39,12 +40,64 @@ namespace
     ("link,l", program_options::value<std::vector<std::string>>()->multitoken(),
      "Specify library names to be linked.\n"
      "The -l option is passed directly to the linker.")
+    ("output,o", program_options::value<std::string>()->default_value(twk::DEFAULT_OUTPUT_FILE),
+     "Specify the name of the executable file.\n"
+     "Only used when emitting an executable file.")
     ("relocation-model",
      program_options::value<std::string>()->default_value("pic"),
      "Set the relocation model. Possible values are 'static' or 'pic'.\n"
      "If llvm is specified for the emit option, this option is disabled.")
     ("target", program_options::value<std::string>(),
      "Specify the name of the target processor.")
+    ("jobs,j", program_options::value<unsigned int>()->default_value(twk::DEFAULT_JOBS),
+     "Specify the maximum number of threads used for compilation.\n"
+     "If 0 is specified, the number of hardware threads is used.")
+    ("cache-dir", program_options::value<std::string>(),
+     "Cache object files in the directory and reuse them while the input "
+     "files and the files imported from them are unchanged.\n"
+     "Object files are only cached when emitting executable or object files. "
+     "The declarations of imported files are also cached, so that they are "
+     "loaded without parsing.")
+    ("cache-stats", "Display the number of cache hits and misses.")
+    ("lto", "Perform link-time optimization.\n"
+     "All input files are linked into one module, optimized as a whole, "
+     "and emitted as one file named after the first input file.")
+    ("thin-lto", "Perform ThinLTO.\n"
+     "Each input file is optimized using the summaries of the others, and "
+     "functions are imported across files. The backends run in parallel, and "
+     "the results are cached in the cache directory if --cache-dir is "
+     "specified.\n"
+     "Only used when emitting executable, object or assembly files.")
+    ("time-trace", "Write a Chrome trace of the compilation to "
+     "<first input file stem>.time-trace.json.\n"
+     "It can be viewed in chrome://tracing or Perfetto.")
+    ("time-trace-granularity",
+     program_options::value<unsigned int>()->default_value(twk::DEFAULT_TIME_TRACE_GRANULARITY),
+     "Specify the minimum duration of spans in the time trace in microseconds.")
+    ("time-report", "Display the time spent in each phase of the compilation.")
+    ("profile-generate", "Instrument the program for profile-guided "
+     "optimization.\n"
+     "The executable writes a profile to default_<signature>.profraw at exit, "
+     "or to LLVM_PROFILE_FILE if it is set. Merge the profiles with "
+     "'llvm-profdata merge' and pass the result to --profile-use.\n"
+     "Cannot be used with JIT compilation.")
+    ("profile-use", program_options::value<std::string>(),
+     "Optimize with the profile merged by llvm-profdata.")
+    ("server", "Run as a compile server.\n"
+     "The server keeps LLVM initialized and runs the requests of twk-client "
+     "and --connect concurrently, each in a process forked from the server. "
+     "Only requests from the same user are accepted.")
+    ("connect", "Request compilation to the compile server.\n"
+     "If the server is not running, compile in this process. twk-client "
+     "requests the server without loading LLVM.")
+    ("socket", program_options::value<std::string>()->default_value(twk::getDefaultSocketPath()),
+     "Specify the socket path of the compile server.\n"
+     "By default, the socket is in $XDG_RUNTIME_DIR, or in a directory in the "
+     "temporary directory that only the user can access.")
+    ("watch", "Compile the input files, then wait for changes to them and "
+     "the files imported from them, and compile again.\n"
+     "Only the changed files and the files importing them are compiled "
+     "again. Cannot be used with JIT compilation, --lto or --thin-lto.")
     ("input-file", program_options::value<std::vector<std::string>>(),
      "Input file. Non-optional arguments are equivalent to this.")
     ;
@@ -104,8 +157,8 @@ getLinkedLibs(const program_options::variables_map& v_map)
 namespace twk
 {
 
-[[nodiscard]] Context parseCmdlineOption(const int                argc,
-                                         const char* const* const argv)
+[[nodiscard]] CmdlineOption parseCmdlineOption(const int                argc,
+                                               const char* const* const argv)
 try {
   const auto desc = createOptionsDesc();
 
@@ -124,22 +177,55 @@ try {
     std::exit(EXIT_SUCCESS);
   }
 
+  const auto server = v_map.contains("server");
+
   auto input_files = getInputFiles(v_map);
 
-  if (input_files.empty()) {
+  if (input_files.empty() && !server) {
     std::cerr << formatError(*argv, "no input files\n") << std::flush;
     std::exit(EXIT_FAILURE);
   }
 
-  return {std::move(input_files),
-          v_map.contains("JIT"),
-          stringToLower(v_map["emit"].as<std::string>()),
-          v_map["Opt"].as<unsigned int>(),
-          stringToLower(v_map["relocation-model"].as<std::string>()),
-          getLinkedLibs(v_map),
-          v_map.contains("target")
-            ? std::make_optional(v_map["target"].as<std::string>())
-            : std::nullopt};
+  // The created files of all input files are needed by every compilation
+  if (v_map.contains("watch")
+      && (v_map.contains("JIT") || v_map.contains("lto")
+          || v_map.contains("thin-lto"))) {
+    std::cerr << formatError(
+      *argv,
+      "--watch cannot be used with --JIT, --lto or --thin-lto\n")
+              << std::flush;
+    std::exit(EXIT_FAILURE);
+  }
+
+  return {
+    {std::move(input_files),
+     v_map.contains("JIT"),
+     stringToLower(v_map["emit"].as<std::string>()),
+     v_map["Opt"].as<unsigned int>(),
+     stringToLower(v_map["relocation-model"].as<std::string>()),
+     getLinkedLibs(v_map),
+     std::string{v_map["output"].as<std::string>()},
+     v_map.contains("target")
+       ? std::make_optional(v_map["target"].as<std::string>())
+       : std::nullopt,
+     v_map["jobs"].as<unsigned int>(),
+     v_map.contains("cache-dir")
+       ? std::make_optional(v_map["cache-dir"].as<std::string>())
+       : std::nullopt,
+     v_map.contains("cache-stats"),
+     v_map.contains("lto"),
+     v_map.contains("thin-lto"),
+     v_map.contains("time-trace"),
+     v_map["time-trace-granularity"].as<unsigned int>(),
+     v_map.contains("time-report"),
+     v_map.contains("profile-generate"),
+     v_map.contains("profile-use")
+       ? std::make_optional(v_map["profile-use"].as<std::string>())
+       : std::nullopt},
+    v_map["socket"].as<std::string>(),
+    server,
+    v_map.contains("connect"),
+    v_map.contains("watch")};
 }
 catch (const program_options::error& err) {
   std::cerr << formatError(*argv, err.what())
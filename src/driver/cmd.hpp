@@ -17,8 +17,25 @@
 namespace twk
 {
 
-[[nodiscard]] Context parseCmdlineOption(const int                argc,
-                                         const char* const* const argv);
+struct CmdlineOption {
+  Context context;
+
+  // Socket of the compile server
+  std::string socket_path;
+
+  // If true, run as the compile server
+  bool server;
+
+  // If true, compilation is requested to the server
+  bool connect;
+
+  // If true, the input files are compiled again whenever they or the files
+  // imported from them change
+  bool watch;
+};
+
+[[nodiscard]] CmdlineOption parseCmdlineOption(const int                argc,
+                                               const char* const* const argv);
 
 } // namespace twk
 
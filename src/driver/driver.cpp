@@ -0,0 +1,72 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "driver.hpp"
+#include "client.hpp"
+#include "cmd.hpp"
+#include "link.hpp"
+#include "server.hpp"
+#include "watch.hpp"
+#include <twk/compile/compile.hpp>
+#include <twk/support/utils.hpp>
+#include <cstdlib>
+#include <iostream>
+
+namespace twk
+{
+
+[[nodiscard]] int runDriver(const int                argc,
+                            const char* const* const argv,
+                            const bool               on_server)
+{
+  const auto [context, socket_path, server, connect, watch]
+    = parseCmdlineOption(argc, argv);
+
+  if (on_server && (server || watch)) {
+    std::cerr << formatError(*argv,
+                             "--server and --watch cannot be requested to the "
+                             "compile server\n")
+              << std::flush;
+    return EXIT_FAILURE;
+  }
+
+  if (server)
+    return runServer(socket_path, *argv);
+
+  if (connect && !on_server) {
+    const std::vector<std::string> args(argv + 1, argv + argc);
+
+    if (const auto exit_status = requestServer(socket_path, args, *argv))
+      return *exit_status;
+  }
+
+  if (!verifyProfileRuntime(context, *argv))
+    return EXIT_FAILURE;
+
+  if (watch)
+    return runWatch(context, *argv);
+
+  const auto result = compile(context, *argv);
+
+  if (!result)
+    return EXIT_FAILURE;
+
+  if (std::holds_alternative<JITResult>(*result))
+    return std::get<JITResult>(*result).exit_status;
+
+  if (context.emit_target == EMIT_EXE_ARG
+      && std::holds_alternative<AOTResult>(*result)) {
+    // Call linker
+    return linkExecutable(context,
+                          std::get<AOTResult>(*result).created_files,
+                          *argv);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+} // namespace twk
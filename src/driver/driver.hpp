@@ -0,0 +1,27 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _476bcdb6_270c_443f_9277_343781fb98eb
+#define _476bcdb6_270c_443f_9277_343781fb98eb
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+namespace twk
+{
+
+// Run twk with the command line arguments, and return the exit status
+// Requests run by the compile server are not requested to a server again, and
+// cannot start a server or watch files
+[[nodiscard]] int runDriver(const int                argc,
+                            const char* const* const argv,
+                            const bool               on_server);
+
+} // namespace twk
+
+#endif
@@ -0,0 +1,251 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "link.hpp"
+#include <twk/support/utils.hpp>
+#include <llvm/Support/Program.h>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef TWK_USE_LLD
+#include "link_command.hpp"
+#include <lld/Common/CommonLinkerContext.h>
+#include <lld/Common/Driver.h>
+#include <llvm/Support/raw_ostream.h>
+#endif // TWK_USE_LLD
+
+namespace
+{
+
+[[nodiscard]] std::optional<int>
+callGcc(const std::vector<std::filesystem::path>& files,
+        const std::vector<std::string>&           linked_libs,
+        const std::string&                        output_file)
+{
+  const auto gcc = llvm::sys::findProgramByName("gcc");
+
+  if (!gcc)
+    return std::nullopt;
+
+  // Passed without a shell, so that file names are not split or expanded
+  std::vector<std::string> args{"gcc", "-o", output_file};
+
+  for (const auto& r : files)
+    args.push_back(r.string());
+
+  for (const auto& r : linked_libs)
+    args.push_back("-l" + r);
+
+  const std::vector<llvm::StringRef> arg_refs(args.begin(), args.end());
+
+  const auto exit_status = llvm::sys::ExecuteAndWait(*gcc, arg_refs);
+
+  // Negative if gcc could not be executed or crashed
+  if (exit_status < 0)
+    return std::nullopt;
+
+  return exit_status;
+}
+
+#ifdef TWK_USE_LLD
+
+// Split a command line printed by '-###', some arguments are double-quoted
+[[nodiscard]] std::vector<std::string>
+splitCommandLine(const std::string_view command_line)
+{
+  std::vector<std::string> args;
+
+  for (auto it = command_line.begin(), last = command_line.end(); it != last;) {
+    if (*it == ' ') {
+      ++it;
+      continue;
+    }
+
+    std::string arg;
+
+    if (*it == '"') {
+      for (++it; it != last && *it != '"'; ++it) {
+        if (*it == '\\' && it + 1 != last)
+          ++it;
+        arg += *it;
+      }
+
+      if (it != last)
+        ++it;
+    }
+    else {
+      for (; it != last && *it != ' '; ++it)
+        arg += *it;
+    }
+
+    args.push_back(std::move(arg));
+  }
+
+  return args;
+}
+
+// Create LLD arguments from the link command of the system C compiler, so that
+// the same startup files, libraries and dynamic linker are used as with gcc
+// Returns std::nullopt if the link command is unknown
+[[nodiscard]] std::optional<std::vector<std::string>>
+createLldArgs(const std::vector<std::filesystem::path>& files,
+              const std::vector<std::string>&           linked_libs,
+              const std::string&                        output_file)
+{
+  std::string_view command_line;
+
+  for (std::size_t first = 0; first < twk::SYSTEM_LINK_COMMAND.size();) {
+    const auto last = std::min(twk::SYSTEM_LINK_COMMAND.find('\n', first),
+                               twk::SYSTEM_LINK_COMMAND.size());
+
+    const auto line = twk::SYSTEM_LINK_COMMAND.substr(first, last - first);
+
+    // The linker invocation is the only line containing the object file
+    if (line.find("TWK_OBJECT.o") != std::string_view::npos
+        && !line.starts_with("COLLECT_GCC_OPTIONS")) {
+      command_line = line;
+      break;
+    }
+
+    first = last + 1;
+  }
+
+  if (command_line.empty())
+    return std::nullopt;
+
+  const auto system_args = splitCommandLine(command_line);
+
+  std::vector<std::string> args{"ld.lld"};
+
+  // The first argument is the system linker
+  for (auto it = system_args.begin() + 1, last = system_args.end(); it != last;
+       ++it) {
+    // The linker plugin of gcc is not for LLD
+    if (*it == "-plugin") {
+      if (it + 1 != last)
+        ++it;
+      continue;
+    }
+
+    if (it->starts_with("-plugin-opt"))
+      continue;
+
+    if (*it == "TWK_OUTPUT")
+      args.push_back(output_file);
+    else if (*it == "TWK_OBJECT.o") {
+      for (const auto& r : files)
+        args.push_back(r.string());
+
+      for (const auto& r : linked_libs)
+        args.push_back("-l" + r);
+    }
+    else
+      args.push_back(*it);
+  }
+
+  return args;
+}
+
+[[nodiscard]] std::optional<int>
+callLld(const std::vector<std::filesystem::path>& files,
+        const std::vector<std::string>&           linked_libs,
+        const std::string&                        output_file)
+{
+  const auto args = createLldArgs(files, linked_libs, output_file);
+
+  if (!args)
+    return std::nullopt;
+
+  std::vector<const char*> argv;
+
+  for (const auto& r : *args)
+    argv.push_back(r.c_str());
+
+  const auto linked
+    = lld::elf::link(argv, llvm::outs(), llvm::errs(), false, false);
+
+  // LLD keeps its state in globals until it is destroyed, and --watch links
+  // many times in this process
+  lld::CommonLinkerContext::destroy();
+
+  return linked ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif // TWK_USE_LLD
+
+} // namespace
+
+namespace twk
+{
+
+[[nodiscard]] std::optional<int>
+callLinker(const std::vector<std::filesystem::path>& files,
+           const std::vector<std::string>&           linked_libs,
+           const std::string&                        output_file)
+{
+#ifdef TWK_USE_LLD
+  if (const auto exit_status = callLld(files, linked_libs, output_file))
+    return exit_status;
+#endif // TWK_USE_LLD
+
+  return callGcc(files, linked_libs, output_file);
+}
+
+[[nodiscard]] std::optional<std::filesystem::path> getProfileRuntime()
+{
+#ifdef TWK_PROFILE_RUNTIME
+  // The runtime may have been removed since twk was built
+  if (std::filesystem::exists(TWK_PROFILE_RUNTIME))
+    return TWK_PROFILE_RUNTIME;
+#endif // TWK_PROFILE_RUNTIME
+
+  return std::nullopt;
+}
+
+[[nodiscard]] bool verifyProfileRuntime(const Context&         ctx,
+                                        const std::string_view argv_front)
+{
+  // Only executables are linked with the runtime, and JIT compilation reports
+  // its own error
+  if (!ctx.profile_generate || ctx.jit || ctx.emit_target != EMIT_EXE_ARG
+      || getProfileRuntime())
+    return true;
+
+  std::cerr << formatError(argv_front,
+                           "--profile-generate needs the profile runtime of "
+                           "compiler-rt (libclang_rt.profile), which was not "
+                           "found; install compiler-rt and rebuild twk, or "
+                           "link the object files emitted by --emit obj with "
+                           "the runtime\n")
+            << std::flush;
+
+  return false;
+}
+
+[[nodiscard]] int linkExecutable(const Context&                     ctx,
+                                 std::vector<std::filesystem::path> files,
+                                 const std::string_view             argv_front)
+{
+  if (ctx.profile_generate) {
+    if (!verifyProfileRuntime(ctx, argv_front))
+      return EXIT_FAILURE;
+
+    files.push_back(*getProfileRuntime());
+  }
+
+  const auto linker_exit_status
+    = callLinker(files, ctx.linked_libs, ctx.output_file);
+
+  if (linker_exit_status)
+    return *linker_exit_status;
+  else {
+    std::cerr << "Could not run linker!" << std::endl;
+    return EXIT_FAILURE;
+  }
+}
+
+} // namespace twk
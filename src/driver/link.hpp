@@ -0,0 +1,54 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _e47c1a9d_3f6b_4e28_8d5a_9b0c2f7e4a16
+#define _e47c1a9d_3f6b_4e28_8d5a_9b0c2f7e4a16
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <context.hpp>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace twk
+{
+
+// Link object files into an executable
+// If twk is built with LLD, link in this process, otherwise call gcc
+// If the linker could not be run, return std::nullopt; otherwise, return linker
+// exit status
+[[nodiscard]] std::optional<int>
+callLinker(const std::vector<std::filesystem::path>& files,
+           const std::vector<std::string>&           linked_libs,
+           const std::string&                        output_file);
+
+// Returns the profile runtime of compiler-rt linked into executables
+// instrumented by --profile-generate, or std::nullopt if it was not found when
+// twk was built or has been removed since
+[[nodiscard]] std::optional<std::filesystem::path> getProfileRuntime();
+
+// Returns false after writing an error to stderr if an instrumented executable
+// is to be linked without the profile runtime, so that it is reported before
+// compiling
+[[nodiscard]] bool verifyProfileRuntime(const Context&         ctx,
+                                        const std::string_view argv_front);
+
+// Link the created object files into an executable with the libraries of the
+// context, and the profile runtime if the executable is instrumented
+// Returns the exit status of twk
+[[nodiscard]] int linkExecutable(const Context&                     ctx,
+                                 std::vector<std::filesystem::path> files,
+                                 const std::string_view             argv_front);
+
+} // namespace twk
+
+#endif
@@ -0,0 +1,282 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "server.hpp"
+#include "driver.hpp"
+#include "socket.hpp"
+#include <twk/compile/compile.hpp>
+#include <twk/support/utils.hpp>
+#include <fmt/core.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef TWK_SERVER_SUPPORTED
+
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace
+{
+
+// Replace the environment with that of the client
+void setEnvironment(const std::vector<std::string>& environment)
+{
+  std::vector<std::string> names;
+
+  for (auto env = environ; env && *env; ++env) {
+    const std::string_view str{*env};
+    names.emplace_back(str.substr(0, str.find('=')));
+  }
+
+  for (const auto& name : names)
+    unsetenv(name.c_str());
+
+  for (const auto& env : environment) {
+    if (const auto pos = env.find('='); pos != std::string::npos)
+      setenv(env.substr(0, pos).c_str(), env.substr(pos + 1).c_str(), 1);
+  }
+}
+
+// Run the request in this process, which is forked for it
+[[noreturn]] void runRequest(const std::string&              cwd,
+                             const std::vector<std::string>& args,
+                             const std::vector<std::string>& environment,
+                             const twk::StandardStreams&     streams,
+                             const std::string_view          argv_front)
+{
+  std::signal(SIGPIPE, SIG_DFL);
+
+  for (int fd = 0; fd < static_cast<int>(streams.size()); ++fd)
+    dup2(streams[fd], fd);
+
+  // Paths in the request are relative to the directory of the client
+  if (chdir(cwd.c_str()) == -1) {
+    std::cerr << twk::formatError(
+      argv_front,
+      fmt::format("{}: {}\n", cwd, std::strerror(errno)))
+              << std::flush;
+    std::exit(EXIT_FAILURE);
+  }
+
+  setEnvironment(environment);
+
+  const std::string        program{argv_front};
+  std::vector<const char*> argv{program.c_str()};
+
+  for (const auto& arg : args)
+    argv.push_back(arg.c_str());
+
+  argv.push_back(nullptr);
+
+  // Exits normally, so that the standard streams are flushed
+  std::exit(
+    twk::runDriver(static_cast<int>(args.size() + 1), argv.data(), true));
+}
+
+// Run in a process forked for the connection, which waits for the request and
+// sends its exit status, since the request may exit by itself
+[[nodiscard]] int handleConnection(const int              fd,
+                                   const std::string_view argv_front)
+{
+  // Requests read and write files as the user running the server
+  if (!twk::isPeerSameUser(fd)) {
+    std::cerr << twk::formatError(argv_front,
+                                  "rejected a request from another user\n")
+              << std::flush;
+    return EXIT_FAILURE;
+  }
+
+  const auto request = twk::receiveMessage(fd);
+  const auto streams = twk::receiveStandardStreams(fd);
+
+  if (!request || !streams)
+    return EXIT_FAILURE;
+
+  std::string              cwd;
+  std::vector<std::string> args;
+  std::vector<std::string> environment;
+
+  try {
+    twk::MessageReader reader{*request};
+
+    cwd         = reader.readString();
+    args        = reader.readStrings();
+    environment = reader.readStrings();
+  }
+  catch (const std::runtime_error&) {
+    return EXIT_FAILURE;
+  }
+
+  // The request is waited for
+  std::signal(SIGCHLD, SIG_DFL);
+
+  const auto pid = fork();
+
+  if (pid == 0)
+    runRequest(cwd, args, environment, *streams, argv_front);
+
+  for (const auto stream : *streams)
+    close(stream);
+
+  if (pid == -1)
+    return EXIT_FAILURE;
+
+  int status;
+
+  while (waitpid(pid, &status, 0) == -1) {
+    if (errno != EINTR)
+      return EXIT_FAILURE;
+  }
+
+  twk::MessageWriter writer;
+  writer.writeInt(WIFEXITED(status) ? WEXITSTATUS(status)
+                                    : 128 + WTERMSIG(status));
+
+  return twk::sendMessage(fd, writer.buffer) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Remove the socket left by a server that is no longer running
+// Other files and the sockets of running servers are kept, and errno is set
+[[nodiscard]] bool removeStaleSocket(const std::string& socket_path,
+                                     const sockaddr_un& addr)
+{
+  struct stat st;
+
+  if (lstat(socket_path.c_str(), &st) == -1)
+    return errno == ENOENT;
+
+  if (!S_ISSOCK(st.st_mode) || st.st_uid != geteuid()) {
+    errno = EEXIST;
+    return false;
+  }
+
+  const twk::FileDescriptor fd{socket(AF_UNIX, SOCK_STREAM, 0)};
+
+  if (fd.fd == -1)
+    return false;
+
+  if (connect(fd.fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr))
+      == 0) {
+    errno = EADDRINUSE;
+    return false;
+  }
+
+  return errno == ECONNREFUSED && unlink(socket_path.c_str()) == 0;
+}
+
+} // namespace
+
+namespace twk
+{
+
+[[nodiscard]] int runServer(const std::string&     socket_path,
+                            const std::string_view argv_front)
+{
+  const auto print_error = [&](const std::string_view message) {
+    std::cerr << formatError(argv_front, message) << '\n' << std::flush;
+    return EXIT_FAILURE;
+  };
+
+  sockaddr_un addr{};
+
+  if (!setSocketPath(addr, socket_path))
+    return print_error(fmt::format("{}: socket path is too long", socket_path));
+
+  // Other users must not be able to replace the socket in the default
+  // directory
+  if (const auto dir = std::filesystem::path{socket_path}.parent_path();
+      dir == getDefaultSocketDirectory() && !createPrivateDirectory(dir)) {
+    return print_error(fmt::format(
+      "{}: the directory could not be created, or other users can access it",
+      dir.string()));
+  }
+
+  if (!removeStaleSocket(socket_path, addr)) {
+    return print_error(
+      fmt::format("{}: {}", socket_path, std::strerror(errno)));
+  }
+
+  const FileDescriptor listen_fd{socket(AF_UNIX, SOCK_STREAM, 0)};
+
+  if (listen_fd.fd == -1)
+    return print_error(std::strerror(errno));
+
+  // Only this user can connect to the socket
+  const auto mask  = umask(077);
+  const auto bound = bind(listen_fd.fd,
+                          reinterpret_cast<const sockaddr*>(&addr),
+                          sizeof(addr))
+                     == 0;
+  umask(mask);
+
+  if (!bound || listen(listen_fd.fd, SOMAXCONN) == -1) {
+    return print_error(
+      fmt::format("{}: {}", socket_path, std::strerror(errno)));
+  }
+
+  // Done once here instead of in every forked process
+  initializeCompiler();
+
+  // Clients may disconnect while the exit status is sent
+  std::signal(SIGPIPE, SIG_IGN);
+
+  // The processes forked for connections are reaped by the system
+  std::signal(SIGCHLD, SIG_IGN);
+
+  for (;;) {
+    const FileDescriptor fd{accept(listen_fd.fd, nullptr, nullptr)};
+
+    if (fd.fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return print_error(std::strerror(errno));
+    }
+
+    const auto pid = fork();
+
+    if (pid == 0) {
+      close(listen_fd.fd);
+      _exit(handleConnection(fd.fd, argv_front));
+    }
+
+    if (pid == -1) {
+      std::cerr << formatError(
+        argv_front,
+        fmt::format("could not fork: {}\n", std::strerror(errno)))
+                << std::flush;
+    }
+  }
+}
+
+} // namespace twk
+
+#else // TWK_SERVER_SUPPORTED
+
+namespace twk
+{
+
+[[nodiscard]] int runServer([[maybe_unused]] const std::string& socket_path,
+                            const std::string_view argv_front)
+{
+  std::cerr << formatError(argv_front,
+                           "the server is not supported on this platform\n")
+            << std::flush;
+  return EXIT_FAILURE;
+}
+
+} // namespace twk
+
+#endif // TWK_SERVER_SUPPORTED
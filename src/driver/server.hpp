@@ -0,0 +1,31 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _3d9a6c14_7e2f_4b58_b1d0_5f8e2a7c9b63
+#define _3d9a6c14_7e2f_4b58_b1d0_5f8e2a7c9b63
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <string>
+#include <string_view>
+
+namespace twk
+{
+
+// Run a compile server listening on the unix domain socket
+// LLVM is initialized once, and each request is run by a process forked from
+// the server, so that requests run concurrently, each in its own directory
+// with the standard streams of the client
+// Returns the exit status if the server could not run
+[[nodiscard]] int runServer(const std::string&     socket_path,
+                            const std::string_view argv_front);
+
+} // namespace twk
+
+#endif
@@ -0,0 +1,298 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "socket.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef TWK_SERVER_SUPPORTED
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace twk
+{
+
+#ifdef TWK_SERVER_SUPPORTED
+
+[[nodiscard]] std::filesystem::path getDefaultSocketDirectory()
+{
+  if (const auto runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+      runtime_dir && *runtime_dir)
+    return runtime_dir;
+
+  return std::filesystem::temp_directory_path()
+         / ("twk-" + std::to_string(geteuid()));
+}
+
+[[nodiscard]] std::string getDefaultSocketPath()
+{
+  return (getDefaultSocketDirectory() / "twk.sock").string();
+}
+
+FileDescriptor::~FileDescriptor()
+{
+  if (fd != -1)
+    close(fd);
+}
+
+//===----------------------------------------------------------------------===//
+// Message
+//===----------------------------------------------------------------------===//
+
+void MessageWriter::writeInt(const std::uint64_t n)
+{
+  buffer.append(reinterpret_cast<const char*>(&n), sizeof(n));
+}
+
+void MessageWriter::writeString(const std::string_view str)
+{
+  writeInt(str.size());
+  buffer.append(str);
+}
+
+void MessageWriter::writeStrings(const std::vector<std::string>& strs)
+{
+  writeInt(strs.size());
+
+  for (const auto& str : strs)
+    writeString(str);
+}
+
+[[nodiscard]] std::uint64_t MessageReader::readInt()
+{
+  std::uint64_t n;
+  std::memcpy(&n, consume(sizeof(n)).data(), sizeof(n));
+  return n;
+}
+
+[[nodiscard]] std::string MessageReader::readString()
+{
+  const auto size = readInt();
+  return std::string{consume(size)};
+}
+
+[[nodiscard]] std::vector<std::string> MessageReader::readStrings()
+{
+  const auto size = readInt();
+
+  std::vector<std::string> strs;
+
+  // The size is not trusted for reserving
+  for (std::uint64_t i = 0; i < size; ++i)
+    strs.push_back(readString());
+
+  return strs;
+}
+
+[[nodiscard]] std::string_view MessageReader::consume(const std::size_t size)
+{
+  if (buffer.size() < size)
+    throw std::runtime_error{"malformed message"};
+
+  const auto r = buffer.substr(0, size);
+  buffer.remove_prefix(size);
+  return r;
+}
+
+//===----------------------------------------------------------------------===//
+// Socket
+//===----------------------------------------------------------------------===//
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+[[nodiscard]] static bool
+sendAll(const int fd, const char* data, std::size_t size)
+{
+  while (size) {
+    const auto sent = send(fd, data, size, SEND_FLAGS);
+
+    if (sent == -1) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    data += sent;
+    size -= sent;
+  }
+
+  return true;
+}
+
+[[nodiscard]] static bool receiveAll(const int fd, char* data, std::size_t size)
+{
+  while (size) {
+    const auto received = recv(fd, data, size, 0);
+
+    if (received == -1 && errno == EINTR)
+      continue;
+
+    if (received <= 0)
+      return false;
+
+    data += received;
+    size -= received;
+  }
+
+  return true;
+}
+
+[[nodiscard]] bool sendMessage(const int fd, const std::string_view message)
+{
+  const std::uint64_t size = message.size();
+
+  return sendAll(fd, reinterpret_cast<const char*>(&size), sizeof(size))
+         && sendAll(fd, message.data(), message.size());
+}
+
+[[nodiscard]] std::optional<std::string> receiveMessage(const int fd)
+{
+  std::uint64_t size;
+
+  if (!receiveAll(fd, reinterpret_cast<char*>(&size), sizeof(size)))
+    return std::nullopt;
+
+  std::string message(size, '\0');
+
+  if (!receiveAll(fd, message.data(), message.size()))
+    return std::nullopt;
+
+  return message;
+}
+
+// The file descriptors are sent as ancillary data of a one-byte message
+[[nodiscard]] bool sendStandardStreams(const int              fd,
+                                       const StandardStreams& streams)
+{
+  char  byte{};
+  iovec iov{&byte, sizeof(byte)};
+
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(streams))]{};
+
+  msghdr msg{};
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control;
+  msg.msg_controllen = sizeof(control);
+
+  const auto cmsg  = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type  = SCM_RIGHTS;
+  cmsg->cmsg_len   = CMSG_LEN(sizeof(streams));
+  std::memcpy(CMSG_DATA(cmsg), streams.data(), sizeof(streams));
+
+  for (;;) {
+    const auto sent = sendmsg(fd, &msg, SEND_FLAGS);
+
+    if (sent == -1 && errno == EINTR)
+      continue;
+
+    return sent == sizeof(byte);
+  }
+}
+
+[[nodiscard]] std::optional<StandardStreams>
+receiveStandardStreams(const int fd)
+{
+  char  byte;
+  iovec iov{&byte, sizeof(byte)};
+
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(StandardStreams))]{};
+
+  msghdr msg{};
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control;
+  msg.msg_controllen = sizeof(control);
+
+  for (;;) {
+    const auto received = recvmsg(fd, &msg, 0);
+
+    if (received == -1 && errno == EINTR)
+      continue;
+
+    if (received != sizeof(byte))
+      return std::nullopt;
+
+    break;
+  }
+
+  const auto cmsg = CMSG_FIRSTHDR(&msg);
+
+  if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+      || cmsg->cmsg_len != CMSG_LEN(sizeof(StandardStreams)))
+    return std::nullopt;
+
+  StandardStreams streams;
+  std::memcpy(streams.data(), CMSG_DATA(cmsg), sizeof(streams));
+
+  return streams;
+}
+
+[[nodiscard]] bool setSocketPath(sockaddr_un& addr, const std::string& path)
+{
+  if (sizeof(addr.sun_path) <= path.size())
+    return false;
+
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, path.c_str());
+
+  return true;
+}
+
+[[nodiscard]] bool isPeerSameUser(const int fd)
+{
+#ifdef __linux__
+  ucred     cred{};
+  socklen_t size = sizeof(cred);
+
+  return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0
+         && cred.uid == geteuid();
+#else
+  uid_t uid;
+  gid_t gid;
+
+  return getpeereid(fd, &uid, &gid) == 0 && uid == geteuid();
+#endif
+}
+
+[[nodiscard]] bool createPrivateDirectory(const std::filesystem::path& dir)
+{
+  if (mkdir(dir.c_str(), 0700) == -1 && errno != EEXIST)
+    return false;
+
+  struct stat st;
+
+  // A directory created by another user, or a symbolic link to one, is not
+  // used
+  return lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode)
+         && st.st_uid == geteuid() && (st.st_mode & 077) == 0;
+}
+
+#else // TWK_SERVER_SUPPORTED
+
+[[nodiscard]] std::filesystem::path getDefaultSocketDirectory()
+{
+  return {};
+}
+
+[[nodiscard]] std::string getDefaultSocketPath()
+{
+  return "";
+}
+
+#endif // TWK_SERVER_SUPPORTED
+
+} // namespace twk
@@ -0,0 +1,116 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _e4a26513_87ee_4a5d_8837_e9d501476467
+#define _e4a26513_87ee_4a5d_8837_e9d501476467
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+#define TWK_SERVER_SUPPORTED
+#include <sys/un.h>
+#endif
+
+// Shared by twk and twk-client, so this does not depend on LLVM or Boost
+
+namespace twk
+{
+
+// The directory of the default socket of the compile server, which is
+// $XDG_RUNTIME_DIR, or a directory in the temporary directory that only this
+// user can access
+[[nodiscard]] std::filesystem::path getDefaultSocketDirectory();
+
+[[nodiscard]] std::string getDefaultSocketPath();
+
+#ifdef TWK_SERVER_SUPPORTED
+
+struct FileDescriptor {
+  explicit FileDescriptor(const int fd) noexcept
+    : fd{fd}
+  {
+  }
+
+  ~FileDescriptor();
+
+  FileDescriptor(const FileDescriptor&)            = delete;
+  FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+  const int fd;
+};
+
+// Messages are sequences of length-prefixed fields
+struct MessageWriter {
+  void writeInt(const std::uint64_t n);
+
+  void writeString(const std::string_view str);
+
+  void writeStrings(const std::vector<std::string>& strs);
+
+  std::string buffer;
+};
+
+// Throws std::runtime_error if the message is malformed
+struct MessageReader {
+  explicit MessageReader(const std::string_view buffer) noexcept
+    : buffer{buffer}
+  {
+  }
+
+  [[nodiscard]] std::uint64_t readInt();
+
+  [[nodiscard]] std::string readString();
+
+  [[nodiscard]] std::vector<std::string> readStrings();
+
+private:
+  [[nodiscard]] std::string_view consume(const std::size_t size);
+
+  std::string_view buffer;
+};
+
+[[nodiscard]] bool sendMessage(const int fd, const std::string_view message);
+
+// Returns std::nullopt if the connection is closed
+[[nodiscard]] std::optional<std::string> receiveMessage(const int fd);
+
+// Standard input, output and error, which are passed to the server so that
+// the compilation reads and writes them directly
+using StandardStreams = std::array<int, 3>;
+
+[[nodiscard]] bool sendStandardStreams(const int              fd,
+                                       const StandardStreams& streams);
+
+// The received file descriptors are owned by the caller
+[[nodiscard]] std::optional<StandardStreams>
+receiveStandardStreams(const int fd);
+
+[[nodiscard]] bool setSocketPath(sockaddr_un& addr, const std::string& path);
+
+// Returns true if the process on the other end of the connection is run by
+// this user
+[[nodiscard]] bool isPeerSameUser(const int fd);
+
+// Creates the directory if it does not exist, and returns true if only this
+// user can access it
+[[nodiscard]] bool createPrivateDirectory(const std::filesystem::path& dir);
+
+#endif // TWK_SERVER_SUPPORTED
+
+} // namespace twk
+
+#endif
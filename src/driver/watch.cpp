@@ -0,0 +1,227 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "watch.hpp"
+#include "link.hpp"
+#include <twk/compile/compile.hpp>
+#include <twk/support/exception.hpp>
+#include <twk/support/utils.hpp>
+#include <fmt/core.h>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef __linux__
+#define TWK_WATCH_SUPPORTED
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef TWK_WATCH_SUPPORTED
+
+namespace
+{
+
+// Directories are watched instead of the files, since editors often save a
+// file by replacing it
+struct DirectoryWatcher {
+  DirectoryWatcher() noexcept
+    : fd{inotify_init1(IN_CLOEXEC)}
+  {
+  }
+
+  ~DirectoryWatcher()
+  {
+    if (fd != -1)
+      close(fd);
+  }
+
+  DirectoryWatcher(const DirectoryWatcher&)            = delete;
+  DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+  [[nodiscard]] bool isValid() const noexcept
+  {
+    return fd != -1;
+  }
+
+  // Watch the directories of the files, and stop watching the others
+  // Directories that do not exist are skipped, since missing imported files
+  // are reported by the compiler
+  void watch(const std::vector<std::filesystem::path>& files)
+  {
+    watched_files.clear();
+
+    std::unordered_set<std::string> dirs;
+
+    for (const auto& file : files) {
+      watched_files.insert(file.string());
+      dirs.insert(file.parent_path().string());
+    }
+
+    for (auto iter = watched_dirs.begin(); iter != watched_dirs.end();) {
+      if (dirs.erase(iter->second.string()))
+        ++iter;
+      else {
+        inotify_rm_watch(fd, iter->first);
+        iter = watched_dirs.erase(iter);
+      }
+    }
+
+    for (const auto& dir : dirs) {
+      const auto wd = inotify_add_watch(fd,
+                                        dir.c_str(),
+                                        IN_CLOSE_WRITE | IN_MOVED_TO
+                                          | IN_CREATE | IN_DELETE);
+
+      if (wd != -1)
+        watched_dirs[wd] = dir;
+    }
+  }
+
+  // Block until some of the watched files change
+  // Returns std::nullopt on error, which is set to errno
+  [[nodiscard]] std::optional<std::vector<std::filesystem::path>> wait()
+  {
+    // Saving a file causes several events, so events are collected until
+    // none arrive for a while
+    constexpr int QUIET_PERIOD_MS = 100;
+
+    std::unordered_set<std::string> changed_files;
+
+    for (;;) {
+      pollfd pfd{fd, POLLIN, 0};
+
+      const auto ready
+        = poll(&pfd, 1, changed_files.empty() ? -1 : QUIET_PERIOD_MS);
+
+      if (ready == -1) {
+        if (errno == EINTR)
+          continue;
+        return std::nullopt;
+      }
+
+      if (ready == 0)
+        break;
+
+      alignas(inotify_event) char buffer[4096];
+
+      const auto length = read(fd, buffer, sizeof(buffer));
+
+      if (length == -1) {
+        if (errno == EINTR)
+          continue;
+        return std::nullopt;
+      }
+
+      for (auto ptr = buffer; ptr < buffer + length;) {
+        const auto event = reinterpret_cast<const inotify_event*>(ptr);
+
+        ptr += sizeof(inotify_event) + event->len;
+
+        const auto dir = watched_dirs.find(event->wd);
+
+        if (!event->len || dir == watched_dirs.end())
+          continue;
+
+        const auto file = (dir->second / event->name).string();
+
+        if (watched_files.contains(file))
+          changed_files.insert(file);
+      }
+    }
+
+    return std::vector<std::filesystem::path>{changed_files.begin(),
+                                              changed_files.end()};
+  }
+
+private:
+  const int fd;
+
+  // Keyed by the watch descriptors
+  std::unordered_map<int, std::filesystem::path> watched_dirs;
+
+  std::unordered_set<std::string> watched_files;
+};
+
+} // namespace
+
+namespace twk
+{
+
+[[nodiscard]] int runWatch(const Context& ctx, const std::string_view argv_front)
+{
+  const auto print_error = [&](const std::string_view message) {
+    std::cerr << formatError(argv_front, message) << '\n' << std::flush;
+    return EXIT_FAILURE;
+  };
+
+  DirectoryWatcher watcher;
+
+  if (!watcher.isValid())
+    return print_error(std::strerror(errno));
+
+  std::optional<IncrementalCompiler> compiler;
+
+  // Options that cannot be used are reported before watching, so that twk
+  // exits instead of waiting for changes
+  try {
+    compiler.emplace(ctx, argv_front);
+  }
+  catch (const ErrorBase& err) {
+    std::cerr << err.what() << (isBackNewline(err.what()) ? "" : "\n")
+              << std::flush;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::filesystem::path> changed_files;
+
+  for (;;) {
+    // Errors are written to stderr, and the files are compiled again after
+    // they are fixed
+    if (const auto result = compiler->compile(changed_files);
+        result && ctx.emit_target == EMIT_EXE_ARG)
+      static_cast<void>(linkExecutable(ctx, result->created_files, argv_front));
+
+    const auto files = compiler->getSourceFiles();
+
+    watcher.watch(files);
+
+    fmt::print(stderr, "Watching {} files for changes...\n", files.size());
+
+    auto changed = watcher.wait();
+
+    if (!changed)
+      return print_error(std::strerror(errno));
+
+    changed_files = std::move(*changed);
+  }
+}
+
+} // namespace twk
+
+#else // TWK_WATCH_SUPPORTED
+
+namespace twk
+{
+
+[[nodiscard]] int runWatch([[maybe_unused]] const Context& ctx,
+                           const std::string_view          argv_front)
+{
+  std::cerr << formatError(argv_front,
+                           "--watch is not supported on this platform\n")
+            << std::flush;
+  return EXIT_FAILURE;
+}
+
+} // namespace twk
+
+#endif // TWK_WATCH_SUPPORTED
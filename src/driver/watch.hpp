@@ -0,0 +1,29 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _5e0b7d2c_4a61_4f3e_9c8d_2b1f6a7e9d30
+#define _5e0b7d2c_4a61_4f3e_9c8d_2b1f6a7e9d30
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <context.hpp>
+#include <string_view>
+
+namespace twk
+{
+
+// Compile the input files, and compile them again whenever they or the files
+// imported from them change, until twk is interrupted
+// Executables are linked after each successful compilation
+// Returns the exit status if watching failed
+[[nodiscard]] int runWatch(const Context& ctx, const std::string_view argv_front);
+
+} // namespace twk
+
+#endif
@@ -0,0 +1,198 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+// Regression benchmark of the parser
+// Parse time has to grow linearly in the number of statements, and in the
+// depth of nested expressions, since the grammar does not re-parse the same
+// tokens
+// Parse throughput is also reported in MB/s
+// With --smoke, every source is parsed once at a small size without checking
+// the time, since wall-clock time is too noisy for ctest to pass or fail on
+
+#include <twk/parse/parser.hpp>
+#include <chrono>
+#include <sstream>
+#include <functional>
+#include <fmt/printf.h>
+
+namespace bench
+{
+
+// Statements of all kinds starting with an expression
+[[nodiscard]] std::string makeStatements(const std::size_t n)
+{
+  std::string source = "func main() -> i32\n{\n  let mut a = 0;\n";
+
+  for (std::size_t i = 0; i < n; ++i) {
+    source += fmt::format("  a = a + {} * (a - 1);\n", i);
+    source += "  a += ((a));\n";
+    source += "  f(a, a);\n";
+    source += "  a match { 0 => { } _ => { } }\n";
+  }
+
+  return source + "  return 0;\n}\n";
+}
+
+[[nodiscard]] std::string makeNestedParens(const std::size_t depth)
+{
+  return fmt::format(
+    "func main() -> i32\n{{\n  let a = {}a{};\n  return 0;\n}}\n",
+    std::string(depth, '('),
+    std::string(depth, ')'));
+}
+
+// Classes and functions of typical code
+[[nodiscard]] std::string makeDefinitions(const std::size_t n)
+{
+  std::string source;
+
+  for (std::size_t i = 0; i < n; ++i) {
+    source += fmt::format("class Point{0} {{\n"
+                          "  Point{0}(x_: i32, y_: i32) : x{{x_}}, y{{y_}}\n"
+                          "  {{\n"
+                          "  }}\n\n"
+                          "  func norm() -> i32\n"
+                          "  {{\n"
+                          "    return x * x + y * y;\n"
+                          "  }}\n\n"
+                          "  let x: i32;\n"
+                          "  let y: i32;\n"
+                          "}}\n\n",
+                          i);
+
+    source += fmt::format("func sum{0}(p: ^i32, n: usize) -> i32\n"
+                          "{{\n"
+                          "  let mut s = 0;\n\n"
+                          "  for (let mut i: usize = 0; i < n; ++i) {{\n"
+                          "    if (p[i] % 2 == 0)\n"
+                          "      s += p[i];\n"
+                          "    else\n"
+                          "      s -= Point{0}{{p[i], {0}}}.norm();\n"
+                          "  }}\n\n"
+                          "  return s;\n"
+                          "}}\n\n",
+                          i);
+  }
+
+  return source + "func main() -> i32\n{\n  return 0;\n}\n";
+}
+
+// Code that is mostly comments
+[[nodiscard]] std::string makeComments(const std::size_t n)
+{
+  std::string source;
+
+  for (std::size_t i = 0; i < n; ++i) {
+    source += "// Lorem ipsum dolor sit amet, consectetur adipiscing elit\n"
+              "/* Sed do eiusmod tempor incididunt ut labore\n"
+              "   et dolore magna aliqua */\n";
+  }
+
+  return source + "func main() -> i32\n{\n  return 0;\n}\n";
+}
+
+// Returns the shortest time of several runs in seconds
+[[nodiscard]] double measure(const std::string& source)
+{
+  constexpr int RUNS = 3;
+
+  auto best = std::numeric_limits<double>::max();
+
+  for (int i = 0; i < RUNS; ++i) {
+    auto file = std::make_shared<const twk::SourceFile>(
+      llvm::MemoryBuffer::getMemBufferCopy(source),
+      0);
+
+    std::ostringstream err;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    twk::parse::Parser parser{std::move(file), "bench.twk", err};
+
+    const std::chrono::duration<double> elapsed
+      = std::chrono::steady_clock::now() - start;
+
+    best = std::min(best, elapsed.count());
+  }
+
+  return best;
+}
+
+// Returns false if the time per unit at the largest size is much longer than
+// at the smallest size
+[[nodiscard]] bool
+checkLinear(const char*                                     name,
+            const std::function<std::string(std::size_t)>& make,
+            const std::size_t                               base)
+{
+  // Allows for noise, while quadratic growth is 8 times at the largest size
+  constexpr double TOLERANCE = 2.5;
+
+  std::optional<double> first_per_unit;
+  double                per_unit{};
+
+  for (std::size_t n = base; n <= base * 8; n *= 2) {
+    per_unit = measure(make(n)) / static_cast<double>(n);
+
+    if (!first_per_unit)
+      first_per_unit = per_unit;
+
+    fmt::print("{:>16} {:>6}: {:8.3f} us/unit\n", name, n, per_unit * 1e6);
+  }
+
+  const auto ratio = per_unit / *first_per_unit;
+
+  if (TOLERANCE < ratio) {
+    fmt::print(stderr,
+               "{}: parse time grows superlinearly ({:.2f}x)\n",
+               name,
+               ratio);
+    return false;
+  }
+
+  return true;
+}
+
+void reportThroughput(const char* name, const std::string& source)
+{
+  constexpr double MB = 1024 * 1024;
+
+  fmt::print("{:>16} {:>6.2f} MB: {:8.2f} MB/s\n",
+             name,
+             static_cast<double>(source.size()) / MB,
+             static_cast<double>(source.size()) / MB / measure(source));
+}
+
+} // namespace bench
+
+int main(const int argc, const char* const* const argv)
+{
+  try {
+    if (argc == 2 && std::string_view{argv[1]} == "--smoke") {
+      static_cast<void>(bench::measure(bench::makeStatements(10)));
+      static_cast<void>(bench::measure(bench::makeNestedParens(10)));
+      static_cast<void>(bench::measure(bench::makeDefinitions(10)));
+      static_cast<void>(bench::measure(bench::makeComments(10)));
+      return EXIT_SUCCESS;
+    }
+
+    const auto statements
+      = bench::checkLinear("statements", bench::makeStatements, 100);
+
+    const auto nested_parens
+      = bench::checkLinear("nested parens", bench::makeNestedParens, 50);
+
+    bench::reportThroughput("definitions", bench::makeDefinitions(500));
+    bench::reportThroughput("comments", bench::makeComments(20000));
+
+    return statements && nested_parens ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  catch (const std::exception& err) {
+    fmt::print(stderr, "{}\n", err.what());
+    return EXIT_FAILURE;
+  }
+}
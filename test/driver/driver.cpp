@@ -0,0 +1,873 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+// Blackbox testing of the command line driver
+// Each test runs twk in its own temporary directory, so that the options
+// reading and writing files, such as --cache-dir, are tested as used
+
+#include <filesystem>
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <fmt/format.h>
+#include <fmt/color.h>
+
+namespace fs = std::filesystem;
+
+namespace test
+{
+
+struct Output {
+  int exit_status;
+
+  std::string err;
+};
+
+struct Sandbox {
+  Sandbox(const fs::path& twk, const std::string_view name)
+    : twk{twk}
+    , dir{fs::temp_directory_path()
+          / fmt::format("twk-driver-test-{}-{}", getpid(), name)}
+  {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+  }
+
+  ~Sandbox()
+  {
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+  }
+
+  Sandbox(const Sandbox&) = delete;
+
+  Sandbox& operator=(const Sandbox&) = delete;
+
+  void write(const fs::path& file, const std::string_view contents) const
+  {
+    std::ofstream{dir / file} << contents;
+  }
+
+  [[nodiscard]] std::string read(const fs::path& file) const
+  {
+    std::ostringstream contents;
+    contents << std::ifstream{dir / file}.rdbuf();
+    return contents.str();
+  }
+
+  // Runs a command in the directory, and returns its exit status and stderr
+  [[nodiscard]] Output run(const std::string_view command) const
+  {
+    const auto status = std::system(
+      fmt::format("cd '{}' && {} 2> stderr.txt", dir.string(), command)
+        .c_str());
+
+    return {WIFEXITED(status) ? WEXITSTATUS(status) : -1, read("stderr.txt")};
+  }
+
+  // Runs twk with the arguments
+  [[nodiscard]] Output twkc(const std::string_view args) const
+  {
+    return run(fmt::format("'{}' {}", twk.string(), args));
+  }
+
+  // Runs twk-client, which is built next to twk, with the arguments
+  [[nodiscard]] Output client(const std::string_view args) const
+  {
+    const auto client = twk.parent_path() / "twk-client";
+    return run(fmt::format("'{}' {}", client.string(), args));
+  }
+
+  const fs::path twk;
+
+  const fs::path dir;
+};
+
+// Runs twk in the directory of the sandbox in the background, writing stderr
+// to the file, and stops it at the end of the lifetime
+struct BackgroundTwk {
+  BackgroundTwk(const Sandbox&           box,
+                std::vector<std::string> args,
+                const fs::path&          err_file)
+    : pid{fork()}
+  {
+    if (pid != 0)
+      return;
+
+    std::vector<char*> argv{const_cast<char*>(box.twk.c_str())};
+
+    for (auto& arg : args)
+      argv.push_back(arg.data());
+
+    argv.push_back(nullptr);
+
+    if (chdir(box.dir.c_str()) == 0
+        && std::freopen(err_file.c_str(), "w", stderr))
+      execv(box.twk.c_str(), argv.data());
+
+    _exit(127);
+  }
+
+  ~BackgroundTwk()
+  {
+    if (pid > 0) {
+      kill(pid, SIGTERM);
+      waitpid(pid, nullptr, 0);
+    }
+  }
+
+  BackgroundTwk(const BackgroundTwk&) = delete;
+
+  BackgroundTwk& operator=(const BackgroundTwk&) = delete;
+
+  const pid_t pid;
+};
+
+// Reports the failure of a check, and returns the result
+bool check(const bool result, const std::string_view what, const Output& out)
+{
+  if (!result) {
+    fmt::print(stderr,
+               "\n  {} (exit status {})\n{}",
+               what,
+               out.exit_status,
+               out.err);
+  }
+
+  return result;
+}
+
+bool checkContains(const Output& out, const std::string_view str)
+{
+  return check(out.err.find(str) != std::string::npos,
+               fmt::format("'{}' expected in stderr", str),
+               out);
+}
+
+bool checkExitStatus(const Output& out, const int exit_status)
+{
+  return check(out.exit_status == exit_status,
+               fmt::format("exit status {} expected", exit_status),
+               out);
+}
+
+constexpr std::string_view LIBRARY_A
+  = "pub func a() -> i32\n{\n  return 48;\n}\n";
+
+constexpr std::string_view MAIN_IMPORTING_A = "import \"./a\";\n\n"
+                                              "func main() -> i32\n"
+                                              "{\n"
+                                              "  return a() + 10;\n"
+                                              "}\n";
+
+//===----------------------------------------------------------------------===//
+// Parallel parsing
+//===----------------------------------------------------------------------===//
+
+// Errors of all input files are reported in the order of the arguments, which
+// is not alphabetical here
+[[nodiscard]] bool testParseErrorsInArgumentOrder(const Sandbox& box)
+{
+  box.write("b", "func main() -> i32\n{\n  return 0\n}\n");
+  box.write("a", "func f() -> i32\n{\n  let x = ;\n  return 1;\n}\n");
+
+  const auto serial   = box.twkc("-j1 b a");
+  const auto parallel = box.twkc("-j4 b a");
+
+  const auto b_pos = parallel.err.find("In file b, line 3:");
+  const auto a_pos = parallel.err.find("In file a, line 3:");
+
+  return checkExitStatus(parallel, EXIT_FAILURE)
+         && check(b_pos != std::string::npos && a_pos != std::string::npos,
+                  "errors of both files expected",
+                  parallel)
+         && check(b_pos < a_pos, "errors of b before those of a", parallel)
+         && check(parallel.err == serial.err,
+                  "the same errors with -j1 and -j4 expected",
+                  parallel);
+}
+
+// Large enough to be split into several chunks of 16K tokens, which are parsed
+// in parallel
+constexpr std::size_t LARGE_FUNCTION_COUNT = 5000;
+
+// Line of the return statement of main in the large source
+constexpr std::size_t LARGE_SOURCE_RETURN_LINE = LARGE_FUNCTION_COUNT * 5 + 3;
+
+// Functions of five lines each, followed by main returning with the statement
+[[nodiscard]] std::string makeLargeSource(const std::string_view return_stmt)
+{
+  std::string source;
+
+  for (std::size_t i = 0; i < LARGE_FUNCTION_COUNT; ++i) {
+    source += fmt::format(
+      "func f{0}(x: i32) -> i32\n{{\n  return x + {0};\n}}\n\n",
+      i);
+  }
+
+  return source
+         + fmt::format("func main() -> i32\n{{\n  {}\n}}\n", return_stmt);
+}
+
+// The chunks are spliced in source order, so the IR does not depend on -j
+[[nodiscard]] bool testChunkedParseSameIR(const Sandbox& box)
+{
+  box.write("large", makeLargeSource("return f4999(0) - 4999;"));
+
+  const auto serial    = box.twkc("--emit llvm -j1 large");
+  const auto serial_ir = box.read("large.ll");
+  const auto parallel  = box.twkc("--emit llvm -j4 --time-trace large");
+
+  return checkExitStatus(serial, EXIT_SUCCESS)
+         && checkExitStatus(parallel, EXIT_SUCCESS)
+         && check(box.read("large.time-trace.json").find("\"ParseChunk\"")
+                    != std::string::npos,
+                  "ParseChunk spans expected",
+                  parallel)
+         && check(box.read("large.ll") == serial_ir,
+                  "the same IR with -j1 and -j4 expected",
+                  parallel);
+}
+
+// A file whose chunk fails is parsed again in one piece, so that the error is
+// reported as with -j1
+[[nodiscard]] bool testChunkedParseSyntaxError(const Sandbox& box)
+{
+  box.write("large", makeLargeSource("return 0"));
+
+  const auto serial   = box.twkc("-j1 large");
+  const auto parallel = box.twkc("-j4 large");
+
+  return checkExitStatus(parallel, EXIT_FAILURE)
+         && checkContains(parallel,
+                          fmt::format("In file large, line {}:",
+                                      LARGE_SOURCE_RETURN_LINE))
+         && check(parallel.err == serial.err,
+                  "the same errors with -j1 and -j4 expected",
+                  parallel);
+}
+
+// The positions of the chunks are spliced, so that errors of the code
+// generator point at the line
+[[nodiscard]] bool testChunkedParseCodegenError(const Sandbox& box)
+{
+  box.write("large", makeLargeSource("return y;"));
+
+  const auto out = box.twkc("-j4 large");
+
+  return checkExitStatus(out, EXIT_FAILURE)
+         && checkContains(out,
+                          fmt::format("In file large, line {}:",
+                                      LARGE_SOURCE_RETURN_LINE))
+         && checkContains(out, "unknown variable 'y' referenced");
+}
+
+//===----------------------------------------------------------------------===//
+// Compiler timing
+//===----------------------------------------------------------------------===//
+
+struct TraceSpan {
+  std::string name;
+
+  // Recorded on a thread other than the main thread
+  bool on_worker;
+};
+
+// Reads the spans of the time trace, except the totals of each name
+[[nodiscard]] std::vector<TraceSpan> readTimeTrace(const Sandbox&  box,
+                                                   const fs::path& file)
+{
+  static const std::regex event{
+    R"re(\{"pid":(\d+),"tid":(\d+),"ph":"X",[^{}]*"name":"([^"]*)")re"};
+
+  const auto trace = box.read(file);
+
+  std::vector<TraceSpan> spans;
+
+  for (auto iter = std::sregex_iterator{trace.begin(), trace.end(), event};
+       iter != std::sregex_iterator{};
+       ++iter) {
+    const auto& match = *iter;
+
+    if (!match[3].str().starts_with("Total "))
+      spans.push_back({match[3].str(), match[1] != match[2]});
+  }
+
+  return spans;
+}
+
+// Writes four files of functions, so that the worker threads of -j4 parse and
+// generate some of them
+void writeFunctionFiles(const Sandbox& box)
+{
+  for (const auto name : {"a", "b", "c", "d"}) {
+    std::string source;
+
+    for (int i = 0; i < 200; ++i) {
+      source += fmt::format("func {0}{1}() -> i32\n{{\n  return {1};\n}}\n\n",
+                            name,
+                            i);
+    }
+
+    box.write(name, source);
+  }
+}
+
+[[nodiscard]] bool testTimeTrace(const Sandbox& box)
+{
+  writeFunctionFiles(box);
+
+  const auto out = box.twkc(
+    "--emit llvm -j4 --time-trace --time-trace-granularity 0 a b c d");
+
+  const auto spans = readTimeTrace(box, "a.time-trace.json");
+
+  const auto has_span = [&](const std::string_view name) {
+    return std::ranges::any_of(spans, [&](const TraceSpan& span) {
+      return span.name == name;
+    });
+  };
+
+  return checkExitStatus(out, EXIT_SUCCESS)
+         && check(has_span("Parse"), "a Parse span expected", out)
+         && check(has_span("ParseFile"), "ParseFile spans expected", out)
+         && check(has_span("Code generation"),
+                  "a Code generation span expected",
+                  out)
+         && check(has_span("CodegenFile"), "CodegenFile spans expected", out)
+         && check(has_span("FunctionDef"), "FunctionDef spans expected", out)
+         && check(std::ranges::any_of(spans, &TraceSpan::on_worker),
+                  "spans of worker threads expected",
+                  out);
+}
+
+// Spans shorter than the granularity are not written
+[[nodiscard]] bool testTimeTraceGranularity(const Sandbox& box)
+{
+  writeFunctionFiles(box);
+
+  const auto out = box.twkc(
+    "--emit llvm --time-trace --time-trace-granularity 100000000 a b c d");
+
+  const auto spans = readTimeTrace(box, "a.time-trace.json");
+
+  return checkExitStatus(out, EXIT_SUCCESS)
+         && check(fs::exists(box.dir / "a.time-trace.json"),
+                  "a.time-trace.json expected",
+                  out)
+         && check(spans.empty(), "no spans expected", out);
+}
+
+[[nodiscard]] bool testTimeReport(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  const auto out = box.twkc("--time-report main a");
+
+  return checkExitStatus(out, EXIT_SUCCESS)
+         && checkContains(out, "twk time report")
+         && checkContains(out, "Parse")
+         && checkContains(out, "Code generation")
+         && checkContains(out, "Optimization")
+         && checkContains(out, "Emission");
+}
+
+//===----------------------------------------------------------------------===//
+// Object file cache
+//===----------------------------------------------------------------------===//
+
+constexpr std::string_view CACHE_ARGS = "--cache-dir cache --cache-stats";
+
+[[nodiscard]] bool testCacheHit(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  const auto args = fmt::format("{} main a", CACHE_ARGS);
+
+  const auto first = box.twkc(args);
+
+  if (!checkExitStatus(first, EXIT_SUCCESS)
+      || !checkContains(first, "cache hits: 0, cache misses: 2"))
+    return false;
+
+  const auto second = box.twkc(args);
+
+  return checkExitStatus(second, EXIT_SUCCESS)
+         && checkContains(second, "cache hits: 2, cache misses: 0")
+         && checkExitStatus(box.run("./a.out"), 58);
+}
+
+// Editing an imported file invalidates the object files of the files
+// importing it
+[[nodiscard]] bool testCacheImportEdited(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  const auto args = fmt::format("--emit obj {} main", CACHE_ARGS);
+
+  if (!checkContains(box.twkc(args), "cache hits: 0, cache misses: 1"))
+    return false;
+
+  // The cached object file is still up to date
+  if (!checkContains(box.twkc(args), "cache hits: 1, cache misses: 0"))
+    return false;
+
+  box.write("a", "pub func a() -> i32\n{\n  return 100;\n}\n");
+
+  const auto edited = box.twkc(args);
+
+  return checkExitStatus(edited, EXIT_SUCCESS)
+         && checkContains(edited, "cache hits: 0, cache misses: 1")
+         && checkContains(box.twkc(args), "cache hits: 1, cache misses: 0");
+}
+
+//===----------------------------------------------------------------------===//
+// Interface files
+//===----------------------------------------------------------------------===//
+
+// Interface files are only written to the cache directory
+[[nodiscard]] bool testInterfaceCacheOptIn(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  // The user cache directory used to be written by default
+  const auto out
+    = box.run(fmt::format("HOME=home XDG_CACHE_HOME= '{}' --JIT main a",
+                          box.twk.string()));
+
+  return checkExitStatus(out, 58)
+         && check(!fs::exists(box.dir / "home"),
+                  "no files written without --cache-dir",
+                  out);
+}
+
+[[nodiscard]] bool testInterfaceCacheReused(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  const auto first = box.twkc("--JIT --cache-dir cache main a");
+
+  if (!checkExitStatus(first, 58)
+      || !check(fs::exists(box.dir / "cache" / "interfaces")
+                  && !fs::is_empty(box.dir / "cache" / "interfaces"),
+                "an interface file written to the cache directory",
+                first))
+    return false;
+
+  // Loaded from the interface file
+  if (!checkExitStatus(box.twkc("--JIT --cache-dir cache main a"), 58))
+    return false;
+
+  // The interface file is out of date
+  box.write("a", "pub func a() -> i32\n{\n  return 100;\n}\n");
+
+  return checkExitStatus(box.twkc("--JIT --cache-dir cache main a"), 110);
+}
+
+//===----------------------------------------------------------------------===//
+// Link-time optimization
+//===----------------------------------------------------------------------===//
+
+// Object files are linked with others, so their symbols are not internalized
+[[nodiscard]] bool testLTOObjectKeepsSymbols(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  return checkExitStatus(box.twkc("--lto --emit obj a"), EXIT_SUCCESS)
+         && checkExitStatus(box.twkc("--emit obj main"), EXIT_SUCCESS)
+         && checkExitStatus(box.run("gcc main.o a.o && ./a.out"), 58);
+}
+
+[[nodiscard]] bool testLTOExecutable(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  return checkExitStatus(box.twkc("--lto main a"), EXIT_SUCCESS)
+         && checkExitStatus(box.run("./a.out"), 58);
+}
+
+[[nodiscard]] bool testThinLTOObjectKeepsSymbols(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  return checkExitStatus(box.twkc("--thin-lto --emit obj a"), EXIT_SUCCESS)
+         && checkExitStatus(box.twkc("--emit obj main"), EXIT_SUCCESS)
+         && checkExitStatus(box.run("gcc main.o a.o && ./a.out"), 58);
+}
+
+[[nodiscard]] bool testThinLTOMultipleDefinition(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("b", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  const auto out = box.twkc("--thin-lto main a b");
+
+  return checkExitStatus(out, EXIT_FAILURE)
+         && checkContains(out, "multiple definition of '_Z1aE' in a and b");
+}
+
+//===----------------------------------------------------------------------===//
+// Linking
+//===----------------------------------------------------------------------===//
+
+[[nodiscard]] bool testOutputFile(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  const auto out = box.twkc("-o 'my program' main a");
+
+  return checkExitStatus(out, EXIT_SUCCESS)
+         && check(!fs::exists(box.dir / "a.out"), "a.out not expected", out)
+         && checkExitStatus(box.run("'./my program'"), 58);
+}
+
+// The exit status of the linker is not truncated to 8 bits
+[[nodiscard]] bool testLinkerFailure(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  return checkExitStatus(box.twkc("main a -l twk_no_such_library"),
+                         EXIT_FAILURE);
+}
+
+//===----------------------------------------------------------------------===//
+// Watch mode
+//===----------------------------------------------------------------------===//
+
+// Options that cannot be used with --watch exit instead of waiting, which is
+// bounded by timeout in case they do not
+[[nodiscard]] bool testWatchInvalidOptions(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  const auto jit = box.run(
+    fmt::format("timeout 10 '{}' --watch --JIT main a", box.twk.string()));
+
+  const auto profile = box.run(fmt::format(
+    "timeout 10 '{}' --watch --profile-use missing.profdata main a",
+    box.twk.string()));
+
+  return checkExitStatus(jit, EXIT_FAILURE)
+         && checkContains(jit, "--watch cannot be used with --JIT")
+         && checkExitStatus(profile, EXIT_FAILURE)
+         && checkContains(profile, "missing.profdata");
+}
+
+// Retries the condition until it holds or the time limit is reached
+template <typename F>
+[[nodiscard]] bool waitUntil(F&& condition)
+{
+  const auto deadline
+    = std::chrono::steady_clock::now() + std::chrono::seconds{30};
+
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  }
+
+  return true;
+}
+
+// Editing an imported file rebuilds and relinks the executable
+[[nodiscard]] bool testWatchRebuild(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  const BackgroundTwk watch{box, {"--watch", "main", "a"}, "watch.txt"};
+
+  // Printed after each build, when the files are watched
+  const auto watching = [&](const std::size_t count) {
+    return [&box, count] {
+      const auto err = box.read("watch.txt");
+
+      std::size_t found{};
+
+      for (auto pos = err.find("Watching"); pos != std::string::npos;
+           pos      = err.find("Watching", pos + 1))
+        ++found;
+
+      return found >= count;
+    };
+  };
+
+  const auto returns = [&](const int exit_status) {
+    return [&box, exit_status] {
+      return box.run("./a.out").exit_status == exit_status;
+    };
+  };
+
+  // Edited after the files are watched, so that the change is not missed
+  const auto built = waitUntil(watching(1)) && waitUntil(returns(58));
+
+  if (built)
+    box.write("a", "pub func a() -> i32\n{\n  return 52;\n}\n");
+
+  const auto rebuilt
+    = built && waitUntil(watching(2)) && waitUntil(returns(62));
+
+  return check(rebuilt,
+               "executable rebuilt after the edit expected",
+               {-1, box.read("watch.txt")});
+}
+
+//===----------------------------------------------------------------------===//
+// Profile-guided optimization
+//===----------------------------------------------------------------------===//
+
+constexpr std::string_view MAIN_WITH_LOOP
+  = "func main() -> i32\n"
+    "{\n"
+    "  let mut i: i32;\n"
+    "  for (i = 0; i != 1000; i += 1) {\n"
+    "    if (i == 58)\n"
+    "      break;\n"
+    "  }\n"
+    "  return i;\n"
+    "}\n";
+
+// Instruments the program, runs it, merges the profile and optimizes with it
+// Skipped if twk is built without the profile runtime, which must then be
+// reported before compiling
+[[nodiscard]] bool testProfileRoundTrip(const Sandbox& box)
+{
+  box.write("main", MAIN_WITH_LOOP);
+
+  const auto instrumented = box.twkc("--profile-generate main");
+
+  if (instrumented.err.find("needs the profile runtime") != std::string::npos) {
+    fmt::print(stderr, " (skipped: no profile runtime)");
+
+    return checkExitStatus(instrumented, EXIT_FAILURE);
+  }
+
+  if (box.run("command -v llvm-profdata").exit_status != EXIT_SUCCESS) {
+    fmt::print(stderr, " (skipped: no llvm-profdata)");
+    return true;
+  }
+
+  return checkExitStatus(instrumented, EXIT_SUCCESS)
+         && checkExitStatus(box.run("LLVM_PROFILE_FILE=main.profraw ./a.out"),
+                            58)
+         && checkExitStatus(
+           box.run("llvm-profdata merge -o main.profdata main.profraw"),
+           EXIT_SUCCESS)
+         && checkExitStatus(box.twkc("--profile-use main.profdata main"),
+                            EXIT_SUCCESS)
+         && checkExitStatus(box.run("./a.out"), 58);
+}
+
+//===----------------------------------------------------------------------===//
+// Compile server
+//===----------------------------------------------------------------------===//
+
+// Returns true if a server accepts connections on the socket of the sandbox
+[[nodiscard]] bool isListening(const Sandbox& box, const fs::path& socket_path)
+{
+  const auto path = (box.dir / socket_path).string();
+
+  sockaddr_un addr{};
+
+  if (sizeof(addr.sun_path) <= path.size())
+    return false;
+
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, path.c_str());
+
+  const auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  const auto connected
+    = fd != -1
+      && connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr))
+           == 0;
+
+  if (fd != -1)
+    close(fd);
+
+  return connected;
+}
+
+// Requests run in the directory and with the standard streams of the client,
+// and --watch cannot be requested, which also shows that the server ran them
+[[nodiscard]] bool testServerRequests(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+  box.write("bad", "func main() -> i32\n{\n  return x;\n}\n");
+
+  const BackgroundTwk server{box,
+                             {"--server", "--socket", "server.sock"},
+                             "server.txt"};
+
+  if (!waitUntil([&] { return isListening(box, "server.sock"); })) {
+    return check(false,
+                 "server listening expected",
+                 {-1, box.read("server.txt")});
+  }
+
+  const auto jit     = box.client("--socket server.sock --JIT main a");
+  const auto exe     = box.client("--socket server.sock -o prog main a");
+  const auto error   = box.client("--socket server.sock bad");
+  const auto watch   = box.client("--socket server.sock --watch main a");
+  const auto connect = box.twkc("--connect --socket server.sock --watch main");
+
+  return checkExitStatus(jit, 58) && checkExitStatus(exe, EXIT_SUCCESS)
+         && checkExitStatus(box.run("./prog"), 58)
+         && checkExitStatus(error, EXIT_FAILURE)
+         && checkContains(error, "unknown variable 'x' referenced")
+         && checkExitStatus(watch, EXIT_FAILURE)
+         && checkContains(watch, "cannot be requested to the compile server")
+         && checkExitStatus(connect, EXIT_FAILURE)
+         && checkContains(connect, "cannot be requested to the compile server");
+}
+
+// Without a server, twk-client runs twk
+[[nodiscard]] bool testServerFallback(const Sandbox& box)
+{
+  box.write("a", LIBRARY_A);
+  box.write("main", MAIN_IMPORTING_A);
+
+  return checkExitStatus(box.client("--socket missing.sock main a"),
+                         EXIT_SUCCESS)
+         && checkExitStatus(box.run("./a.out"), 58);
+}
+
+// The socket of a stopped server is replaced, but not that of a running server
+// or other files
+[[nodiscard]] bool testServerSocketReuse(const Sandbox& box)
+{
+  box.write("not_socket", "kept");
+
+  const auto file_in_use = box.twkc("--server --socket not_socket");
+
+  {
+    const BackgroundTwk stopped{box,
+                                {"--server", "--socket", "server.sock"},
+                                "stopped.txt"};
+
+    if (!waitUntil([&] { return isListening(box, "server.sock"); }))
+      return check(false, "server listening expected", {-1, ""});
+  }
+
+  const BackgroundTwk server{box,
+                             {"--server", "--socket", "server.sock"},
+                             "server.txt"};
+
+  const auto restarted
+    = waitUntil([&] { return isListening(box, "server.sock"); });
+
+  const auto socket_in_use = box.twkc("--server --socket server.sock");
+
+  return checkExitStatus(file_in_use, EXIT_FAILURE)
+         && check(box.read("not_socket") == "kept",
+                  "not_socket kept expected",
+                  file_in_use)
+         && check(restarted,
+                  "server restarted expected",
+                  {-1, box.read("server.txt")})
+         && checkExitStatus(socket_in_use, EXIT_FAILURE)
+         && checkContains(socket_in_use, "Address already in use");
+}
+
+} // namespace test
+
+int main(const int argc, const char* const* const argv)
+{
+  if (argc != 2) {
+    std::cerr << "Invalid commandline arguments!" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  const auto twk = fs::absolute(argv[1]);
+
+  const std::vector<
+    std::pair<std::string_view, std::function<bool(const test::Sandbox&)>>>
+    tests{
+      {"parse_errors_in_argument_order", test::testParseErrorsInArgumentOrder},
+      {         "chunked_parse_same_ir",         test::testChunkedParseSameIR},
+      {    "chunked_parse_syntax_error",    test::testChunkedParseSyntaxError},
+      {   "chunked_parse_codegen_error",   test::testChunkedParseCodegenError},
+      {                    "time_trace",                  test::testTimeTrace},
+      {        "time_trace_granularity",       test::testTimeTraceGranularity},
+      {                   "time_report",                 test::testTimeReport},
+      {                     "cache_hit",                   test::testCacheHit},
+      {           "cache_import_edited",          test::testCacheImportEdited},
+      {        "interface_cache_opt_in",        test::testInterfaceCacheOptIn},
+      {        "interface_cache_reused",       test::testInterfaceCacheReused},
+      {      "lto_object_keeps_symbols",      test::testLTOObjectKeepsSymbols},
+      {                "lto_executable",              test::testLTOExecutable},
+      { "thin_lto_object_keeps_symbols",  test::testThinLTOObjectKeepsSymbols},
+      {  "thin_lto_multiple_definition",  test::testThinLTOMultipleDefinition},
+      {                   "output_file",                 test::testOutputFile},
+      {                "linker_failure",              test::testLinkerFailure},
+      {         "watch_invalid_options",        test::testWatchInvalidOptions},
+      {                 "watch_rebuild",               test::testWatchRebuild},
+      {            "profile_round_trip",           test::testProfileRoundTrip},
+      {               "server_requests",             test::testServerRequests},
+      {               "server_fallback",             test::testServerFallback},
+      {           "server_socket_reuse",          test::testServerSocketReuse},
+  };
+
+  std::size_t pass_c{};
+  std::size_t fail_c{};
+
+  for (const auto& [name, run] : tests) {
+    std::cerr << name;
+
+    const auto passed = run(test::Sandbox{twk, name});
+
+    std::cerr << " => ";
+
+    if (passed) {
+      fmt::print(stderr, fg(fmt::terminal_color::bright_green), "Passed!\n");
+      ++pass_c;
+    }
+    else {
+      fmt::print(stderr, fg(fmt::terminal_color::bright_red), "Failed!\n");
+      ++fail_c;
+    }
+  }
+
+  std::cerr << "--------------------\n";
+  std::cerr << "| " + fmt::format(fg(fmt::terminal_color::bright_red), "Failed")
+                 + ": "
+            << std::setw(10) << fail_c << " |\n";
+  std::cerr << "| "
+                 + fmt::format(fg(fmt::terminal_color::bright_green), "Passed")
+                 + ": "
+            << std::setw(10) << pass_c << " |\n";
+  std::cerr << "--------------------\n";
+
+  if (fail_c)
+    return EXIT_FAILURE;
+}
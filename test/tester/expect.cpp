@@ -208,6 +208,29 @@ namespace test
     {     "union_generics_single_instantiation",  58},
     {                            "size_of_type",  58},
     {                "call_namespaced_function", 116},
+    {              "write_after_taking_address",  58},
+    {          "class_template_with_two_params",  58},
+    {          "lexer_operators_without_spaces",  58},
+    {                    "lexer_keyword_prefix",  58},
+  };
+
+  const auto it = expects.find(test_name);
+
+  if (it == expects.end())
+    return std::nullopt;
+
+  return it->second;
+}
+
+[[nodiscard]] std::optional<ExpectedError>
+getExpectedError(const std::string& test_name)
+{
+  static const std::unordered_map<std::string, ExpectedError> expects{
+    {        "lexer_newline_in_string", {3, 11, "unterminated string literal"}},
+    {     "lexer_dollar_in_identifier", {3, 9, "invalid character"}},
+    {         "invalid_utf8_truncated", {3, 12, "invalid UTF-8 sequence"}},
+    {          "invalid_utf8_overlong", {3, 6, "invalid UTF-8 sequence"}},
+    {"invalid_utf8_stray_continuation", {3, 8, "invalid UTF-8 sequence"}},
   };
 
   const auto it = expects.find(test_name);
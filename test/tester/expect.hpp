@@ -14,12 +14,26 @@
 
 #include <string>
 #include <optional>
+#include <cstddef>
 
 namespace test
 {
 
+// The first diagnostic of a test that must fail to compile
+struct ExpectedError {
+  std::size_t line;
+
+  // Counted in characters from 1
+  std::size_t column;
+
+  std::string message;
+};
+
 [[nodiscard]] std::optional<int> getExpect(const std::string& test_name);
 
+[[nodiscard]] std::optional<ExpectedError>
+getExpectedError(const std::string& test_name);
+
 } // namespace test
 
 #endif
@@ -42,6 +42,17 @@ namespace test
                                   twk::DEFAULT_OPT_LEVEL,
                                   "pic",
                                   {},
+                                  twk::DEFAULT_OUTPUT_FILE,
+                                  std::nullopt,
+                                  twk::DEFAULT_JOBS,
+                                  std::nullopt,
+                                  false,
+                                  false,
+                                  false,
+                                  false,
+                                  twk::DEFAULT_TIME_TRACE_GRANULARITY,
+                                  false,
+                                  false,
                                   std::nullopt},
                      "test");
 
@@ -62,6 +73,17 @@ namespace test
                                   twk::DEFAULT_OPT_LEVEL,
                                   "pic",
                                   {},
+                                  twk::DEFAULT_OUTPUT_FILE,
+                                  std::nullopt,
+                                  twk::DEFAULT_JOBS,
+                                  std::nullopt,
+                                  false,
+                                  false,
+                                  false,
+                                  false,
+                                  twk::DEFAULT_TIME_TRACE_GRANULARITY,
+                                  false,
+                                  false,
                                   std::nullopt},
                      "test");
 
@@ -76,6 +98,59 @@ namespace test
   }
 }
 
+// Returns the diagnostics of a test that must fail to compile, or nullopt if
+// it is compiled
+[[nodiscard]] std::optional<std::string>
+runErrorTest(const fs::directory_entry& test_path)
+{
+  std::ostringstream err_ostm;
+
+  // Diagnostics are written to std::cerr
+  const auto cerr_buf = std::cerr.rdbuf(err_ostm.rdbuf());
+  const auto result   = runTest(test_path);
+  std::cerr.rdbuf(cerr_buf);
+
+  if (result)
+    return std::nullopt;
+
+  const auto str = err_ostm.str();
+
+  // Removes the escape sequences of colors
+  std::string diagnostics;
+
+  for (auto iter = str.begin(); iter != str.end();) {
+    if (*iter == '\x1b')
+      iter = std::next(std::find(iter, str.end(), 'm'));
+    else
+      diagnostics += *iter++;
+  }
+
+  return diagnostics;
+}
+
+// Checks the position and the message of the first diagnostic, which are
+// reported as follows
+// In file <file>, line <line>:
+// error: <message>
+// <source line>
+// ___^_
+[[nodiscard]] bool matchesError(const std::string&   diagnostics,
+                                const ExpectedError& expect)
+{
+  std::istringstream istm{diagnostics};
+
+  std::string location, message, source_line, caret_line;
+
+  std::getline(istm, location);
+  std::getline(istm, message);
+  std::getline(istm, source_line);
+  std::getline(istm, caret_line);
+
+  return location.ends_with(fmt::format(", line {}:", expect.line))
+         && message == "error: " + expect.message
+         && caret_line.find('^') == expect.column - 1;
+}
+
 } // namespace test
 
 int main(const int argc, const char* const* const argv)
@@ -95,6 +170,30 @@ int main(const int argc, const char* const* const argv)
   for (const auto& path : fs::directory_iterator(argv[1])) {
     std::cerr << path.path().stem().string();
 
+    if (const auto expect
+        = test::getExpectedError(path.path().stem().string())) {
+      const auto diagnostics = test::runErrorTest(path);
+
+      std::cerr << " => ";
+
+      if (diagnostics && test::matchesError(*diagnostics, *expect)) {
+        fmt::print(stderr,
+                   fg(fmt::terminal_color::bright_green),
+                   "Error Passed!\n");
+        ++pass_c;
+        continue;
+      }
+
+      fmt::print(stderr, fg(fmt::terminal_color::bright_red), "Failed! ");
+      fmt::print(stderr,
+                 "error at line {}, column {} expected\n{}",
+                 expect->line,
+                 expect->column,
+                 diagnostics.value_or(""));
+      ++fail_c;
+      continue;
+    }
+
     const auto result = test::runTest(path);
     const auto expect = test::getExpect(path.path().stem().string());
 